@@ -256,7 +256,10 @@ function build(settings)
 	tools = {}
 	for i,v in ipairs(tools_src) do
 		toolname = PathFilename(PathBase(v))
-		tools[i] = Link(settings, toolname, Compile(settings, v), engine, zlib, pnglite)
+		tools[i] = Link(settings, toolname, Compile(settings, v), engine, game_shared, zlib, pnglite)
+		if toolname == "loadbot" then
+			loadbot_exe = tools[i]
+		end
 	end
 
 	-- build client, server, version server and master server
@@ -286,6 +289,7 @@ function build(settings)
 	v = PseudoTarget("versionserver".."_"..settings.config_name, versionserver_exe)
 	m = PseudoTarget("masterserver".."_"..settings.config_name, masterserver_exe)
 	t = PseudoTarget("tools".."_"..settings.config_name, tools)
+	l = PseudoTarget("loadbot".."_"..settings.config_name, loadbot_exe)
 
 	all = PseudoTarget(settings.config_name, c, s, v, m, t)
 	return all
@@ -134,6 +134,12 @@
 #endif
 
 
+/* instruction set extensions */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CONF_ARCH_SSE2 1
+#endif
+
+
 #ifndef CONF_FAMILY_STRING
 #define CONF_FAMILY_STRING "unknown"
 #endif
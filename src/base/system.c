@@ -1,5 +1,9 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+	#define _GNU_SOURCE /* recvmmsg and sendmmsg */
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -27,6 +31,11 @@
 
 	#include <dirent.h>
 
+	#if defined(CONF_PLATFORM_LINUX)
+		#include <sys/epoll.h>
+		#include <sys/timerfd.h>
+	#endif
+
 	#if defined(CONF_PLATFORM_MACOSX)
 		#include <Carbon/Carbon.h>
 	#endif
@@ -57,23 +66,22 @@ IOHANDLE io_stdout() { return (IOHANDLE)stdout; }
 IOHANDLE io_stderr() { return (IOHANDLE)stderr; }
 
 static DBG_LOGGER loggers[16];
-static int num_loggers = 0;
+static volatile int num_loggers = 0;
 
 static NETSTATS network_stats = {0};
 static MEMSTATS memory_stats = {0};
 
 static NETSOCKET invalid_socket = {NETTYPE_INVALID, -1, -1};
 
-void dbg_logger(DBG_LOGGER logger)
-{
-	loggers[num_loggers++] = logger;
-}
+static int dbg_queue_push(const char *line);
+static void dbg_queue_flush();
 
 void dbg_assert_imp(const char *filename, int line, int test, const char *msg)
 {
 	if(!test)
 	{
 		dbg_msg("assert", "%s(%d): %s", filename, line, msg);
+		dbg_queue_flush();
 		dbg_break();
 	}
 }
@@ -102,6 +110,9 @@ void dbg_msg(const char *sys, const char *fmt, ...)
 #endif
 	va_end(args);
 
+	if(dbg_queue_push(str))
+		return;
+
 	for(i = 0; i < num_loggers; i++)
 		loggers[i](str);
 }
@@ -140,17 +151,220 @@ void dbg_logger_file(const char *filename)
 		dbg_msg("dbg/logger", "failed to open '%s' for logging", filename);
 
 }
+
+/*
+	threaded logging. the queue is a bounded multi producer queue, every
+	slot has a sequence number that tells whether it's free for the
+	producer of that round or filled for the logger thread.
+*/
+enum
+{
+	DBG_QUEUE_SIZE = 512, /* power of two */
+	DBG_LINE_SIZE = 1024,
+};
+
+#if defined(__GNUC__)
+	#define dbg_atomic_add(p, v) __sync_fetch_and_add((p), (v))
+	#define dbg_atomic_cas(p, c, v) __sync_val_compare_and_swap((p), (c), (v))
+	#define dbg_atomic_swap(p, v) __sync_lock_test_and_set((p), (v))
+	#define dbg_barrier() __sync_synchronize()
+#elif defined(_MSC_VER)
+	#define dbg_atomic_add(p, v) InterlockedExchangeAdd((volatile LONG *)(p), (v))
+	#define dbg_atomic_cas(p, c, v) InterlockedCompareExchange((volatile LONG *)(p), (v), (c))
+	#define dbg_atomic_swap(p, v) InterlockedExchange((volatile LONG *)(p), (v))
+	#define dbg_barrier() MemoryBarrier()
+#endif
+
+void dbg_logger(DBG_LOGGER logger)
+{
+	/* the logger thread may already be running, publish the entry before the count */
+	int num = num_loggers;
+	loggers[num] = logger;
+	dbg_barrier();
+	num_loggers = num+1;
+}
+
+typedef struct DBG_QUEUE_ENTRY
+{
+	volatile unsigned sequence;
+	char line[DBG_LINE_SIZE];
+} DBG_QUEUE_ENTRY;
+
+static DBG_QUEUE_ENTRY dbg_queue[DBG_QUEUE_SIZE];
+static volatile unsigned dbg_queue_write = 0;
+static volatile unsigned dbg_queue_read = 0;
+static volatile int dbg_queue_dropped = 0;
+static volatile int dbg_queue_dropped_total = 0;
+static volatile int dbg_threaded = 0;
+static volatile int dbg_thread_stop = 0;
+static void *dbg_thread = 0;
+#if !defined(CONF_PLATFORM_MACOSX)
+static SEMAPHORE dbg_queue_sem;
+#endif
+
+static int dbg_queue_push(const char *line)
+{
+	unsigned pos;
+	if(!dbg_threaded)
+		return 0;
+
+	pos = dbg_queue_write;
+	while(1)
+	{
+		DBG_QUEUE_ENTRY *entry = &dbg_queue[pos&(DBG_QUEUE_SIZE-1)];
+		int diff = (int)(entry->sequence-pos);
+		if(diff == 0)
+		{
+			/* the slot is free, claim it */
+			unsigned prev = dbg_atomic_cas(&dbg_queue_write, pos, pos+1);
+			if(prev == pos)
+			{
+				str_copy(entry->line, line, sizeof(entry->line));
+				dbg_barrier();
+				entry->sequence = pos+1;
+#if !defined(CONF_PLATFORM_MACOSX)
+				semaphore_signal(&dbg_queue_sem);
+#endif
+				return 1;
+			}
+			pos = prev;
+		}
+		else if(diff < 0)
+		{
+			/* the logger thread is a whole round behind */
+			dbg_atomic_add(&dbg_queue_dropped, 1);
+			return 1;
+		}
+		else
+			pos = dbg_queue_write;
+	}
+}
+
+static void dbg_queue_write_line(const char *line)
+{
+	int i;
+	int num = num_loggers;
+	dbg_barrier();
+	for(i = 0; i < num; i++)
+		loggers[i](line);
+}
+
+static void dbg_logger_thread(void *user)
+{
+	while(1)
+	{
+		DBG_QUEUE_ENTRY *entry = &dbg_queue[dbg_queue_read&(DBG_QUEUE_SIZE-1)];
+		int dropped;
+
+		if((int)(entry->sequence-(dbg_queue_read+1)) < 0)
+		{
+			/* queue is empty */
+			if(dbg_thread_stop)
+				break;
+#if !defined(CONF_PLATFORM_MACOSX)
+			semaphore_wait(&dbg_queue_sem);
+#else
+			thread_sleep(1);
+#endif
+			continue;
+		}
+
+		dbg_barrier();
+		dbg_queue_write_line(entry->line);
+		entry->sequence = dbg_queue_read+DBG_QUEUE_SIZE;
+		dbg_queue_read++;
+
+		dropped = dbg_atomic_swap(&dbg_queue_dropped, 0);
+		if(dropped)
+		{
+			char str[128];
+			str_format(str, sizeof(str), "[%08x][dbg/logger]: dropped %d lines", (int)time(0), dropped);
+			dbg_queue_write_line(str);
+			dbg_atomic_add(&dbg_queue_dropped_total, dropped);
+		}
+	}
+}
+
+static void dbg_queue_flush()
+{
+	/* give the logger thread a moment to catch up */
+	int i;
+	for(i = 0; i < 1000 && dbg_threaded && dbg_queue_read != dbg_queue_write; i++)
+		thread_sleep(1);
+}
+
+static void dbg_disable_threaded()
+{
+	/* write out what's left */
+	dbg_threaded = 0;
+	dbg_thread_stop = 1;
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_signal(&dbg_queue_sem);
+#endif
+	thread_wait(dbg_thread);
+}
+
+void dbg_enable_threaded()
+{
+	int i;
+	if(dbg_threaded)
+		return;
+
+	for(i = 0; i < DBG_QUEUE_SIZE; i++)
+		dbg_queue[i].sequence = i;
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_init(&dbg_queue_sem);
+#endif
+	dbg_thread = thread_init(dbg_logger_thread, 0);
+	dbg_threaded = 1;
+	atexit(dbg_disable_threaded);
+}
+
+int dbg_dropped_lines()
+{
+	return dbg_queue_dropped_total+dbg_queue_dropped;
+}
 /* */
 
+/*
+	every block starts with a header, the block itself is aligned to the
+	requested alignment and the header sits right in front of it.
+	small blocks with the default alignment are kept in thread local pools
+	after they got freed, one list per size class. with CONF_MEMORY_DEBUG
+	the pools are skipped and every block records where it got allocated,
+	gets a guard value behind it and is linked into one list.
+*/
 typedef struct MEMHEADER
 {
+#if defined(CONF_MEMORY_DEBUG)
 	const char *filename;
 	int line;
-	int size;
 	struct MEMHEADER *prev;
 	struct MEMHEADER *next;
+#endif
+	unsigned size;
+	unsigned short offset; /* from the start of the system allocation to the block */
+	short sizeclass; /* -1 if the block isn't pooled */
 } MEMHEADER;
 
+enum
+{
+	MEM_MIN_ALIGNMENT = 16,
+	MEM_NUM_SIZECLASSES = 8, /* 16 to 2048 bytes */
+	MEM_POOL_MAX_BLOCKS = 32,
+};
+
+#if defined(__GNUC__)
+	#define MEM_THREAD_LOCAL __thread
+	#define mem_atomic_add(p, v) __sync_fetch_and_add((p), (v))
+#elif defined(_MSC_VER)
+	#define MEM_THREAD_LOCAL __declspec(thread)
+	#define mem_atomic_add(p, v) InterlockedExchangeAdd((volatile LONG *)(p), (v))
+#else
+	#error missing thread local storage and atomics for this compiler
+#endif
+
+#if defined(CONF_MEMORY_DEBUG)
 typedef struct MEMTAIL
 {
 	int guard;
@@ -159,34 +373,117 @@ typedef struct MEMTAIL
 static struct MEMHEADER *first = 0;
 static const int MEM_GUARD_VAL = 0xbaadc0de;
 
+/* the locks themselves are allocated through mem_alloc, so the list uses a spin lock */
+static volatile long mem_list_lock = 0;
+
+static void mem_lock_list()
+{
+#if defined(__GNUC__)
+	while(__sync_lock_test_and_set(&mem_list_lock, 1))
+#else
+	while(InterlockedExchange(&mem_list_lock, 1))
+#endif
+		thread_yield();
+}
+
+static void mem_unlock_list()
+{
+#if defined(__GNUC__)
+	__sync_lock_release(&mem_list_lock);
+#else
+	InterlockedExchange(&mem_list_lock, 0);
+#endif
+}
+#else
+typedef struct MEMPOOL
+{
+	void *first;
+	int num_blocks;
+} MEMPOOL;
+
+static MEM_THREAD_LOCAL MEMPOOL mem_pools[MEM_NUM_SIZECLASSES];
+
+static int mem_sizeclass(unsigned size)
+{
+	int sizeclass = 0;
+	unsigned class_size = MEM_MIN_ALIGNMENT;
+	while(class_size < size)
+	{
+		class_size <<= 1;
+		sizeclass++;
+	}
+	return sizeclass < MEM_NUM_SIZECLASSES ? sizeclass : -1;
+}
+#endif
+
 void *mem_alloc_debug(const char *filename, int line, unsigned size, unsigned alignment)
 {
-	/* TODO: fix alignment */
-	/* TODO: add debugging */
-	MEMTAIL *tail;
-	MEMHEADER *header = (struct MEMHEADER *)malloc(size+sizeof(MEMHEADER)+sizeof(MEMTAIL));
-	dbg_assert(header != 0, "mem_alloc failure");
-	if(!header)
+	unsigned alloc_size = size;
+	int sizeclass = -1;
+	char *raw;
+	char *block;
+	MEMHEADER *header;
+
+	if(alignment < MEM_MIN_ALIGNMENT)
+		alignment = MEM_MIN_ALIGNMENT;
+	dbg_assert((alignment&(alignment-1)) == 0, "mem_alloc alignment has to be a power of two");
+
+	mem_atomic_add(&memory_stats.allocated, (int)size);
+	mem_atomic_add(&memory_stats.total_allocations, 1);
+	mem_atomic_add(&memory_stats.active_allocations, 1);
+
+#if defined(CONF_MEMORY_DEBUG)
+	alloc_size += sizeof(MEMTAIL);
+#else
+	/* reuse a pooled block if there is one */
+	if(alignment == MEM_MIN_ALIGNMENT)
+	{
+		sizeclass = mem_sizeclass(size);
+		if(sizeclass != -1)
+		{
+			MEMPOOL *pool = &mem_pools[sizeclass];
+			if(pool->first)
+			{
+				block = (char *)pool->first;
+				pool->first = *(void **)block;
+				pool->num_blocks--;
+
+				header = (MEMHEADER *)block - 1;
+				header->size = size;
+				return block;
+			}
+			alloc_size = MEM_MIN_ALIGNMENT<<sizeclass;
+		}
+	}
+#endif
+
+	raw = (char *)malloc(alloc_size+sizeof(MEMHEADER)+alignment-1);
+	dbg_assert(raw != 0, "mem_alloc failure");
+	if(!raw)
 		return NULL;
-	tail = (struct MEMTAIL *)(((char*)(header+1))+size);
+
+	block = (char *)(((size_t)(raw+sizeof(MEMHEADER))+alignment-1)&~(size_t)(alignment-1));
+	header = (MEMHEADER *)block - 1;
 	header->size = size;
+	header->offset = (unsigned short)(block-raw);
+	header->sizeclass = (short)sizeclass;
+
+#if defined(CONF_MEMORY_DEBUG)
 	header->filename = filename;
 	header->line = line;
+	((MEMTAIL *)(block+size))->guard = MEM_GUARD_VAL;
 
-	memory_stats.allocated += header->size;
-	memory_stats.total_allocations++;
-	memory_stats.active_allocations++;
-
-	tail->guard = MEM_GUARD_VAL;
-
+	mem_lock_list();
 	header->prev = (MEMHEADER *)0;
 	header->next = first;
 	if(first)
 		first->prev = header;
 	first = header;
+	mem_unlock_list();
+#endif
 
-	/*dbg_msg("mem", "++ %p", header+1); */
-	return header+1;
+	/*dbg_msg("mem", "++ %p", block); */
+	return block;
 }
 
 void mem_free(void *p)
@@ -194,34 +491,74 @@ void mem_free(void *p)
 	if(p)
 	{
 		MEMHEADER *header = (MEMHEADER *)p - 1;
-		MEMTAIL *tail = (MEMTAIL *)(((char*)(header+1))+header->size);
 
-		if(tail->guard != MEM_GUARD_VAL)
-			dbg_msg("mem", "!! %p", p);
 		/* dbg_msg("mem", "-- %p", p); */
-		memory_stats.allocated -= header->size;
-		memory_stats.active_allocations--;
+		mem_atomic_add(&memory_stats.allocated, -(int)header->size);
+		mem_atomic_add(&memory_stats.active_allocations, -1);
+
+#if defined(CONF_MEMORY_DEBUG)
+		if(((MEMTAIL *)((char *)p+header->size))->guard != MEM_GUARD_VAL)
+			dbg_msg("mem", "!! %p allocated at %s(%d)", p, header->filename, header->line);
 
+		mem_lock_list();
 		if(header->prev)
 			header->prev->next = header->next;
 		else
 			first = header->next;
 		if(header->next)
 			header->next->prev = header->prev;
+		mem_unlock_list();
+#else
+		/* keep small blocks around for the next allocation on this thread */
+		if(header->sizeclass != -1)
+		{
+			MEMPOOL *pool = &mem_pools[header->sizeclass];
+			if(pool->num_blocks < MEM_POOL_MAX_BLOCKS)
+			{
+				*(void **)p = pool->first;
+				pool->first = p;
+				pool->num_blocks++;
+				return;
+			}
+		}
+#endif
+
+		free((char *)p - header->offset);
+	}
+}
 
-		free(header);
+void mem_thread_cleanup()
+{
+#if !defined(CONF_MEMORY_DEBUG)
+	int i;
+	for(i = 0; i < MEM_NUM_SIZECLASSES; i++)
+	{
+		MEMPOOL *pool = &mem_pools[i];
+		while(pool->first)
+		{
+			char *block = (char *)pool->first;
+			pool->first = *(void **)block;
+			free(block - ((MEMHEADER *)block - 1)->offset);
+		}
+		pool->num_blocks = 0;
 	}
+#endif
 }
 
 void mem_debug_dump(IOHANDLE file)
 {
+#if defined(CONF_MEMORY_DEBUG)
 	char buf[1024];
-	MEMHEADER *header = first;
+	MEMHEADER *header;
+#endif
 	if(!file)
 		file = io_open("memory.txt", IOFLAG_WRITE);
 
 	if(file)
 	{
+#if defined(CONF_MEMORY_DEBUG)
+		mem_lock_list();
+		header = first;
 		while(header)
 		{
 			str_format(buf, sizeof(buf), "%s(%d): %d", header->filename, header->line, header->size);
@@ -229,6 +566,12 @@ void mem_debug_dump(IOHANDLE file)
 			io_write_newline(file);
 			header = header->next;
 		}
+		mem_unlock_list();
+#else
+		static const char msg[] = "allocation sites are only tracked with CONF_MEMORY_DEBUG";
+		io_write(file, msg, strlen(msg));
+		io_write_newline(file);
+#endif
 
 		io_close(file);
 	}
@@ -252,17 +595,23 @@ void mem_zero(void *block,unsigned size)
 
 int mem_check_imp()
 {
-	MEMHEADER *header = first;
+#if defined(CONF_MEMORY_DEBUG)
+	MEMHEADER *header;
+	mem_lock_list();
+	header = first;
 	while(header)
 	{
 		MEMTAIL *tail = (MEMTAIL *)(((char*)(header+1))+header->size);
 		if(tail->guard != MEM_GUARD_VAL)
 		{
 			dbg_msg("mem", "Memory check failed at %s(%d): %d", header->filename, header->line, header->size);
+			mem_unlock_list();
 			return 0;
 		}
 		header = header->next;
 	}
+	mem_unlock_list();
+#endif
 
 	return 1;
 }
@@ -370,14 +719,41 @@ int io_flush(IOHANDLE io)
 	return 0;
 }
 
+typedef struct THREADSTART
+{
+	void (*threadfunc)(void *);
+	void *u;
+} THREADSTART;
+
+#if defined(CONF_FAMILY_UNIX)
+static void *thread_run(void *p)
+#else
+static DWORD WINAPI thread_run(void *p)
+#endif
+{
+	THREADSTART start = *(THREADSTART *)p;
+	mem_free(p);
+
+	start.threadfunc(start.u);
+
+	/* give the pooled memory of the thread back */
+	mem_thread_cleanup();
+	return 0;
+}
+
 void *thread_init(void (*threadfunc)(void *), void *u)
 {
+	THREADSTART *start = (THREADSTART *)mem_alloc(sizeof(THREADSTART), 1);
+	start->threadfunc = threadfunc;
+	start->u = u;
 #if defined(CONF_FAMILY_UNIX)
-	pthread_t id;
-	pthread_create(&id, NULL, (void *(*)(void*))threadfunc, u);
-	return (void*)id;
+	{
+		pthread_t id;
+		pthread_create(&id, NULL, thread_run, start);
+		return (void*)id;
+	}
 #elif defined(CONF_FAMILY_WINDOWS)
-	return CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)threadfunc, u, 0, NULL);
+	return CreateThread(NULL, 0, thread_run, start, 0, NULL);
 #else
 	#error not implemented
 #endif
@@ -1077,6 +1453,181 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *data, int maxsize)
 	return -1; /* error */
 }
 
+#if defined(CONF_PLATFORM_LINUX)
+enum
+{
+	NET_MMSG_BATCH_SIZE = 32
+};
+
+static int priv_net_udp_recv_mmsg(int sock, NETUDPPACKET *packets, int num, int maxsize)
+{
+	struct mmsghdr msgs[NET_MMSG_BATCH_SIZE];
+	struct iovec iovs[NET_MMSG_BATCH_SIZE];
+	struct sockaddr_storage addrs[NET_MMSG_BATCH_SIZE];
+	int i, n;
+
+	if(num > NET_MMSG_BATCH_SIZE)
+		num = NET_MMSG_BATCH_SIZE;
+
+	mem_zero(msgs, sizeof(struct mmsghdr)*num);
+	for(i = 0; i < num; i++)
+	{
+		iovs[i].iov_base = packets[i].data;
+		iovs[i].iov_len = maxsize;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+	}
+
+	n = recvmmsg(sock, msgs, num, 0, NULL);
+	if(n <= 0)
+		return (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) ? -1 : 0;
+
+	for(i = 0; i < n; i++)
+	{
+		packets[i].size = msgs[i].msg_len;
+		sockaddr_to_netaddr((struct sockaddr *)&addrs[i], &packets[i].addr);
+		network_stats.recv_bytes += packets[i].size;
+	}
+	network_stats.recv_packets += n;
+	return n;
+}
+#endif
+
+int net_udp_recv_batch(NETSOCKET sock, NETUDPPACKET *packets, int num, int maxsize)
+{
+	int received = 0;
+#if defined(CONF_PLATFORM_LINUX)
+	int error = 0;
+	int n;
+
+	/* ipv4 first, then fill up with ipv6 */
+	while(received < num && sock.ipv4sock >= 0)
+	{
+		n = priv_net_udp_recv_mmsg(sock.ipv4sock, packets+received, num-received, maxsize);
+		if(n < 0)
+			error = 1;
+		if(n <= 0)
+			break;
+		received += n;
+	}
+
+	while(received < num && sock.ipv6sock >= 0)
+	{
+		n = priv_net_udp_recv_mmsg(sock.ipv6sock, packets+received, num-received, maxsize);
+		if(n < 0)
+			error = 1;
+		if(n <= 0)
+			break;
+		received += n;
+	}
+
+	if(!received && error)
+		return -1;
+#else
+	while(received < num)
+	{
+		int bytes = net_udp_recv(sock, &packets[received].addr, packets[received].data, maxsize);
+		if(bytes <= 0)
+		{
+			if(bytes < 0 && !received)
+				return -1;
+			break;
+		}
+		packets[received++].size = bytes;
+	}
+#endif
+	return received;
+}
+
+int net_udp_send_batch(NETSOCKET sock, const NETUDPPACKET *packets, int num)
+{
+	int sent = 0;
+	int i = 0;
+#if defined(CONF_PLATFORM_LINUX)
+	struct mmsghdr msgs[NET_MMSG_BATCH_SIZE];
+	struct iovec iovs[NET_MMSG_BATCH_SIZE];
+	union
+	{
+		struct sockaddr_in sa4;
+		struct sockaddr_in6 sa6;
+	} addrs[NET_MMSG_BATCH_SIZE];
+
+	while(i < num)
+	{
+		/* collect a run of packets that go out over the same socket */
+		int s = -1;
+		int n = 0;
+		int done = 0;
+		while(i+n < num && n < NET_MMSG_BATCH_SIZE)
+		{
+			const NETUDPPACKET *p = &packets[i+n];
+			int psock;
+			if(p->addr.type == NETTYPE_IPV4)
+			{
+				psock = sock.ipv4sock;
+				netaddr_to_sockaddr_in(&p->addr, &addrs[n].sa4);
+				msgs[n].msg_hdr.msg_namelen = sizeof(addrs[n].sa4);
+			}
+			else if(p->addr.type == NETTYPE_IPV6)
+			{
+				psock = sock.ipv6sock;
+				netaddr_to_sockaddr_in6(&p->addr, &addrs[n].sa6);
+				msgs[n].msg_hdr.msg_namelen = sizeof(addrs[n].sa6);
+			}
+			else
+				break;
+			if(psock < 0 || (n && psock != s))
+				break;
+			s = psock;
+
+			iovs[n].iov_base = p->data;
+			iovs[n].iov_len = p->size;
+			msgs[n].msg_hdr.msg_name = &addrs[n];
+			msgs[n].msg_hdr.msg_iov = &iovs[n];
+			msgs[n].msg_hdr.msg_iovlen = 1;
+			msgs[n].msg_hdr.msg_control = 0;
+			msgs[n].msg_hdr.msg_controllen = 0;
+			msgs[n].msg_hdr.msg_flags = 0;
+			network_stats.sent_bytes += p->size;
+			n++;
+		}
+
+		/* broadcasts and packets without a matching socket take the slow path */
+		if(!n)
+		{
+			if(net_udp_send(sock, &packets[i].addr, packets[i].data, packets[i].size) >= 0)
+				sent++;
+			i++;
+			continue;
+		}
+
+		network_stats.sent_packets += n;
+		while(done < n)
+		{
+			int r = sendmmsg(s, msgs+done, n-done, 0);
+			if(r <= 0)
+			{
+				/* drop the packet that failed like sendto would */
+				done++;
+				continue;
+			}
+			sent += r;
+			done += r;
+		}
+		i += n;
+	}
+#else
+	for(; i < num; i++)
+	{
+		if(net_udp_send(sock, &packets[i].addr, packets[i].data, packets[i].size) >= 0)
+			sent++;
+	}
+#endif
+	return sent;
+}
+
 int net_udp_close(NETSOCKET sock)
 {
 	return priv_net_close_all_sockets(sock);
@@ -1552,6 +2103,181 @@ int net_socket_read_wait(NETSOCKET sock, int time)
 	return 0;
 }
 
+enum
+{
+	EVENTLOOP_MAX_EVENTS = 16,
+	EVENTLOOP_MAX_SOCKETS = 32
+};
+
+struct EVENTLOOP
+{
+#if defined(CONF_PLATFORM_LINUX)
+	int epollfd;
+	int timerfd;
+#else
+	NETSOCKET sockets[EVENTLOOP_MAX_SOCKETS];
+	int num_sockets;
+#endif
+};
+
+EVENTLOOP *eventloop_create()
+{
+	EVENTLOOP *loop = (EVENTLOOP *)mem_alloc(sizeof(EVENTLOOP), 1);
+#if defined(CONF_PLATFORM_LINUX)
+	struct epoll_event event;
+	loop->epollfd = epoll_create(EVENTLOOP_MAX_EVENTS);
+	loop->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if(loop->epollfd < 0 || loop->timerfd < 0)
+	{
+		dbg_msg("eventloop", "failed to create epoll or timer fd (%d '%s')", errno, strerror(errno));
+		eventloop_destroy(loop);
+		return 0;
+	}
+
+	mem_zero(&event, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = loop->timerfd;
+	epoll_ctl(loop->epollfd, EPOLL_CTL_ADD, loop->timerfd, &event);
+#else
+	loop->num_sockets = 0;
+#endif
+	return loop;
+}
+
+void eventloop_destroy(EVENTLOOP *loop)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	if(loop->timerfd >= 0)
+		close(loop->timerfd);
+	if(loop->epollfd >= 0)
+		close(loop->epollfd);
+#endif
+	mem_free(loop);
+}
+
+int eventloop_add_socket(EVENTLOOP *loop, NETSOCKET sock)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	int fds[2];
+	int i;
+	fds[0] = sock.ipv4sock;
+	fds[1] = sock.ipv6sock;
+	for(i = 0; i < 2; i++)
+	{
+		struct epoll_event event;
+		if(fds[i] < 0)
+			continue;
+		mem_zero(&event, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.fd = fds[i];
+		if(epoll_ctl(loop->epollfd, EPOLL_CTL_ADD, fds[i], &event) != 0)
+			return -1;
+	}
+	return 0;
+#else
+	if(loop->num_sockets == EVENTLOOP_MAX_SOCKETS)
+		return -1;
+	loop->sockets[loop->num_sockets++] = sock;
+	return 0;
+#endif
+}
+
+void eventloop_remove_socket(EVENTLOOP *loop, NETSOCKET sock)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	struct epoll_event event;
+	mem_zero(&event, sizeof(event));
+	if(sock.ipv4sock >= 0)
+		epoll_ctl(loop->epollfd, EPOLL_CTL_DEL, sock.ipv4sock, &event);
+	if(sock.ipv6sock >= 0)
+		epoll_ctl(loop->epollfd, EPOLL_CTL_DEL, sock.ipv6sock, &event);
+#else
+	int i;
+	for(i = 0; i < loop->num_sockets; i++)
+	{
+		if(loop->sockets[i].ipv4sock == sock.ipv4sock && loop->sockets[i].ipv6sock == sock.ipv6sock)
+		{
+			loop->sockets[i] = loop->sockets[--loop->num_sockets];
+			break;
+		}
+	}
+#endif
+}
+
+int eventloop_wait(EVENTLOOP *loop, int64 wakeup)
+{
+	int64 wait = wakeup-time_get();
+	if(wait <= 0)
+		return 0;
+
+	{
+#if defined(CONF_PLATFORM_LINUX)
+		struct epoll_event events[EVENTLOOP_MAX_EVENTS];
+		struct itimerspec timer;
+		int64 ns = wait*1000000000/time_freq();
+		int num, i;
+		int result = 0;
+
+		/* arming the timer also clears an expiration that wasn't read yet */
+		mem_zero(&timer, sizeof(timer));
+		timer.it_value.tv_sec = ns/1000000000;
+		timer.it_value.tv_nsec = ns%1000000000;
+		timerfd_settime(loop->timerfd, 0, &timer, NULL);
+
+		num = epoll_wait(loop->epollfd, events, EVENTLOOP_MAX_EVENTS, -1);
+		if(num < 0)
+			return errno == EINTR ? 0 : -1;
+
+		for(i = 0; i < num; i++)
+		{
+			if(events[i].data.fd == loop->timerfd)
+			{
+				unsigned long long expirations;
+				if(read(loop->timerfd, &expirations, sizeof(expirations)) < 0)
+					continue;
+			}
+			else
+				result = 1;
+		}
+		return result;
+#else
+		struct timeval tv;
+		fd_set readfds;
+		int maxfd = -1;
+		int i;
+
+		FD_ZERO(&readfds);
+		for(i = 0; i < loop->num_sockets; i++)
+		{
+			if(loop->sockets[i].ipv4sock >= 0)
+			{
+				FD_SET(loop->sockets[i].ipv4sock, &readfds);
+				if(loop->sockets[i].ipv4sock > maxfd)
+					maxfd = loop->sockets[i].ipv4sock;
+			}
+			if(loop->sockets[i].ipv6sock >= 0)
+			{
+				FD_SET(loop->sockets[i].ipv6sock, &readfds);
+				if(loop->sockets[i].ipv6sock > maxfd)
+					maxfd = loop->sockets[i].ipv6sock;
+			}
+		}
+
+		wait = wait*1000000/time_freq();
+		if(maxfd < 0)
+		{
+			thread_sleep((int)(wait/1000));
+			return 0;
+		}
+
+		tv.tv_sec = (long)(wait/1000000);
+		tv.tv_usec = (long)(wait%1000000);
+		i = select(maxfd+1, &readfds, NULL, NULL, &tv);
+		return i < 0 ? -1 : (i > 0 ? 1 : 0);
+#endif
+	}
+}
+
 int time_timestamp()
 {
 	return time(0);
@@ -86,6 +86,13 @@ void dbg_msg(const char *sys, const char *fmt, ...);
 	Remarks:
 		- Passing 0 to size will allocated the smallest amount possible
 		and return a unique pointer.
+		- The block is aligned to at least 16 bytes, alignment has to be
+		a power of two.
+		- Small blocks are kept in a pool of the thread that freed them
+		and reused by its next allocations.
+		- Define CONF_MEMORY_DEBUG to record the file and line of every
+		allocation and check for overflows, see <mem_debug_dump> and
+		<mem_check>.
 
 	See Also:
 		<mem_free>
@@ -107,6 +114,18 @@ void *mem_alloc_debug(const char *filename, int line, unsigned size, unsigned al
 */
 void mem_free(void *block);
 
+/*
+	Function: mem_thread_cleanup
+		Frees the blocks pooled by the calling thread.
+
+	Remarks:
+		- Threads started with <thread_init> do this when they end.
+
+	See Also:
+		<mem_alloc>
+*/
+void mem_thread_cleanup();
+
 /*
 	Function: mem_copy
 		Copies a a memory block.
@@ -491,6 +510,14 @@ typedef struct
 	unsigned short port;
 } NETADDR;
 
+/* one datagram for <net_udp_recv_batch> and <net_udp_send_batch> */
+typedef struct
+{
+	NETADDR addr;
+	void *data;
+	int size;
+} NETUDPPACKET;
+
 /*
 	Function: net_init
 		Initiates network functionallity.
@@ -606,6 +633,47 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 */
 int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *data, int maxsize);
 
+/*
+	Function: net_udp_recv_batch
+		Recives up to num packets over an UDP socket with as few system
+		calls as possible.
+
+	Parameters:
+		sock - Socket to use.
+		packets - Packets to fill in. The data of each one has to point
+		to a buffer of at least maxsize bytes, addr and size are set
+		for the recived ones.
+		num - Number of packets.
+		maxsize - Maximum size to recive per packet.
+
+	Returns:
+		Returns the number of packets recived, 0 if there was nothing
+		to recive. Returns -1 on error.
+
+	Remarks:
+		- Uses recvmmsg on linux and single recvfrom calls elsewhere.
+*/
+int net_udp_recv_batch(NETSOCKET sock, NETUDPPACKET *packets, int num, int maxsize);
+
+/*
+	Function: net_udp_send_batch
+		Sends a number of packets over an UDP socket with as few system
+		calls as possible.
+
+	Parameters:
+		sock - Socket to use.
+		packets - Packets to send.
+		num - Number of packets.
+
+	Returns:
+		Returns the number of packets that were sent.
+
+	Remarks:
+		- Uses sendmmsg on linux and single sendto calls elsewhere.
+		- Broadcasts are always sent one by one.
+*/
+int net_udp_send_batch(NETSOCKET sock, const NETUDPPACKET *packets, int num);
+
 /*
 	Function: net_udp_close
 		Closes an UDP socket.
@@ -1166,6 +1234,61 @@ int net_would_block();
 
 int net_socket_read_wait(NETSOCKET sock, int time);
 
+/* Group: Event loop */
+typedef struct EVENTLOOP EVENTLOOP;
+
+/*
+	Function: eventloop_create
+		Creates a set of sockets to wait on, together with a timer.
+
+	Returns:
+		Returns the event loop, 0 on error.
+
+	Remarks:
+		- Uses epoll and a timerfd on linux and select elsewhere.
+*/
+EVENTLOOP *eventloop_create();
+
+/*
+	Function: eventloop_destroy
+		Frees an event loop, the sockets stay open.
+*/
+void eventloop_destroy(EVENTLOOP *loop);
+
+/*
+	Function: eventloop_add_socket
+		Adds a socket to wait on.
+
+	Returns:
+		Returns 0 on success, -1 on error.
+
+	Remarks:
+		- A socket has to be removed with <eventloop_remove_socket>
+		before it gets closed.
+*/
+int eventloop_add_socket(EVENTLOOP *loop, NETSOCKET sock);
+
+/*
+	Function: eventloop_remove_socket
+		Removes a socket that was added with <eventloop_add_socket>.
+*/
+void eventloop_remove_socket(EVENTLOOP *loop, NETSOCKET sock);
+
+/*
+	Function: eventloop_wait
+		Waits until one of the sockets has data or the wakeup time is
+		reached.
+
+	Parameters:
+		loop - Event loop to wait on.
+		wakeup - Time to wake up at the latest, in <time_get> units.
+
+	Returns:
+		Returns 1 if a socket has data, 0 if the wakeup time was
+		reached and -1 on error.
+*/
+int eventloop_wait(EVENTLOOP *loop, int64 wakeup);
+
 void mem_debug_dump(IOHANDLE file);
 
 void swap_endian(void *data, unsigned elem_size, unsigned num);
@@ -1178,6 +1301,22 @@ void dbg_logger_stdout();
 void dbg_logger_debugger();
 void dbg_logger_file(const char *filename);
 
+/*
+	Function: dbg_enable_threaded
+		Moves the loggers to their own thread. dbg_msg then only formats
+		the line and puts it into a lock free queue, so slow terminals
+		and log files don't stall the caller. When the queue is full,
+		lines are dropped and counted.
+*/
+void dbg_enable_threaded();
+
+/*
+	Function: dbg_dropped_lines
+		Returns how many lines were dropped because the logger thread
+		couldn't keep up.
+*/
+int dbg_dropped_lines();
+
 typedef struct
 {
 	int allocated;
@@ -0,0 +1,157 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <base/tl/threading.h>
+
+#include "backend_null.h"
+
+CGraphicsBackend_Null::CGraphicsBackend_Null()
+{
+	mem_zero(&m_Stats, sizeof(m_Stats));
+	mem_zero(m_aTextureMemSize, sizeof(m_aTextureMemSize));
+	m_TextureMemoryUsage = 0;
+	m_StartTime = 0;
+}
+
+int CGraphicsBackend_Null::TexFormatToPixelSize(int TexFormat)
+{
+	if(TexFormat == CCommandBuffer::TEXFORMAT_RGB) return 3;
+	if(TexFormat == CCommandBuffer::TEXFORMAT_ALPHA) return 1;
+	return 4;
+}
+
+void CGraphicsBackend_Null::Cmd_Texture_Create(const CCommandBuffer::SCommand_Texture_Create *pCommand)
+{
+	int MemSize = pCommand->m_Width*pCommand->m_Height*pCommand->m_PixelSize;
+	m_TextureMemoryUsage += MemSize-m_aTextureMemSize[pCommand->m_Slot];
+	m_aTextureMemSize[pCommand->m_Slot] = MemSize;
+
+	m_Stats.m_TextureCreates++;
+	m_Stats.m_TextureBytes += MemSize;
+	mem_free(pCommand->m_pData);
+}
+
+void CGraphicsBackend_Null::Cmd_Texture_Update(const CCommandBuffer::SCommand_Texture_Update *pCommand)
+{
+	m_Stats.m_TextureUpdates++;
+	m_Stats.m_TextureBytes += pCommand->m_Width*pCommand->m_Height*TexFormatToPixelSize(pCommand->m_Format);
+	mem_free(pCommand->m_pData);
+}
+
+void CGraphicsBackend_Null::Cmd_Texture_Destroy(const CCommandBuffer::SCommand_Texture_Destroy *pCommand)
+{
+	m_TextureMemoryUsage -= m_aTextureMemSize[pCommand->m_Slot];
+	m_aTextureMemSize[pCommand->m_Slot] = 0;
+	m_Stats.m_TextureDestroys++;
+}
+
+void CGraphicsBackend_Null::Cmd_VertexBuffer_Create(const CCommandBuffer::SCommand_VertexBuffer_Create *pCommand)
+{
+	m_Stats.m_VertexBufferCreates++;
+	m_Stats.m_VertexBufferBytes += pCommand->m_NumQuads*4*sizeof(IGraphics::CVertexItem);
+	mem_free(pCommand->m_pData);
+}
+
+void CGraphicsBackend_Null::Cmd_VertexBuffer_Update(const CCommandBuffer::SCommand_VertexBuffer_Update *pCommand)
+{
+	m_Stats.m_VertexBufferUpdates++;
+	m_Stats.m_VertexBufferBytes += pCommand->m_NumQuads*4*sizeof(IGraphics::CVertexItem);
+	mem_free(pCommand->m_pData);
+}
+
+void CGraphicsBackend_Null::Cmd_Render(const CCommandBuffer::SCommand_Render *pCommand)
+{
+	m_Stats.m_DrawCalls++;
+	if(pCommand->m_PrimType == CCommandBuffer::PRIMTYPE_QUADS)
+		m_Stats.m_Vertices += pCommand->m_PrimCount*4;
+	else if(pCommand->m_PrimType == CCommandBuffer::PRIMTYPE_LINES)
+		m_Stats.m_Vertices += pCommand->m_PrimCount*2;
+}
+
+void CGraphicsBackend_Null::Cmd_RenderVertexBuffer(const CCommandBuffer::SCommand_RenderVertexBuffer *pCommand)
+{
+	m_Stats.m_DrawCalls++;
+	m_Stats.m_Vertices += pCommand->m_NumQuads*4;
+}
+
+void CGraphicsBackend_Null::Cmd_Screenshot(const CCommandBuffer::SCommand_Screenshot *pCommand)
+{
+	// there is nothing to read back, no data means no screenshot
+	pCommand->m_pImage->m_pData = 0;
+}
+
+void CGraphicsBackend_Null::Cmd_VideoModes(const CCommandBuffer::SCommand_VideoModes *pCommand)
+{
+	*pCommand->m_pNumModes = 0;
+}
+
+void CGraphicsBackend_Null::RunBuffer(CCommandBuffer *pBuffer)
+{
+	m_Stats.m_Buffers++;
+	m_Stats.m_CommandBytes += pBuffer->m_CmdBuffer.DataUsed();
+	m_Stats.m_DataBytes += pBuffer->m_DataBuffer.DataUsed();
+
+	unsigned CmdIndex = 0;
+	while(1)
+	{
+		const CCommandBuffer::SCommand *pBaseCommand = pBuffer->GetCommand(&CmdIndex);
+		if(pBaseCommand == 0x0)
+			break;
+
+		switch(pBaseCommand->m_Cmd)
+		{
+		case CCommandBuffer::CMD_NOP: break;
+		case CCommandBuffer::CMD_SIGNAL: static_cast<const CCommandBuffer::SCommand_Signal *>(pBaseCommand)->m_pSemaphore->signal(); break;
+		case CCommandBuffer::CMD_TEXTURE_CREATE: Cmd_Texture_Create(static_cast<const CCommandBuffer::SCommand_Texture_Create *>(pBaseCommand)); break;
+		case CCommandBuffer::CMD_TEXTURE_DESTROY: Cmd_Texture_Destroy(static_cast<const CCommandBuffer::SCommand_Texture_Destroy *>(pBaseCommand)); break;
+		case CCommandBuffer::CMD_TEXTURE_UPDATE: Cmd_Texture_Update(static_cast<const CCommandBuffer::SCommand_Texture_Update *>(pBaseCommand)); break;
+		case CCommandBuffer::CMD_VERTEXBUFFER_CREATE: Cmd_VertexBuffer_Create(static_cast<const CCommandBuffer::SCommand_VertexBuffer_Create *>(pBaseCommand)); break;
+		case CCommandBuffer::CMD_VERTEXBUFFER_DESTROY: m_Stats.m_VertexBufferDestroys++; break;
+		case CCommandBuffer::CMD_VERTEXBUFFER_UPDATE: Cmd_VertexBuffer_Update(static_cast<const CCommandBuffer::SCommand_VertexBuffer_Update *>(pBaseCommand)); break;
+		case CCommandBuffer::CMD_CLEAR: m_Stats.m_Clears++; break;
+		case CCommandBuffer::CMD_RENDER: Cmd_Render(static_cast<const CCommandBuffer::SCommand_Render *>(pBaseCommand)); break;
+		case CCommandBuffer::CMD_RENDER_VERTEXBUFFER: Cmd_RenderVertexBuffer(static_cast<const CCommandBuffer::SCommand_RenderVertexBuffer *>(pBaseCommand)); break;
+		case CCommandBuffer::CMD_SWAP: m_Stats.m_Frames++; break;
+		case CCommandBuffer::CMD_SCREENSHOT: Cmd_Screenshot(static_cast<const CCommandBuffer::SCommand_Screenshot *>(pBaseCommand)); break;
+		case CCommandBuffer::CMD_VIDEOMODES: Cmd_VideoModes(static_cast<const CCommandBuffer::SCommand_VideoModes *>(pBaseCommand)); break;
+		default: dbg_msg("gfx/null", "unknown command %d", pBaseCommand->m_Cmd);
+		}
+	}
+}
+
+int CGraphicsBackend_Null::Init(const char *pName, int *Width, int *Height, int FsaaSamples, int Flags)
+{
+	// there is no desktop to take the resolution from
+	if(*Width <= 0 || *Height <= 0)
+	{
+		*Width = 1024;
+		*Height = 768;
+	}
+
+	dbg_msg("gfx/null", "headless backend, %dx%d", *Width, *Height);
+	m_StartTime = time_get();
+	return 0;
+}
+
+int CGraphicsBackend_Null::Shutdown()
+{
+	float Time = (time_get()-m_StartTime)/(float)time_freq();
+	int64 Frames = max(m_Stats.m_Frames, (int64)1);
+	dbg_msg("gfx/null", "%d frames in %.2fs, %d buffers, %.2f MB commands, %.2f MB data",
+		(int)m_Stats.m_Frames, Time, (int)m_Stats.m_Buffers, m_Stats.m_CommandBytes/(1024.0f*1024.0f), m_Stats.m_DataBytes/(1024.0f*1024.0f));
+	dbg_msg("gfx/null", "%d draw calls (%.1f per frame), %d vertices (%.1f per frame), %d clears",
+		(int)m_Stats.m_DrawCalls, m_Stats.m_DrawCalls/(float)Frames, (int)m_Stats.m_Vertices, m_Stats.m_Vertices/(float)Frames, (int)m_Stats.m_Clears);
+	dbg_msg("gfx/null", "textures: %d created, %d updated, %d destroyed, %.2f MB uploaded",
+		(int)m_Stats.m_TextureCreates, (int)m_Stats.m_TextureUpdates, (int)m_Stats.m_TextureDestroys, m_Stats.m_TextureBytes/(1024.0f*1024.0f));
+	dbg_msg("gfx/null", "vertex buffers: %d created, %d updated, %d destroyed, %.2f MB uploaded",
+		(int)m_Stats.m_VertexBufferCreates, (int)m_Stats.m_VertexBufferUpdates, (int)m_Stats.m_VertexBufferDestroys, m_Stats.m_VertexBufferBytes/(1024.0f*1024.0f));
+	return 0;
+}
+
+int CGraphicsBackend_Null::MemoryUsage() const
+{
+	return m_TextureMemoryUsage;
+}
+
+IGraphicsBackend *CreateGraphicsBackendNull() { return new CGraphicsBackend_Null; }
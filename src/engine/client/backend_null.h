@@ -0,0 +1,63 @@
+#include "graphics_threaded.h"
+
+// graphics backend without window and gpu, the command buffers are consumed right away on the
+// calling thread and only counted. used to benchmark the client render path headless
+class CGraphicsBackend_Null : public IGraphicsBackend
+{
+public:
+	struct CStats
+	{
+		int64 m_Frames;
+		int64 m_Buffers;
+		int64 m_CommandBytes;
+		int64 m_DataBytes;
+		int64 m_Clears;
+		int64 m_DrawCalls;
+		int64 m_Vertices;
+		int64 m_TextureCreates;
+		int64 m_TextureUpdates;
+		int64 m_TextureDestroys;
+		int64 m_TextureBytes;
+		int64 m_VertexBufferCreates;
+		int64 m_VertexBufferUpdates;
+		int64 m_VertexBufferDestroys;
+		int64 m_VertexBufferBytes;
+	};
+
+private:
+	CStats m_Stats;
+	int m_aTextureMemSize[CCommandBuffer::MAX_TEXTURES];
+	int m_TextureMemoryUsage;
+	int64 m_StartTime;
+
+	static int TexFormatToPixelSize(int TexFormat);
+
+	void Cmd_Texture_Create(const CCommandBuffer::SCommand_Texture_Create *pCommand);
+	void Cmd_Texture_Update(const CCommandBuffer::SCommand_Texture_Update *pCommand);
+	void Cmd_Texture_Destroy(const CCommandBuffer::SCommand_Texture_Destroy *pCommand);
+	void Cmd_VertexBuffer_Create(const CCommandBuffer::SCommand_VertexBuffer_Create *pCommand);
+	void Cmd_VertexBuffer_Update(const CCommandBuffer::SCommand_VertexBuffer_Update *pCommand);
+	void Cmd_Render(const CCommandBuffer::SCommand_Render *pCommand);
+	void Cmd_RenderVertexBuffer(const CCommandBuffer::SCommand_RenderVertexBuffer *pCommand);
+	void Cmd_Screenshot(const CCommandBuffer::SCommand_Screenshot *pCommand);
+	void Cmd_VideoModes(const CCommandBuffer::SCommand_VideoModes *pCommand);
+
+public:
+	CGraphicsBackend_Null();
+
+	virtual int Init(const char *pName, int *Width, int *Height, int FsaaSamples, int Flags);
+	virtual int Shutdown();
+
+	virtual int MemoryUsage() const;
+
+	virtual void Minimize() {}
+	virtual void Maximize() {}
+	virtual int WindowActive() { return 1; }
+	virtual int WindowOpen() { return 1; }
+
+	virtual void RunBuffer(CCommandBuffer *pBuffer);
+	virtual bool IsIdle() const { return true; }
+	virtual void WaitForIdle() {}
+
+	const CStats &Stats() const { return m_Stats; }
+};
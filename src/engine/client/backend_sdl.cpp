@@ -289,6 +289,45 @@ void CCommandProcessorFragment_OpenGL::Cmd_Texture_Create(const CCommandBuffer::
 	mem_free(pTexData);
 }
 
+void CCommandProcessorFragment_OpenGL::FillVertexBuffer(int Slot, const IGraphics::CVertexItem *pData, int NumQuads)
+{
+	CVertexBuffer *pBuffer = &m_aVertexBuffers[Slot];
+	if(pBuffer->m_NumQuads != NumQuads)
+	{
+		mem_free(pBuffer->m_pVertices);
+		pBuffer->m_pVertices = NumQuads > 0 ? (CVertex *)mem_alloc(NumQuads*4*sizeof(CVertex), sizeof(void*)) : 0;
+		pBuffer->m_NumQuads = NumQuads;
+	}
+
+	for(int i = 0; i < NumQuads*4; i++)
+	{
+		pBuffer->m_pVertices[i].m_Pos.x = pData[i].m_X;
+		pBuffer->m_pVertices[i].m_Pos.y = pData[i].m_Y;
+		pBuffer->m_pVertices[i].m_Pos.z = -5.0f;
+		pBuffer->m_pVertices[i].m_Tex.u = pData[i].m_U;
+		pBuffer->m_pVertices[i].m_Tex.v = pData[i].m_V;
+	}
+}
+
+void CCommandProcessorFragment_OpenGL::Cmd_VertexBuffer_Create(const CCommandBuffer::SCommand_VertexBuffer_Create *pCommand)
+{
+	FillVertexBuffer(pCommand->m_Slot, pCommand->m_pData, pCommand->m_NumQuads);
+	mem_free(pCommand->m_pData);
+}
+
+void CCommandProcessorFragment_OpenGL::Cmd_VertexBuffer_Update(const CCommandBuffer::SCommand_VertexBuffer_Update *pCommand)
+{
+	FillVertexBuffer(pCommand->m_Slot, pCommand->m_pData, pCommand->m_NumQuads);
+	mem_free(pCommand->m_pData);
+}
+
+void CCommandProcessorFragment_OpenGL::Cmd_VertexBuffer_Destroy(const CCommandBuffer::SCommand_VertexBuffer_Destroy *pCommand)
+{
+	mem_free(m_aVertexBuffers[pCommand->m_Slot].m_pVertices);
+	m_aVertexBuffers[pCommand->m_Slot].m_pVertices = 0;
+	m_aVertexBuffers[pCommand->m_Slot].m_NumQuads = 0;
+}
+
 void CCommandProcessorFragment_OpenGL::Cmd_Clear(const CCommandBuffer::SCommand_Clear *pCommand)
 {
 	glClearColor(pCommand->m_Color.r, pCommand->m_Color.g, pCommand->m_Color.b, 0.0f);
@@ -319,6 +358,27 @@ void CCommandProcessorFragment_OpenGL::Cmd_Render(const CCommandBuffer::SCommand
 	};
 }
 
+void CCommandProcessorFragment_OpenGL::Cmd_RenderVertexBuffer(const CCommandBuffer::SCommand_RenderVertexBuffer *pCommand)
+{
+	const CVertexBuffer *pBuffer = &m_aVertexBuffers[pCommand->m_Slot];
+	if(pCommand->m_FirstQuad+pCommand->m_NumQuads > (unsigned)pBuffer->m_NumQuads)
+	{
+		dbg_msg("render", "vertex buffer %d range out of bounds", pCommand->m_Slot);
+		return;
+	}
+
+	SetState(pCommand->m_State);
+
+	glVertexPointer(3, GL_FLOAT, sizeof(CVertex), (char*)pBuffer->m_pVertices);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(CVertex), (char*)pBuffer->m_pVertices + sizeof(float)*3);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glColor4f(pCommand->m_Color.r, pCommand->m_Color.g, pCommand->m_Color.b, pCommand->m_Color.a);
+
+	glDrawArrays(GL_QUADS, pCommand->m_FirstQuad*4, pCommand->m_NumQuads*4);
+}
+
 void CCommandProcessorFragment_OpenGL::Cmd_Screenshot(const CCommandBuffer::SCommand_Screenshot *pCommand)
 {
 	// fetch image data
@@ -357,9 +417,17 @@ void CCommandProcessorFragment_OpenGL::Cmd_Screenshot(const CCommandBuffer::SCom
 CCommandProcessorFragment_OpenGL::CCommandProcessorFragment_OpenGL()
 {
 	mem_zero(m_aTextures, sizeof(m_aTextures));
+	mem_zero(m_aVertexBuffers, sizeof(m_aVertexBuffers));
 	m_pTextureMemoryUsage = 0;
 }
 
+CCommandProcessorFragment_OpenGL::~CCommandProcessorFragment_OpenGL()
+{
+	// free the vertex buffers that were still alive at shutdown
+	for(int i = 0; i < CCommandBuffer::MAX_VERTEXBUFFERS; i++)
+		mem_free(m_aVertexBuffers[i].m_pVertices);
+}
+
 bool CCommandProcessorFragment_OpenGL::RunCommand(const CCommandBuffer::SCommand * pBaseCommand)
 {
 	switch(pBaseCommand->m_Cmd)
@@ -368,8 +436,12 @@ bool CCommandProcessorFragment_OpenGL::RunCommand(const CCommandBuffer::SCommand
 	case CCommandBuffer::CMD_TEXTURE_CREATE: Cmd_Texture_Create(static_cast<const CCommandBuffer::SCommand_Texture_Create *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_TEXTURE_DESTROY: Cmd_Texture_Destroy(static_cast<const CCommandBuffer::SCommand_Texture_Destroy *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_TEXTURE_UPDATE: Cmd_Texture_Update(static_cast<const CCommandBuffer::SCommand_Texture_Update *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_VERTEXBUFFER_CREATE: Cmd_VertexBuffer_Create(static_cast<const CCommandBuffer::SCommand_VertexBuffer_Create *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_VERTEXBUFFER_DESTROY: Cmd_VertexBuffer_Destroy(static_cast<const CCommandBuffer::SCommand_VertexBuffer_Destroy *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_VERTEXBUFFER_UPDATE: Cmd_VertexBuffer_Update(static_cast<const CCommandBuffer::SCommand_VertexBuffer_Update *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_CLEAR: Cmd_Clear(static_cast<const CCommandBuffer::SCommand_Clear *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_RENDER: Cmd_Render(static_cast<const CCommandBuffer::SCommand_Render *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_RENDER_VERTEXBUFFER: Cmd_RenderVertexBuffer(static_cast<const CCommandBuffer::SCommand_RenderVertexBuffer *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_SCREENSHOT: Cmd_Screenshot(static_cast<const CCommandBuffer::SCommand_Screenshot *>(pBaseCommand)); break;
 	default: return false;
 	}
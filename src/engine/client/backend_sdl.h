@@ -175,6 +175,19 @@ class CCommandProcessorFragment_OpenGL
 	CTexture m_aTextures[CCommandBuffer::MAX_TEXTURES];
 	volatile int *m_pTextureMemoryUsage;
 
+	// vertex buffers are kept as client side vertex arrays, z is baked in so they can be drawn directly
+	struct CVertex
+	{
+		CCommandBuffer::SPoint m_Pos;
+		CCommandBuffer::STexCoord m_Tex;
+	};
+	struct CVertexBuffer
+	{
+		CVertex *m_pVertices;
+		int m_NumQuads;
+	};
+	CVertexBuffer m_aVertexBuffers[CCommandBuffer::MAX_VERTEXBUFFERS];
+
 public:
 	enum
 	{
@@ -193,17 +206,23 @@ private:
 	static void *Rescale(int Width, int Height, int NewWidth, int NewHeight, int Format, const unsigned char *pData);
 
 	void SetState(const CCommandBuffer::SState &State);
+	void FillVertexBuffer(int Slot, const IGraphics::CVertexItem *pData, int NumQuads);
 
 	void Cmd_Init(const SCommand_Init *pCommand);
 	void Cmd_Texture_Update(const CCommandBuffer::SCommand_Texture_Update *pCommand);
 	void Cmd_Texture_Destroy(const CCommandBuffer::SCommand_Texture_Destroy *pCommand);
 	void Cmd_Texture_Create(const CCommandBuffer::SCommand_Texture_Create *pCommand);
+	void Cmd_VertexBuffer_Create(const CCommandBuffer::SCommand_VertexBuffer_Create *pCommand);
+	void Cmd_VertexBuffer_Update(const CCommandBuffer::SCommand_VertexBuffer_Update *pCommand);
+	void Cmd_VertexBuffer_Destroy(const CCommandBuffer::SCommand_VertexBuffer_Destroy *pCommand);
 	void Cmd_Clear(const CCommandBuffer::SCommand_Clear *pCommand);
 	void Cmd_Render(const CCommandBuffer::SCommand_Render *pCommand);
+	void Cmd_RenderVertexBuffer(const CCommandBuffer::SCommand_RenderVertexBuffer *pCommand);
 	void Cmd_Screenshot(const CCommandBuffer::SCommand_Screenshot *pCommand);
 
 public:
 	CCommandProcessorFragment_OpenGL();
+	~CCommandProcessorFragment_OpenGL();
 
 	bool RunCommand(const CCommandBuffer::SCommand * pBaseCommand);
 };
@@ -282,6 +282,12 @@ CClient::CClient() : m_DemoPlayer(&m_SnapshotDelta), m_DemoRecorder(&m_SnapshotD
 	//
 	m_aCmdConnect[0] = 0;
 
+	// headless benchmark
+	m_aBenchDemo[0] = 0;
+	m_pBenchFrameTimes = 0;
+	m_NumBenchFrames = 0;
+	m_BenchFrameCapacity = 0;
+
 	// map download
 	m_aMapdownloadFilename[0] = 0;
 	m_aMapdownloadName[0] = 0;
@@ -636,19 +642,19 @@ void CClient::SnapInvalidateItem(int SnapID, int Index)
 
 void *CClient::SnapFindItem(int SnapID, int Type, int ID)
 {
-	// TODO: linear search. should be fixed.
-	int i;
-
 	if(!m_aSnapshots[SnapID])
 		return 0x0;
 
-	for(i = 0; i < m_aSnapshots[SnapID]->m_pSnap->NumItems(); i++)
-	{
-		CSnapshotItem *pItem = m_aSnapshots[SnapID]->m_pAltSnap->GetItem(i);
-		if(pItem->Type() == Type && pItem->ID() == ID)
-			return (void *)pItem->Data();
-	}
-	return 0x0;
+	int Key = (Type<<16)|(ID&0xffff);
+	int Index = m_aSnapshots[SnapID]->GetItemIndex(Key);
+	if(Index == -1)
+		return 0x0;
+
+	// the item could have been invalidated in the alternative snapshot
+	CSnapshotItem *pItem = m_aSnapshots[SnapID]->m_pAltSnap->GetItem(Index);
+	if(pItem->Key() != Key)
+		return 0x0;
+	return (void *)pItem->Data();
 }
 
 int CClient::SnapNumItems(int SnapID)
@@ -1077,8 +1083,10 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 					m_MapdownloadTotalsize = MapSize;
 					m_MapdownloadAmount = 0;
 
+					// the server may send the following chunks without waiting for the requests
 					CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA);
 					Msg.AddInt(m_MapdownloadChunk);
+					Msg.AddInt(MAP_DOWNLOAD_WINDOW);
 					SendMsgEx(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
 
 					if(g_Config.m_Debug)
@@ -1133,6 +1141,7 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 
 				CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA);
 				Msg.AddInt(m_MapdownloadChunk);
+				Msg.AddInt(MAP_DOWNLOAD_WINDOW);
 				SendMsgEx(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
 
 				if(g_Config.m_Debug)
@@ -1355,7 +1364,7 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 					m_SnapshotStorage.PurgeUntil(PurgeTick);
 
 					// add new
-					m_SnapshotStorage.Add(GameTick, time_get(), SnapSize, pTmpBuffer3, 1);
+					m_SnapshotStorage.Add(GameTick, time_get(), SnapSize, pTmpBuffer3, 1, 1);
 
 					// add snapshot to demo
 					if(m_DemoRecorder.IsRecording())
@@ -1469,6 +1478,7 @@ void CClient::OnDemoPlayerSnapshot(void *pData, int Size)
 
 	mem_copy(m_aSnapshots[SNAP_CURRENT]->m_pSnap, pData, Size);
 	mem_copy(m_aSnapshots[SNAP_CURRENT]->m_pAltSnap, pData, Size);
+	m_aSnapshots[SNAP_CURRENT]->m_pIndex->Build(m_aSnapshots[SNAP_CURRENT]->m_pSnap);
 
 	GameClient()->OnNewSnapshot();
 }
@@ -1735,7 +1745,7 @@ void CClient::Run()
 
 	// init graphics
 	{
-		if(g_Config.m_GfxThreaded)
+		if(g_Config.m_GfxThreaded || g_Config.m_GfxHeadless)
 			m_pGraphics = CreateEngineGraphicsThreaded();
 		else
 			m_pGraphics = CreateEngineGraphics();
@@ -1821,6 +1831,13 @@ void CClient::Run()
 	// process pending commands
 	m_pConsole->StoreCommands(false);
 
+	if(HeadlessBench_Active())
+	{
+		const char *pError = DemoPlayer_Play(m_aBenchDemo, IStorage::TYPE_ALL);
+		if(pError)
+			dbg_msg("client/bench", "%s: %s", m_aBenchDemo, pError);
+	}
+
 	while (1)
 	{
 		//
@@ -1924,6 +1941,9 @@ void CClient::Run()
 
 				m_LastRenderTime = Now;
 
+				if(HeadlessBench_Active())
+					HeadlessBench_AddFrame(m_RenderFrameTime);
+
 				if(g_Config.m_DbgStress)
 				{
 					if((m_RenderFrames%10) == 0)
@@ -1958,6 +1978,13 @@ void CClient::Run()
 		if(State() == IClient::STATE_QUITING)
 			break;
 
+		// the benchmark is over when the demo is, the player pauses at its end
+		if(HeadlessBench_Active() && (State() != IClient::STATE_DEMOPLAYBACK || m_DemoPlayer.BaseInfo()->m_Paused))
+		{
+			HeadlessBench_Report();
+			break;
+		}
+
 		// beNice
 		if(g_Config.m_ClCpuThrottle)
 			thread_sleep(g_Config.m_ClCpuThrottle);
@@ -2060,6 +2087,67 @@ void CClient::AutoScreenshot_Cleanup()
 	}
 }
 
+void CClient::HeadlessBench_Init(const char *pFilename)
+{
+	str_copy(m_aBenchDemo, pFilename, sizeof(m_aBenchDemo));
+
+	// no window, no sound and nothing that waits, these aren't saved
+	g_Config.m_GfxHeadless = 1;
+	g_Config.m_GfxAsyncRender = 0;
+	g_Config.m_SndEnable = 0;
+	g_Config.m_ClCpuThrottle = 0;
+	g_Config.m_DbgStress = 0;
+}
+
+void CClient::HeadlessBench_AddFrame(float FrameTime)
+{
+	if(m_NumBenchFrames == m_BenchFrameCapacity)
+	{
+		m_BenchFrameCapacity = max(m_BenchFrameCapacity*2, 1024);
+		float *pNewTimes = (float *)mem_alloc(m_BenchFrameCapacity*sizeof(float), 1);
+		if(m_pBenchFrameTimes)
+		{
+			mem_copy(pNewTimes, m_pBenchFrameTimes, m_NumBenchFrames*sizeof(float));
+			mem_free(m_pBenchFrameTimes);
+		}
+		m_pBenchFrameTimes = pNewTimes;
+	}
+	m_pBenchFrameTimes[m_NumBenchFrames++] = FrameTime;
+}
+
+static int CompareFrameTime(const void *pA, const void *pB)
+{
+	float a = *(const float *)pA;
+	float b = *(const float *)pB;
+	return a < b ? -1 : a > b ? 1 : 0;
+}
+
+void CClient::HeadlessBench_Report()
+{
+	// the first frame also measures the loading
+	if(m_NumBenchFrames < 2)
+	{
+		dbg_msg("client/bench", "%s: no frames rendered", m_aBenchDemo);
+		return;
+	}
+
+	float *pTimes = m_pBenchFrameTimes+1;
+	int Num = m_NumBenchFrames-1;
+	float Total = 0.0f;
+	for(int i = 0; i < Num; i++)
+		Total += pTimes[i];
+	qsort(pTimes, Num, sizeof(float), CompareFrameTime);
+
+	dbg_msg("client/bench", "%s: %d frames in %.2fs, %.1f fps", m_aBenchDemo, Num, Total, Num/Total);
+	dbg_msg("client/bench", "frame time ms: avg %.3f, min %.3f, median %.3f, p99 %.3f, max %.3f", Total*1000.0f/Num,
+		pTimes[0]*1000.0f, pTimes[Num/2]*1000.0f, pTimes[min(Num*99/100, Num-1)]*1000.0f, pTimes[Num-1]*1000.0f);
+
+	mem_free(m_pBenchFrameTimes);
+	m_pBenchFrameTimes = 0;
+	m_NumBenchFrames = 0;
+	m_BenchFrameCapacity = 0;
+}
+
 void CClient::Con_Screenshot(IConsole::IResult *pResult, void *pUserData)
 {
 	CClient *pSelf = (CClient *)pUserData;
@@ -2129,14 +2217,19 @@ const char *CClient::DemoPlayer_Play(const char *pFilename, int StorageType)
 
 	m_aSnapshots[SNAP_CURRENT]->m_pSnap = (CSnapshot *)m_aDemorecSnapshotData[SNAP_CURRENT][0];
 	m_aSnapshots[SNAP_CURRENT]->m_pAltSnap = (CSnapshot *)m_aDemorecSnapshotData[SNAP_CURRENT][1];
+	m_aSnapshots[SNAP_CURRENT]->m_pIndex = (CSnapshotIndex *)m_aaDemorecSnapshotIndex[SNAP_CURRENT];
 	m_aSnapshots[SNAP_CURRENT]->m_SnapSize = 0;
 	m_aSnapshots[SNAP_CURRENT]->m_Tick = -1;
 
 	m_aSnapshots[SNAP_PREV]->m_pSnap = (CSnapshot *)m_aDemorecSnapshotData[SNAP_PREV][0];
 	m_aSnapshots[SNAP_PREV]->m_pAltSnap = (CSnapshot *)m_aDemorecSnapshotData[SNAP_PREV][1];
+	m_aSnapshots[SNAP_PREV]->m_pIndex = (CSnapshotIndex *)m_aaDemorecSnapshotIndex[SNAP_PREV];
 	m_aSnapshots[SNAP_PREV]->m_SnapSize = 0;
 	m_aSnapshots[SNAP_PREV]->m_Tick = -1;
 
+	m_aSnapshots[SNAP_CURRENT]->m_pIndex->Build(m_aSnapshots[SNAP_CURRENT]->m_pSnap);
+	m_aSnapshots[SNAP_PREV]->m_pIndex->Build(m_aSnapshots[SNAP_PREV]->m_pSnap);
+
 	// enter demo playback state
 	SetState(IClient::STATE_DEMOPLAYBACK);
 
@@ -2368,21 +2461,31 @@ int main(int argc, const char **argv) // ignore_convention
 	// execute autoexec file
 	pConsole->ExecuteFile("autoexec.cfg");
 
+	// plays the demo headless as fast as possible and prints the frame times:
+	// teeworlds --headless-bench <demo> [<commands>]
+	int FirstArg = 1;
+	if(argc > 2 && str_comp(argv[1], "--headless-bench") == 0) // ignore_convention
+		FirstArg = 3;
+
 	// parse the command line arguments
-	if(argc > 1) // ignore_convention
-		pConsole->ParseArguments(argc-1, &argv[1]); // ignore_convention
+	if(argc > FirstArg) // ignore_convention
+		pConsole->ParseArguments(argc-FirstArg, &argv[FirstArg]); // ignore_convention
 
 	// restore empty config strings to their defaults
 	pConfig->RestoreStrings();
 
+	if(FirstArg == 3)
+		pClient->HeadlessBench_Init(argv[2]); // ignore_convention
+
 	pClient->Engine()->InitLogfile();
 
 	// run the client
 	dbg_msg("client", "starting...");
 	pClient->Run();
 
-	// write down the config and quit
-	pConfig->Save();
+	// write down the config and quit, the benchmark changed it
+	if(!pClient->HeadlessBench_Active())
+		pConfig->Save();
 
 	return 0;
 }
@@ -117,6 +117,12 @@ class CClient : public IClient, public CDemoPlayer::IListner
 	//
 	char m_aCmdConnect[256];
 
+	// headless benchmark
+	char m_aBenchDemo[512];
+	float *m_pBenchFrameTimes;
+	int m_NumBenchFrames;
+	int m_BenchFrameCapacity;
+
 	// map download
 	char m_aMapdownloadFilename[256];
 	char m_aMapdownloadName[256];
@@ -155,6 +161,7 @@ class CClient : public IClient, public CDemoPlayer::IListner
 
 	class CSnapshotStorage::CHolder m_aDemorecSnapshotHolders[NUM_SNAPSHOT_TYPES];
 	char *m_aDemorecSnapshotData[NUM_SNAPSHOT_TYPES][2][CSnapshot::MAX_SIZE];
+	int m_aaDemorecSnapshotIndex[NUM_SNAPSHOT_TYPES][CSnapshotIndex::MAX_SIZE/sizeof(int)];
 
 	class CSnapshotDelta m_SnapshotDelta;
 
@@ -302,6 +309,11 @@ public:
 	void AutoScreenshot_Start();
 	void AutoScreenshot_Cleanup();
 
+	void HeadlessBench_Init(const char *pFilename);
+	bool HeadlessBench_Active() const { return m_aBenchDemo[0] != 0; }
+	void HeadlessBench_AddFrame(float FrameTime);
+	void HeadlessBench_Report();
+
 	void ServerBrowserUpdate();
 };
 #endif
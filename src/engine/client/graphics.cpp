@@ -729,6 +729,88 @@ void CGraphics_OpenGL::QuadsText(float x, float y, float Size, const char *pText
 	}
 }
 
+int CGraphics_OpenGL::CreateVertexBuffer(const CVertexItem *pArray, int NumQuads)
+{
+	// grab buffer
+	int Buffer = m_FirstFreeVertexBuffer;
+	if(Buffer == -1)
+	{
+		dbg_msg("graphics", "out of vertex buffers");
+		return -1;
+	}
+	m_FirstFreeVertexBuffer = m_aVertexBuffers[Buffer].m_Next;
+	m_aVertexBuffers[Buffer].m_Next = -1;
+	m_aVertexBuffers[Buffer].m_pVertices = 0;
+	m_aVertexBuffers[Buffer].m_NumQuads = 0;
+
+	UpdateVertexBuffer(Buffer, pArray, NumQuads);
+	return Buffer;
+}
+
+void CGraphics_OpenGL::UpdateVertexBuffer(int BufferID, const CVertexItem *pArray, int NumQuads)
+{
+	if(BufferID < 0)
+		return;
+
+	CVertexBuffer *pBuffer = &m_aVertexBuffers[BufferID];
+	if(pBuffer->m_NumQuads != NumQuads)
+	{
+		mem_free(pBuffer->m_pVertices);
+		pBuffer->m_pVertices = NumQuads > 0 ? (CBufferVertex *)mem_alloc(NumQuads*4*sizeof(CBufferVertex), sizeof(void*)) : 0;
+		pBuffer->m_NumQuads = NumQuads;
+	}
+
+	for(int i = 0; i < NumQuads*4; i++)
+	{
+		pBuffer->m_pVertices[i].m_Pos.x = pArray[i].m_X;
+		pBuffer->m_pVertices[i].m_Pos.y = pArray[i].m_Y;
+		pBuffer->m_pVertices[i].m_Pos.z = -5.0f;
+		pBuffer->m_pVertices[i].m_Tex.u = pArray[i].m_U;
+		pBuffer->m_pVertices[i].m_Tex.v = pArray[i].m_V;
+	}
+}
+
+void CGraphics_OpenGL::DeleteVertexBuffer(int BufferID)
+{
+	if(BufferID < 0)
+		return;
+
+	mem_free(m_aVertexBuffers[BufferID].m_pVertices);
+	m_aVertexBuffers[BufferID].m_pVertices = 0;
+	m_aVertexBuffers[BufferID].m_NumQuads = 0;
+	m_aVertexBuffers[BufferID].m_Next = m_FirstFreeVertexBuffer;
+	m_FirstFreeVertexBuffer = BufferID;
+}
+
+void CGraphics_OpenGL::DrawVertexBuffer(int BufferID, int FirstQuad, int NumQuads)
+{
+	dbg_assert(m_Drawing == DRAWING_QUADS, "called Graphics()->DrawVertexBuffer without begin");
+
+	if(BufferID < 0 || NumQuads <= 0)
+		return;
+
+	const CVertexBuffer *pBuffer = &m_aVertexBuffers[BufferID];
+	if(FirstQuad+NumQuads > pBuffer->m_NumQuads)
+		return;
+
+	// keep the order with the quads that are already queued
+	Flush();
+
+	glVertexPointer(3, GL_FLOAT,
+			sizeof(CBufferVertex),
+			(char*)pBuffer->m_pVertices);
+	glTexCoordPointer(2, GL_FLOAT,
+			sizeof(CBufferVertex),
+			(char*)pBuffer->m_pVertices + sizeof(float)*3);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glColor4f(m_aColor[0].r, m_aColor[0].g, m_aColor[0].b, m_aColor[0].a);
+
+	if(m_RenderEnable)
+		glDrawArrays(GL_QUADS, FirstQuad*4, NumQuads*4);
+}
+
 int CGraphics_OpenGL::Init()
 {
 	m_pStorage = Kernel()->RequestInterface<IStorage>();
@@ -744,6 +826,16 @@ int CGraphics_OpenGL::Init()
 		m_aTextures[i].m_Next = i+1;
 	m_aTextures[MAX_TEXTURES-1].m_Next = -1;
 
+	// init vertex buffers
+	m_FirstFreeVertexBuffer = 0;
+	for(int i = 0; i < MAX_VERTEXBUFFERS; i++)
+	{
+		m_aVertexBuffers[i].m_pVertices = 0;
+		m_aVertexBuffers[i].m_NumQuads = 0;
+		m_aVertexBuffers[i].m_Next = i+1;
+	}
+	m_aVertexBuffers[MAX_VERTEXBUFFERS-1].m_Next = -1;
+
 	// set some default settings
 	glEnable(GL_BLEND);
 	glDisable(GL_CULL_FACE);
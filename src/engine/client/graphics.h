@@ -25,6 +25,7 @@ protected:
 	{
 		MAX_VERTICES = 32*1024,
 		MAX_TEXTURES = 1024*4,
+		MAX_VERTEXBUFFERS = 1024*4,
 
 		DRAWING_QUADS=1,
 		DRAWING_LINES=2
@@ -62,6 +63,22 @@ protected:
 	int m_FirstFreeTexture;
 	int m_TextureMemoryUsage;
 
+	typedef struct
+	{
+		CPoint m_Pos;
+		CTexCoord m_Tex;
+	} CBufferVertex;
+
+	struct CVertexBuffer
+	{
+		CBufferVertex *m_pVertices;
+		int m_NumQuads;
+		int m_Next;
+	};
+
+	CVertexBuffer m_aVertexBuffers[MAX_VERTEXBUFFERS];
+	int m_FirstFreeVertexBuffer;
+
 	void Flush();
 	void AddVertices(int Count);
 	void Rotate4(const CPoint &rCenter, CVertex *pPoints);
@@ -121,6 +138,11 @@ public:
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num);
 	virtual void QuadsText(float x, float y, float Size, const char *pText);
 
+	virtual int CreateVertexBuffer(const CVertexItem *pArray, int NumQuads);
+	virtual void UpdateVertexBuffer(int BufferID, const CVertexItem *pArray, int NumQuads);
+	virtual void DeleteVertexBuffer(int BufferID);
+	virtual void DrawVertexBuffer(int BufferID, int FirstQuad, int NumQuads);
+
 	virtual int Init();
 };
 
@@ -677,6 +677,98 @@ void CGraphics_Threaded::QuadsText(float x, float y, float Size, const char *pTe
 	}
 }
 
+int CGraphics_Threaded::CreateVertexBuffer(const CVertexItem *pArray, int NumQuads)
+{
+	// grab buffer
+	int Buffer = m_FirstFreeVertexBuffer;
+	if(Buffer == -1)
+	{
+		dbg_msg("graphics", "out of vertex buffers");
+		return -1;
+	}
+	m_FirstFreeVertexBuffer = m_aVertexBufferIndices[Buffer];
+	m_aVertexBufferIndices[Buffer] = -1;
+
+	CCommandBuffer::SCommand_VertexBuffer_Create Cmd;
+	Cmd.m_Slot = Buffer;
+	Cmd.m_NumQuads = NumQuads;
+
+	// copy vertex data
+	Cmd.m_pData = 0;
+	if(NumQuads > 0)
+	{
+		int MemSize = NumQuads*4*sizeof(CVertexItem);
+		Cmd.m_pData = (CVertexItem *)mem_alloc(MemSize, sizeof(void*));
+		mem_copy(Cmd.m_pData, pArray, MemSize);
+	}
+
+	//
+	m_pCommandBuffer->AddCommand(Cmd);
+	return Buffer;
+}
+
+void CGraphics_Threaded::UpdateVertexBuffer(int BufferID, const CVertexItem *pArray, int NumQuads)
+{
+	if(BufferID < 0)
+		return;
+
+	CCommandBuffer::SCommand_VertexBuffer_Update Cmd;
+	Cmd.m_Slot = BufferID;
+	Cmd.m_NumQuads = NumQuads;
+
+	// copy vertex data
+	Cmd.m_pData = 0;
+	if(NumQuads > 0)
+	{
+		int MemSize = NumQuads*4*sizeof(CVertexItem);
+		Cmd.m_pData = (CVertexItem *)mem_alloc(MemSize, sizeof(void*));
+		mem_copy(Cmd.m_pData, pArray, MemSize);
+	}
+
+	//
+	m_pCommandBuffer->AddCommand(Cmd);
+}
+
+void CGraphics_Threaded::DeleteVertexBuffer(int BufferID)
+{
+	if(BufferID < 0)
+		return;
+
+	CCommandBuffer::SCommand_VertexBuffer_Destroy Cmd;
+	Cmd.m_Slot = BufferID;
+	m_pCommandBuffer->AddCommand(Cmd);
+
+	m_aVertexBufferIndices[BufferID] = m_FirstFreeVertexBuffer;
+	m_FirstFreeVertexBuffer = BufferID;
+}
+
+void CGraphics_Threaded::DrawVertexBuffer(int BufferID, int FirstQuad, int NumQuads)
+{
+	dbg_assert(m_Drawing == DRAWING_QUADS, "called Graphics()->DrawVertexBuffer without begin");
+
+	if(BufferID < 0 || NumQuads <= 0)
+		return;
+
+	// keep the order with the quads that are already queued
+	FlushVertices();
+
+	CCommandBuffer::SCommand_RenderVertexBuffer Cmd;
+	Cmd.m_State = m_State;
+	Cmd.m_Color = m_aColor[0];
+	Cmd.m_Slot = BufferID;
+	Cmd.m_FirstQuad = FirstQuad;
+	Cmd.m_NumQuads = NumQuads;
+
+	if(!m_pCommandBuffer->AddCommand(Cmd))
+	{
+		// kick command buffer and try again
+		KickCommandBuffer();
+
+		if(!m_pCommandBuffer->AddCommand(Cmd))
+			dbg_msg("graphics", "failed to allocate memory for render command");
+	}
+}
+
 int CGraphics_Threaded::IssueInit()
 {
 	int Flags = 0;
@@ -745,7 +837,13 @@ int CGraphics_Threaded::Init()
 		m_aTextureIndices[i] = i+1;
 	m_aTextureIndices[MAX_TEXTURES-1] = -1;
 
-	m_pBackend = CreateGraphicsBackend();
+	// init vertex buffers
+	m_FirstFreeVertexBuffer = 0;
+	for(int i = 0; i < MAX_VERTEXBUFFERS-1; i++)
+		m_aVertexBufferIndices[i] = i+1;
+	m_aVertexBufferIndices[MAX_VERTEXBUFFERS-1] = -1;
+
+	m_pBackend = g_Config.m_GfxHeadless ? CreateGraphicsBackendNull() : CreateGraphicsBackend();
 	if(InitWindow() != 0)
 		return -1;
 
@@ -51,6 +51,7 @@ public:
 	enum
 	{
 		MAX_TEXTURES=1024*4,
+		MAX_VERTEXBUFFERS=1024*4,
 	};
 
 	enum
@@ -74,9 +75,15 @@ public:
 		CMD_TEXTURE_DESTROY,
 		CMD_TEXTURE_UPDATE,
 
+		// vertex buffer commands
+		CMD_VERTEXBUFFER_CREATE,
+		CMD_VERTEXBUFFER_DESTROY,
+		CMD_VERTEXBUFFER_UPDATE,
+
 		// rendering
 		CMD_CLEAR,
 		CMD_RENDER,
+		CMD_RENDER_VERTEXBUFFER,
 
 		// swap
 		CMD_SWAP,
@@ -182,6 +189,16 @@ public:
 		SVertex *m_pVertices; // you should use the command buffer data to allocate vertices for this command
 	};
 
+	struct SCommand_RenderVertexBuffer : public SCommand
+	{
+		SCommand_RenderVertexBuffer() : SCommand(CMD_RENDER_VERTEXBUFFER) {}
+		SState m_State;
+		SColor m_Color;
+		int m_Slot;
+		unsigned m_FirstQuad;
+		unsigned m_NumQuads;
+	};
+
 	struct SCommand_Screenshot : public SCommand
 	{
 		SCommand_Screenshot() : SCommand(CMD_SCREENSHOT) {}
@@ -244,6 +261,31 @@ public:
 		int m_Slot;
 	};
 	
+	struct SCommand_VertexBuffer_Create : public SCommand
+	{
+		SCommand_VertexBuffer_Create() : SCommand(CMD_VERTEXBUFFER_CREATE) {}
+
+		int m_Slot;
+		int m_NumQuads;
+		IGraphics::CVertexItem *m_pData; // will be freed by the command processor
+	};
+
+	struct SCommand_VertexBuffer_Update : public SCommand
+	{
+		SCommand_VertexBuffer_Update() : SCommand(CMD_VERTEXBUFFER_UPDATE) {}
+
+		int m_Slot;
+		int m_NumQuads;
+		IGraphics::CVertexItem *m_pData; // will be freed by the command processor
+	};
+
+	struct SCommand_VertexBuffer_Destroy : public SCommand
+	{
+		SCommand_VertexBuffer_Destroy() : SCommand(CMD_VERTEXBUFFER_DESTROY) {}
+
+		int m_Slot;
+	};
+
 	//
 	CCommandBuffer(unsigned CmdBufferSize, unsigned DataBufferSize)
 	: m_CmdBuffer(CmdBufferSize), m_DataBuffer(DataBufferSize)
@@ -325,6 +367,7 @@ class CGraphics_Threaded : public IEngineGraphics
 
 		MAX_VERTICES = 32*1024,
 		MAX_TEXTURES = 1024*4,
+		MAX_VERTEXBUFFERS = CCommandBuffer::MAX_VERTEXBUFFERS,
 		
 		DRAWING_QUADS=1,
 		DRAWING_LINES=2
@@ -360,6 +403,9 @@ class CGraphics_Threaded : public IEngineGraphics
 	int m_FirstFreeTexture;
 	int m_TextureMemoryUsage;
 
+	int m_aVertexBufferIndices[MAX_VERTEXBUFFERS];
+	int m_FirstFreeVertexBuffer;
+
 	void FlushVertices();
 	void AddVertices(int Count);
 	void Rotate4(const CCommandBuffer::SPoint &rCenter, CCommandBuffer::SVertex *pPoints);
@@ -421,6 +467,11 @@ public:
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num);
 	virtual void QuadsText(float x, float y, float Size, const char *pText);
 
+	virtual int CreateVertexBuffer(const CVertexItem *pArray, int NumQuads);
+	virtual void UpdateVertexBuffer(int BufferID, const CVertexItem *pArray, int NumQuads);
+	virtual void DeleteVertexBuffer(int BufferID);
+	virtual void DrawVertexBuffer(int BufferID, int FirstQuad, int NumQuads);
+
 	virtual void Minimize();
 	virtual void Maximize();
 
@@ -442,3 +493,4 @@ public:
 };
 
 extern IGraphicsBackend *CreateGraphicsBackend();
+extern IGraphicsBackend *CreateGraphicsBackendNull();
@@ -1,6 +1,6 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
-#include <algorithm> // sort  TODO: remove this
+#include <algorithm> // sort, lower_bound  TODO: remove this
 
 #include <base/math.h>
 #include <base/system.h>
@@ -26,9 +26,20 @@ class SortWrap
 	CServerBrowser *m_pThis;
 public:
 	SortWrap(CServerBrowser *t, SortFunc f) : m_pfnSort(f), m_pThis(t) {}
-	bool operator()(int a, int b) { return (g_Config.m_BrSortOrder ? (m_pThis->*m_pfnSort)(b, a) : (m_pThis->*m_pfnSort)(a, b)); }
+	bool operator()(int a, int b) { return (m_pThis->*m_pfnSort)(a, b); }
 };
 
+static unsigned AddrHash(const NETADDR &Addr)
+{
+	// fnv-1a over the whole address
+	unsigned Hash = 2166136261u^Addr.type;
+	for(int i = 0; i < (int)sizeof(Addr.ip); i++)
+		Hash = (Hash^Addr.ip[i])*16777619u;
+	Hash = (Hash^(Addr.port&0xff))*16777619u;
+	Hash = (Hash^(Addr.port>>8))*16777619u;
+	return Hash^(Hash>>16);
+}
+
 CServerBrowser::CServerBrowser()
 {
 	m_pMasterServer = 0;
@@ -39,9 +50,12 @@ CServerBrowser::CServerBrowser()
 
 	mem_zero(m_aServerlistIp, sizeof(m_aServerlistIp));
 
-	m_pFirstReqServer = 0; // request list
+	m_pFirstReqServer = 0; // request queue
 	m_pLastReqServer = 0;
+	mem_zero(m_apRequestWheel, sizeof(m_apRequestWheel));
+	m_RequestWheelTick = 0;
 	m_NumRequests = 0;
+	m_NumSentRequests = 0;
 
 	m_NeedRefresh = 0;
 
@@ -125,135 +139,169 @@ bool CServerBrowser::SortCompareNumClients(int Index1, int Index2) const
 	return a->m_Info.m_NumClients < b->m_Info.m_NumClients;
 }
 
-void CServerBrowser::Filter()
+bool CServerBrowser::SortCompare(int Index1, int Index2) const
 {
-	int i = 0, p = 0;
-	m_NumSortedServers = 0;
+	bool (CServerBrowser::*pfnSort)(int, int) const = 0;
+	if(g_Config.m_BrSort == IServerBrowser::SORT_NAME)
+		pfnSort = &CServerBrowser::SortCompareName;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_PING)
+		pfnSort = &CServerBrowser::SortComparePing;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_MAP)
+		pfnSort = &CServerBrowser::SortCompareMap;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_NUMPLAYERS)
+		pfnSort = g_Config.m_BrFilterSpectators ? &CServerBrowser::SortCompareNumPlayers : &CServerBrowser::SortCompareNumClients;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_GAMETYPE)
+		pfnSort = &CServerBrowser::SortCompareGametype;
 
-	// allocate the sorted list
-	if(m_NumSortedServersCapacity < m_NumServers)
+	// servers that compare equal keep the order they were added in, that makes
+	// the order unique so single servers can be inserted with a binary search
+	if(pfnSort)
 	{
-		if(m_pSortedServerlist)
-			mem_free(m_pSortedServerlist);
-		m_NumSortedServersCapacity = m_NumServers;
-		m_pSortedServerlist = (int *)mem_alloc(m_NumSortedServersCapacity*sizeof(int), 1);
+		int a = g_Config.m_BrSortOrder ? Index2 : Index1;
+		int b = g_Config.m_BrSortOrder ? Index1 : Index2;
+		if((this->*pfnSort)(a, b))
+			return true;
+		if((this->*pfnSort)(b, a))
+			return false;
 	}
+	return Index1 < Index2;
+}
 
-	// filter the servers
-	for(i = 0; i < m_NumServers; i++)
+bool CServerBrowser::IsFiltered(CServerEntry *pEntry)
+{
+	int p;
+	int Filtered = 0;
+
+	if(g_Config.m_BrFilterEmpty && ((g_Config.m_BrFilterSpectators && pEntry->m_Info.m_NumPlayers == 0) || pEntry->m_Info.m_NumClients == 0))
+		Filtered = 1;
+	else if(g_Config.m_BrFilterFull && ((g_Config.m_BrFilterSpectators && pEntry->m_Info.m_NumPlayers == pEntry->m_Info.m_MaxPlayers) ||
+			pEntry->m_Info.m_NumClients == pEntry->m_Info.m_MaxClients))
+		Filtered = 1;
+	else if(g_Config.m_BrFilterPw && pEntry->m_Info.m_Flags&SERVER_FLAG_PASSWORD)
+		Filtered = 1;
+	else if(g_Config.m_BrFilterPure &&
+		(str_comp(pEntry->m_Info.m_aGameType, "DM") != 0 &&
+		str_comp(pEntry->m_Info.m_aGameType, "TDM") != 0 &&
+		str_comp(pEntry->m_Info.m_aGameType, "CTF") != 0))
 	{
-		int Filtered = 0;
-
-		if(g_Config.m_BrFilterEmpty && ((g_Config.m_BrFilterSpectators && m_ppServerlist[i]->m_Info.m_NumPlayers == 0) || m_ppServerlist[i]->m_Info.m_NumClients == 0))
-			Filtered = 1;
-		else if(g_Config.m_BrFilterFull && ((g_Config.m_BrFilterSpectators && m_ppServerlist[i]->m_Info.m_NumPlayers == m_ppServerlist[i]->m_Info.m_MaxPlayers) ||
-				m_ppServerlist[i]->m_Info.m_NumClients == m_ppServerlist[i]->m_Info.m_MaxClients))
-			Filtered = 1;
-		else if(g_Config.m_BrFilterPw && m_ppServerlist[i]->m_Info.m_Flags&SERVER_FLAG_PASSWORD)
-			Filtered = 1;
-		else if(g_Config.m_BrFilterPure &&
-			(str_comp(m_ppServerlist[i]->m_Info.m_aGameType, "DM") != 0 &&
-			str_comp(m_ppServerlist[i]->m_Info.m_aGameType, "TDM") != 0 &&
-			str_comp(m_ppServerlist[i]->m_Info.m_aGameType, "CTF") != 0))
-		{
-			Filtered = 1;
-		}
-		else if(g_Config.m_BrFilterPureMap &&
-			!(str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm1") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm2") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm6") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm7") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm8") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm9") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf1") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf2") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf3") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf4") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf5") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf6") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf7") == 0)
-		)
+		Filtered = 1;
+	}
+	else if(g_Config.m_BrFilterPureMap &&
+		!(str_comp(pEntry->m_Info.m_aMap, "dm1") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm2") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm6") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm7") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm8") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm9") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf1") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf2") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf3") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf4") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf5") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf6") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf7") == 0)
+	)
+	{
+		Filtered = 1;
+	}
+	else if(g_Config.m_BrFilterPing < pEntry->m_Info.m_Latency)
+		Filtered = 1;
+	else if(g_Config.m_BrFilterCompatversion && str_comp_num(pEntry->m_Info.m_aVersion, m_aNetVersion, 3) != 0)
+		Filtered = 1;
+	else if(g_Config.m_BrFilterServerAddress[0] && !str_find_nocase(pEntry->m_Info.m_aAddress, g_Config.m_BrFilterServerAddress))
+		Filtered = 1;
+	else if(g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && str_comp_nocase(pEntry->m_Info.m_aGameType, g_Config.m_BrFilterGametype))
+		Filtered = 1;
+	else if(!g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && !str_find_nocase(pEntry->m_Info.m_aGameType, g_Config.m_BrFilterGametype))
+		Filtered = 1;
+	else
+	{
+		if(g_Config.m_BrFilterCountry)
 		{
 			Filtered = 1;
-		}
-		else if(g_Config.m_BrFilterPing < m_ppServerlist[i]->m_Info.m_Latency)
-			Filtered = 1;
-		else if(g_Config.m_BrFilterCompatversion && str_comp_num(m_ppServerlist[i]->m_Info.m_aVersion, m_aNetVersion, 3) != 0)
-			Filtered = 1;
-		else if(g_Config.m_BrFilterServerAddress[0] && !str_find_nocase(m_ppServerlist[i]->m_Info.m_aAddress, g_Config.m_BrFilterServerAddress))
-			Filtered = 1;
-		else if(g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && str_comp_nocase(m_ppServerlist[i]->m_Info.m_aGameType, g_Config.m_BrFilterGametype))
-			Filtered = 1;
-		else if(!g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && !str_find_nocase(m_ppServerlist[i]->m_Info.m_aGameType, g_Config.m_BrFilterGametype))
-			Filtered = 1;
-		else
-		{
-			if(g_Config.m_BrFilterCountry)
+			// match against player country
+			for(p = 0; p < pEntry->m_Info.m_NumClients; p++)
 			{
-				Filtered = 1;
-				// match against player country
-				for(p = 0; p < m_ppServerlist[i]->m_Info.m_NumClients; p++)
+				if(pEntry->m_Info.m_aClients[p].m_Country == g_Config.m_BrFilterCountryIndex)
 				{
-					if(m_ppServerlist[i]->m_Info.m_aClients[p].m_Country == g_Config.m_BrFilterCountryIndex)
-					{
-						Filtered = 0;
-						break;
-					}
+					Filtered = 0;
+					break;
 				}
 			}
+		}
 
-			if(!Filtered && g_Config.m_BrFilterString[0] != 0)
-			{
-				int MatchFound = 0;
-
-				m_ppServerlist[i]->m_Info.m_QuickSearchHit = 0;
+		if(!Filtered && g_Config.m_BrFilterString[0] != 0)
+		{
+			int MatchFound = 0;
 
-				// match against server name
-				if(str_find_nocase(m_ppServerlist[i]->m_Info.m_aName, g_Config.m_BrFilterString))
-				{
-					MatchFound = 1;
-					m_ppServerlist[i]->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_SERVERNAME;
-				}
+			pEntry->m_Info.m_QuickSearchHit = 0;
 
-				// match against players
-				for(p = 0; p < m_ppServerlist[i]->m_Info.m_NumClients; p++)
-				{
-					if(str_find_nocase(m_ppServerlist[i]->m_Info.m_aClients[p].m_aName, g_Config.m_BrFilterString) ||
-						str_find_nocase(m_ppServerlist[i]->m_Info.m_aClients[p].m_aClan, g_Config.m_BrFilterString))
-					{
-						MatchFound = 1;
-						m_ppServerlist[i]->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_PLAYER;
-						break;
-					}
-				}
+			// match against server name
+			if(str_find_nocase(pEntry->m_Info.m_aName, g_Config.m_BrFilterString))
+			{
+				MatchFound = 1;
+				pEntry->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_SERVERNAME;
+			}
 
-				// match against map
-				if(str_find_nocase(m_ppServerlist[i]->m_Info.m_aMap, g_Config.m_BrFilterString))
+			// match against players
+			for(p = 0; p < pEntry->m_Info.m_NumClients; p++)
+			{
+				if(str_find_nocase(pEntry->m_Info.m_aClients[p].m_aName, g_Config.m_BrFilterString) ||
+					str_find_nocase(pEntry->m_Info.m_aClients[p].m_aClan, g_Config.m_BrFilterString))
 				{
 					MatchFound = 1;
-					m_ppServerlist[i]->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_MAPNAME;
+					pEntry->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_PLAYER;
+					break;
 				}
-
-				if(!MatchFound)
-					Filtered = 1;
 			}
-		}
 
-		if(Filtered == 0)
-		{
-			// check for friend
-			m_ppServerlist[i]->m_Info.m_FriendState = IFriends::FRIEND_NO;
-			for(p = 0; p < m_ppServerlist[i]->m_Info.m_NumClients; p++)
+			// match against map
+			if(str_find_nocase(pEntry->m_Info.m_aMap, g_Config.m_BrFilterString))
 			{
-				m_ppServerlist[i]->m_Info.m_aClients[p].m_FriendState = m_pFriends->GetFriendState(m_ppServerlist[i]->m_Info.m_aClients[p].m_aName,
-					m_ppServerlist[i]->m_Info.m_aClients[p].m_aClan);
-				m_ppServerlist[i]->m_Info.m_FriendState = max(m_ppServerlist[i]->m_Info.m_FriendState, m_ppServerlist[i]->m_Info.m_aClients[p].m_FriendState);
+				MatchFound = 1;
+				pEntry->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_MAPNAME;
 			}
 
-			if(!g_Config.m_BrFilterFriends || m_ppServerlist[i]->m_Info.m_FriendState != IFriends::FRIEND_NO)
-				m_pSortedServerlist[m_NumSortedServers++] = i;
+			if(!MatchFound)
+				Filtered = 1;
 		}
 	}
+
+	if(Filtered)
+		return true;
+
+	// check for friend
+	pEntry->m_Info.m_FriendState = IFriends::FRIEND_NO;
+	for(p = 0; p < pEntry->m_Info.m_NumClients; p++)
+	{
+		pEntry->m_Info.m_aClients[p].m_FriendState = m_pFriends->GetFriendState(pEntry->m_Info.m_aClients[p].m_aName,
+			pEntry->m_Info.m_aClients[p].m_aClan);
+		pEntry->m_Info.m_FriendState = max(pEntry->m_Info.m_FriendState, pEntry->m_Info.m_aClients[p].m_FriendState);
+	}
+
+	return g_Config.m_BrFilterFriends && pEntry->m_Info.m_FriendState == IFriends::FRIEND_NO;
+}
+
+void CServerBrowser::Filter()
+{
+	m_NumSortedServers = 0;
+
+	// allocate the sorted list
+	if(m_NumSortedServersCapacity < m_NumServerCapacity)
+	{
+		if(m_pSortedServerlist)
+			mem_free(m_pSortedServerlist);
+		m_NumSortedServersCapacity = m_NumServerCapacity;
+		m_pSortedServerlist = (int *)mem_alloc(m_NumSortedServersCapacity*sizeof(int), 1);
+	}
+
+	// filter the servers
+	for(int i = 0; i < m_NumServers; i++)
+	{
+		m_ppServerlist[i]->m_Info.m_SortedIndex = -1;
+		if(!IsFiltered(m_ppServerlist[i]))
+			m_pSortedServerlist[m_NumSortedServers++] = i;
+	}
 }
 
 int CServerBrowser::SortHash() const
@@ -282,17 +330,7 @@ void CServerBrowser::Sort()
 	Filter();
 
 	// sort
-	if(g_Config.m_BrSort == IServerBrowser::SORT_NAME)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortCompareName));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_PING)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortComparePing));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_MAP)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortCompareMap));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_NUMPLAYERS)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this,
-					g_Config.m_BrFilterSpectators ? &CServerBrowser::SortCompareNumPlayers : &CServerBrowser::SortCompareNumClients));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_GAMETYPE)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortCompareGametype));
+	std::sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortCompare));
 
 	// set indexes
 	for(i = 0; i < m_NumSortedServers; i++)
@@ -303,29 +341,101 @@ void CServerBrowser::Sort()
 	m_Sorthash = SortHash();
 }
 
-void CServerBrowser::RemoveRequest(CServerEntry *pEntry)
+bool CServerBrowser::IsSorted() const
+{
+	return m_Sorthash == SortHash() && str_comp(m_aFilterGametypeString, g_Config.m_BrFilterGametype) == 0 &&
+		str_comp(m_aFilterString, g_Config.m_BrFilterString) == 0;
+}
+
+void CServerBrowser::SortEntry(CServerEntry *pEntry)
 {
-	if(pEntry->m_pPrevReq || pEntry->m_pNextReq || m_pFirstReqServer == pEntry)
+	// the filters or the sorting changed, the whole list has to be redone
+	if(!IsSorted())
 	{
-		if(pEntry->m_pPrevReq)
-			pEntry->m_pPrevReq->m_pNextReq = pEntry->m_pNextReq;
-		else
-			m_pFirstReqServer = pEntry->m_pNextReq;
+		Sort();
+		return;
+	}
 
-		if(pEntry->m_pNextReq)
-			pEntry->m_pNextReq->m_pPrevReq = pEntry->m_pPrevReq;
-		else
-			m_pLastReqServer = pEntry->m_pPrevReq;
+	if(m_NumSortedServersCapacity < m_NumServerCapacity)
+	{
+		int *pNewlist = (int *)mem_alloc(m_NumServerCapacity*sizeof(int), 1);
+		if(m_pSortedServerlist)
+		{
+			mem_copy(pNewlist, m_pSortedServerlist, m_NumSortedServers*sizeof(int));
+			mem_free(m_pSortedServerlist);
+		}
+		m_pSortedServerlist = pNewlist;
+		m_NumSortedServersCapacity = m_NumServerCapacity;
+	}
+
+	// take it out of the sorted list
+	int Index = pEntry->m_Info.m_ServerIndex;
+	int OldPos = pEntry->m_Info.m_SortedIndex;
+	int First = m_NumSortedServers;
+	int Last = m_NumSortedServers;
+	if(OldPos >= 0)
+	{
+		mem_move(&m_pSortedServerlist[OldPos], &m_pSortedServerlist[OldPos+1], (m_NumSortedServers-OldPos-1)*sizeof(int));
+		m_NumSortedServers--;
+		pEntry->m_Info.m_SortedIndex = -1;
+		First = OldPos;
+		Last = m_NumSortedServers;
+	}
 
-		pEntry->m_pPrevReq = 0;
-		pEntry->m_pNextReq = 0;
-		m_NumRequests--;
+	// and insert it again where it belongs now
+	if(!IsFiltered(pEntry))
+	{
+		int NewPos = std::lower_bound(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, Index,
+			SortWrap(this, &CServerBrowser::SortCompare)) - m_pSortedServerlist;
+		mem_move(&m_pSortedServerlist[NewPos+1], &m_pSortedServerlist[NewPos], (m_NumSortedServers-NewPos)*sizeof(int));
+		m_pSortedServerlist[NewPos] = Index;
+		m_NumSortedServers++;
+		if(OldPos >= 0)
+		{
+			First = min(OldPos, NewPos);
+			Last = max(OldPos, NewPos)+1;
+		}
+		else
+		{
+			First = NewPos;
+			Last = m_NumSortedServers;
+		}
 	}
+
+	// only the servers between the old and the new position moved
+	for(int i = First; i < Last; i++)
+		m_ppServerlist[m_pSortedServerlist[i]]->m_Info.m_SortedIndex = i;
+}
+
+void CServerBrowser::RemoveRequest(CServerEntry *pEntry)
+{
+	if(pEntry->m_RequestState == CServerEntry::REQUEST_NONE)
+		return;
+
+	CServerEntry **ppFirst = pEntry->m_RequestState == CServerEntry::REQUEST_SENT ?
+		&m_apRequestWheel[pEntry->m_RequestTimeoutTick%REQUEST_WHEEL_SIZE] : &m_pFirstReqServer;
+
+	if(pEntry->m_pPrevReq)
+		pEntry->m_pPrevReq->m_pNextReq = pEntry->m_pNextReq;
+	else
+		*ppFirst = pEntry->m_pNextReq;
+
+	if(pEntry->m_pNextReq)
+		pEntry->m_pNextReq->m_pPrevReq = pEntry->m_pPrevReq;
+	else if(pEntry->m_RequestState == CServerEntry::REQUEST_QUEUED)
+		m_pLastReqServer = pEntry->m_pPrevReq;
+
+	if(pEntry->m_RequestState == CServerEntry::REQUEST_SENT)
+		m_NumSentRequests--;
+	pEntry->m_pPrevReq = 0;
+	pEntry->m_pNextReq = 0;
+	pEntry->m_RequestState = CServerEntry::REQUEST_NONE;
+	m_NumRequests--;
 }
 
 CServerBrowser::CServerEntry *CServerBrowser::Find(const NETADDR &Addr)
 {
-	CServerEntry *pEntry = m_aServerlistIp[Addr.ip[0]];
+	CServerEntry *pEntry = m_aServerlistIp[AddrHash(Addr)&(SERVERLIST_HASH_SIZE-1)];
 
 	for(; pEntry; pEntry = pEntry->m_pNextIp)
 	{
@@ -339,20 +449,82 @@ void CServerBrowser::QueueRequest(CServerEntry *pEntry)
 {
 	// add it to the list of servers that we should request info from
 	pEntry->m_pPrevReq = m_pLastReqServer;
+	pEntry->m_pNextReq = 0;
 	if(m_pLastReqServer)
 		m_pLastReqServer->m_pNextReq = pEntry;
 	else
 		m_pFirstReqServer = pEntry;
 	m_pLastReqServer = pEntry;
 
+	pEntry->m_RequestState = CServerEntry::REQUEST_QUEUED;
+	m_NumRequests++;
+}
+
+void CServerBrowser::SendRequest(CServerEntry *pEntry, int64 Now)
+{
+	// take it out of the queue, it stays a request until it gets answered or times out
+	RemoveRequest(pEntry);
+	RequestImpl(pEntry->m_Addr, pEntry);
+
+	// every retry waits a second longer for the answer
+	int64 SlotTime = time_freq()/REQUEST_WHEEL_FREQ;
+	pEntry->m_RequestTimeoutTick = (Now+time_freq()*(1+pEntry->m_NumRetries))/SlotTime+1;
+
+	CServerEntry **ppSlot = &m_apRequestWheel[pEntry->m_RequestTimeoutTick%REQUEST_WHEEL_SIZE];
+	pEntry->m_pPrevReq = 0;
+	pEntry->m_pNextReq = *ppSlot;
+	if(*ppSlot)
+		(*ppSlot)->m_pPrevReq = pEntry;
+	*ppSlot = pEntry;
+
+	pEntry->m_RequestState = CServerEntry::REQUEST_SENT;
+	m_NumSentRequests++;
 	m_NumRequests++;
 }
 
+void CServerBrowser::TimeoutRequests(int64 Now)
+{
+	int64 Tick = Now/(time_freq()/REQUEST_WHEEL_FREQ);
+	if(m_RequestWheelTick > Tick)
+		return;
+
+	// go through the slots that passed since the last update, every slot at most once
+	int64 Last = min(Tick, m_RequestWheelTick+REQUEST_WHEEL_SIZE-1);
+	for(int64 t = m_RequestWheelTick; t <= Last; t++)
+	{
+		CServerEntry *pEntry = m_apRequestWheel[t%REQUEST_WHEEL_SIZE];
+		while(pEntry)
+		{
+			CServerEntry *pNext = pEntry->m_pNextReq;
+
+			// the slot also holds requests that time out one turn of the wheel later
+			if(pEntry->m_RequestTimeoutTick <= Tick)
+			{
+				RemoveRequest(pEntry);
+				if(pEntry->m_NumRetries < g_Config.m_BrMaxRetries)
+				{
+					// ask again, a late answer to the old request is ignored so the latency stays right
+					pEntry->m_NumRetries++;
+					pEntry->m_CurrentToken = (pEntry->m_CurrentToken+1)%CServerEntry::MAX_TOKEN;
+					QueueRequest(pEntry);
+				}
+			}
+
+			pEntry = pNext;
+		}
+	}
+	m_RequestWheelTick = Tick+1;
+}
+
 void CServerBrowser::SetInfo(CServerEntry *pEntry, const CServerInfo &Info)
 {
 	int Fav = pEntry->m_Info.m_Favorite;
+	int ServerIndex = pEntry->m_Info.m_ServerIndex;
+	int SortedIndex = pEntry->m_Info.m_SortedIndex;
 	pEntry->m_Info = Info;
 	pEntry->m_Info.m_Favorite = Fav;
+	pEntry->m_Info.m_ServerIndex = ServerIndex;
+	pEntry->m_Info.m_SortedIndex = SortedIndex;
 	pEntry->m_Info.m_NetAddr = pEntry->m_Addr;
 
 	// all these are just for nice compability
@@ -374,7 +546,7 @@ void CServerBrowser::SetInfo(CServerEntry *pEntry, const CServerInfo &Info)
 
 CServerBrowser::CServerEntry *CServerBrowser::Add(const NETADDR &Addr)
 {
-	int Hash = Addr.ip[0];
+	int Hash = AddrHash(Addr)&(SERVERLIST_HASH_SIZE-1);
 
 	// create new pEntry
 	CServerEntry *pEntry = (CServerEntry *)m_ServerlistHeap.Allocate(sizeof(CServerEntry));
@@ -385,6 +557,7 @@ CServerBrowser::CServerEntry *CServerBrowser::Add(const NETADDR &Addr)
 	pEntry->m_InfoState = CServerEntry::STATE_INVALID;
 	pEntry->m_CurrentToken = rand()%CServerEntry::MAX_TOKEN;
 	pEntry->m_Info.m_NetAddr = Addr;
+	pEntry->m_Info.m_SortedIndex = -1;
 
 	pEntry->m_Info.m_Latency = 999;
 	net_addr_str(&Addr, pEntry->m_Info.m_aAddress, sizeof(pEntry->m_Info.m_aAddress), true);
@@ -463,7 +636,9 @@ void CServerBrowser::Set(const NETADDR &Addr, int Type, int Token, const CServer
 		}
 	}
 
-	Sort();
+	// only the changed server has to be filtered and moved
+	if(pEntry)
+		SortEntry(pEntry);
 }
 
 void CServerBrowser::Refresh(int Type)
@@ -475,7 +650,10 @@ void CServerBrowser::Refresh(int Type)
 	mem_zero(m_aServerlistIp, sizeof(m_aServerlistIp));
 	m_pFirstReqServer = 0;
 	m_pLastReqServer = 0;
+	mem_zero(m_apRequestWheel, sizeof(m_apRequestWheel));
+	m_RequestWheelTick = time_get()/(time_freq()/REQUEST_WHEEL_FREQ);
 	m_NumRequests = 0;
+	m_NumSentRequests = 0;
 
 	// next token
 	m_CurrentLanToken = (m_CurrentLanToken+1)&0xff;
@@ -559,10 +737,7 @@ void CServerBrowser::Request(const NETADDR &Addr) const
 
 void CServerBrowser::Update(bool ForceResort)
 {
-	int64 Timeout = time_freq();
 	int64 Now = time_get();
-	int Count;
-	CServerEntry *pEntry, *pNext;
 
 	// do server list requests
 	if(m_NeedRefresh && !m_pMasterServer->IsRefreshing())
@@ -594,41 +769,11 @@ void CServerBrowser::Update(bool ForceResort)
 	}
 
 	// do timeouts
-	pEntry = m_pFirstReqServer;
-	while(1)
-	{
-		if(!pEntry) // no more entries
-			break;
-
-		pNext = pEntry->m_pNextReq;
-
-		if(pEntry->m_RequestTime && pEntry->m_RequestTime+Timeout < Now)
-		{
-			// timeout
-			RemoveRequest(pEntry);
-		}
-
-		pEntry = pNext;
-	}
-
-	// do timeouts
-	pEntry = m_pFirstReqServer;
-	Count = 0;
-	while(1)
-	{
-		if(!pEntry) // no more entries
-			break;
-
-		// no more then 10 concurrent requests
-		if(Count == g_Config.m_BrMaxRequests)
-			break;
+	TimeoutRequests(Now);
 
-		if(pEntry->m_RequestTime == 0)
-			RequestImpl(pEntry->m_Addr, pEntry);
-
-		Count++;
-		pEntry = pEntry->m_pNextReq;
-	}
+	// send the queued requests, no more then br_max_requests at once
+	while(m_pFirstReqServer && m_NumSentRequests < g_Config.m_BrMaxRequests)
+		SendRequest(m_pFirstReqServer, Now);
 
 	// check if we need to resort
 	if(m_Sorthash != SortHash() || ForceResort)
@@ -701,7 +846,7 @@ void CServerBrowser::RemoveFavorite(const NETADDR &Addr)
 
 bool CServerBrowser::IsRefreshing() const
 {
-	return m_pFirstReqServer != 0;
+	return m_NumRequests != 0;
 }
 
 bool CServerBrowser::IsRefreshingMasters() const
@@ -19,21 +19,37 @@ public:
 			MAX_TOKEN=0xFF
 		};
 
+		enum
+		{
+			REQUEST_NONE=0,
+			REQUEST_QUEUED,
+			REQUEST_SENT
+		};
+
 		NETADDR m_Addr;
 		int64 m_RequestTime;
 		int m_InfoState;
 		int m_CurrentToken;	// the token is to keep server refresh separated from each other
 		CServerInfo m_Info;
 
-		CServerEntry *m_pNextIp; // ip hashed list
+		CServerEntry *m_pNextIp; // address hashed list
 
-		CServerEntry *m_pPrevReq; // request list
+		int m_RequestState;
+		int m_NumRetries;
+		int64 m_RequestTimeoutTick; // request wheel tick the sent request times out at
+		CServerEntry *m_pPrevReq; // request queue or request wheel slot
 		CServerEntry *m_pNextReq;
 	};
 
 	enum
 	{
-		MAX_FAVORITES=256
+		MAX_FAVORITES=256,
+
+		SERVERLIST_HASH_SIZE=4096,
+
+		// sent requests are kept in a timer wheel, one slot per 1/REQUEST_WHEEL_FREQ seconds
+		REQUEST_WHEEL_SIZE=64,
+		REQUEST_WHEEL_FREQ=16
 	};
 
 	CServerBrowser();
@@ -74,11 +90,14 @@ private:
 	NETADDR m_aFavoriteServers[MAX_FAVORITES];
 	int m_NumFavoriteServers;
 
-	CServerEntry *m_aServerlistIp[256]; // ip hash list
+	CServerEntry *m_aServerlistIp[SERVERLIST_HASH_SIZE]; // address hash list
 
-	CServerEntry *m_pFirstReqServer; // request list
+	CServerEntry *m_pFirstReqServer; // request queue, servers that wait for their request to be sent
 	CServerEntry *m_pLastReqServer;
-	int m_NumRequests;
+	CServerEntry *m_apRequestWheel[REQUEST_WHEEL_SIZE]; // sent requests by the tick they time out
+	int64 m_RequestWheelTick;
+	int m_NumRequests; // queued and sent
+	int m_NumSentRequests;
 
 	int m_NeedRefresh;
 
@@ -104,10 +123,14 @@ private:
 	bool SortCompareGametype(int Index1, int Index2) const;
 	bool SortCompareNumPlayers(int Index1, int Index2) const;
 	bool SortCompareNumClients(int Index1, int Index2) const;
+	bool SortCompare(int Index1, int Index2) const;
 
 	//
+	bool IsFiltered(CServerEntry *pEntry);
 	void Filter();
 	void Sort();
+	void SortEntry(CServerEntry *pEntry);
+	bool IsSorted() const;
 	int SortHash() const;
 
 	CServerEntry *Find(const NETADDR &Addr);
@@ -115,6 +138,8 @@ private:
 
 	void RemoveRequest(CServerEntry *pEntry);
 	void QueueRequest(CServerEntry *pEntry);
+	void SendRequest(CServerEntry *pEntry, int64 Now);
+	void TimeoutRequests(int64 Now);
 
 	void RequestImpl(const NETADDR &Addr, CServerEntry *pEntry) const;
 
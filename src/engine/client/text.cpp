@@ -17,6 +17,11 @@
 enum
 {
 	MAX_CHARACTERS = 64,
+
+	CHAR_HASH_SIZE = MAX_CHARACTERS*MAX_CHARACTERS,
+
+	TEXT_LAYOUT_CACHE_SIZE = 1024,
+	TEXT_LAYOUT_HASH_SIZE = 2048,
 };
 
 
@@ -37,6 +42,11 @@ struct CFontChar
 
 	float m_aUvs[4];
 	int64 m_TouchTime;
+
+	// slot lookup and eviction order
+	int m_HashNext;
+	int m_LruPrev;
+	int m_LruNext;
 };
 
 struct CFontSizeData
@@ -57,6 +67,10 @@ struct CFontSizeData
 	CFontChar m_aCharacters[MAX_CHARACTERS*MAX_CHARACTERS];
 
 	int m_CurrentCharacter;
+
+	int m_aCharHash[CHAR_HASH_SIZE]; // codepoint -> first slot
+	int m_LruFirst; // most recently used slot
+	int m_LruLast; // next slot to kick out
 };
 
 class CFont
@@ -67,6 +81,43 @@ public:
 	CFontSizeData m_aSizes[NUM_FONT_SIZES];
 };
 
+// glyph placed by the layout, relative to the cursor
+struct CGlyphPos
+{
+	int m_Chr;
+	float m_X;
+	float m_Y;
+};
+
+// result of laying out a text run. the ui redraws the same strings every frame, so runs are kept
+// in a cache keyed by everything the layout depends on
+struct CTextLayout
+{
+	unsigned m_Hash;
+	CFont *m_pFont;
+	int m_FontSize;
+	int m_Flags;
+	int m_MaxLines;
+	int m_StartLineCount;
+	float m_FakeToScreenX;
+	float m_FakeToScreenY;
+	float m_LineWidth;
+	float m_OffsetX; // rounding of the cursor, matters for the line width checks
+	int m_Length;
+	char *m_pText;
+
+	CGlyphPos *m_pGlyphs; // only for rendered runs
+	int m_NumGlyphs;
+	float m_EndX;
+	float m_EndY;
+	int m_LineCount;
+	bool m_GotNewLine;
+
+	int m_HashNext;
+	int m_LruPrev;
+	int m_LruNext;
+};
+
 
 class CTextRender : public IEngineTextRender
 {
@@ -166,6 +217,12 @@ class CTextRender : public IEngineTextRender
 		pSizeData->m_TextureWidth = Width;
 		pSizeData->m_TextureHeight = Height;
 		pSizeData->m_CurrentCharacter = 0;
+
+		// all glyphs are gone
+		for(int i = 0; i < CHAR_HASH_SIZE; i++)
+			pSizeData->m_aCharHash[i] = -1;
+		pSizeData->m_LruFirst = -1;
+		pSizeData->m_LruLast = -1;
 		
 		dbg_msg("", "pFont memory usage: %d", FontMemoryUsage);
 
@@ -270,14 +327,10 @@ class CTextRender : public IEngineTextRender
 		}
 
 		// kick out the oldest
-		// TODO: remove this linear search
 		{
-			int Oldest = 0;
-			for(int i = 1; i < CharCount; i++)
-			{
-				if(pSizeData->m_aCharacters[i].m_TouchTime < pSizeData->m_aCharacters[Oldest].m_TouchTime)
-					Oldest = i;
-			}
+			int Oldest = pSizeData->m_LruLast;
+			if(Oldest < 0)
+				return -1;
 
 			if(time_get()-pSizeData->m_aCharacters[Oldest].m_TouchTime < time_freq() &&
 				(pSizeData->m_NumXChars < MAX_CHARACTERS || pSizeData->m_NumYChars < MAX_CHARACTERS))
@@ -286,10 +339,57 @@ class CTextRender : public IEngineTextRender
 				return GetSlot(pSizeData);
 			}
 
+			UnlinkChar(pSizeData, Oldest);
 			return Oldest;
 		}
 	}
 
+	static int CharHash(int Chr) { return Chr&(CHAR_HASH_SIZE-1); }
+
+	void LinkChar(CFontSizeData *pSizeData, int SlotID)
+	{
+		CFontChar *pChr = &pSizeData->m_aCharacters[SlotID];
+		int Hash = CharHash(pChr->m_ID);
+		pChr->m_HashNext = pSizeData->m_aCharHash[Hash];
+		pSizeData->m_aCharHash[Hash] = SlotID;
+		LruPushFront(pSizeData, SlotID);
+	}
+
+	void UnlinkChar(CFontSizeData *pSizeData, int SlotID)
+	{
+		CFontChar *pChr = &pSizeData->m_aCharacters[SlotID];
+		int *pLink = &pSizeData->m_aCharHash[CharHash(pChr->m_ID)];
+		while(*pLink != SlotID)
+			pLink = &pSizeData->m_aCharacters[*pLink].m_HashNext;
+		*pLink = pChr->m_HashNext;
+		LruRemove(pSizeData, SlotID);
+	}
+
+	void LruPushFront(CFontSizeData *pSizeData, int SlotID)
+	{
+		CFontChar *pChr = &pSizeData->m_aCharacters[SlotID];
+		pChr->m_LruPrev = -1;
+		pChr->m_LruNext = pSizeData->m_LruFirst;
+		if(pSizeData->m_LruFirst >= 0)
+			pSizeData->m_aCharacters[pSizeData->m_LruFirst].m_LruPrev = SlotID;
+		else
+			pSizeData->m_LruLast = SlotID;
+		pSizeData->m_LruFirst = SlotID;
+	}
+
+	void LruRemove(CFontSizeData *pSizeData, int SlotID)
+	{
+		CFontChar *pChr = &pSizeData->m_aCharacters[SlotID];
+		if(pChr->m_LruPrev >= 0)
+			pSizeData->m_aCharacters[pChr->m_LruPrev].m_LruNext = pChr->m_LruNext;
+		else
+			pSizeData->m_LruFirst = pChr->m_LruNext;
+		if(pChr->m_LruNext >= 0)
+			pSizeData->m_aCharacters[pChr->m_LruNext].m_LruPrev = pChr->m_LruPrev;
+		else
+			pSizeData->m_LruLast = pChr->m_LruPrev;
+	}
+
 	int RenderGlyph(CFont *pFont, CFontSizeData *pSizeData, int Chr)
 	{
 		FT_Bitmap *pBitmap;
@@ -384,38 +484,36 @@ class CTextRender : public IEngineTextRender
 			pFontchr->m_aUvs[3] = pFontchr->m_aUvs[1] + Height*Vscale;
 		}
 
+		LinkChar(pSizeData, SlotID);
 		return SlotID;
 	}
 
 	CFontChar *GetChar(CFont *pFont, CFontSizeData *pSizeData, int Chr)
 	{
-		CFontChar *pFontchr = NULL;
-
 		// search for the character
-		// TODO: remove this linear search
-		int i;
-		for(i = 0; i < pSizeData->m_CurrentCharacter; i++)
+		int SlotID = pSizeData->m_aCharHash[CharHash(Chr)];
+		while(SlotID >= 0 && pSizeData->m_aCharacters[SlotID].m_ID != Chr)
+			SlotID = pSizeData->m_aCharacters[SlotID].m_HashNext;
+
+		if(SlotID >= 0)
 		{
-			if(pSizeData->m_aCharacters[i].m_ID == Chr)
+			// touch the character
+			if(pSizeData->m_LruFirst != SlotID)
 			{
-				pFontchr = &pSizeData->m_aCharacters[i];
-				break;
+				LruRemove(pSizeData, SlotID);
+				LruPushFront(pSizeData, SlotID);
 			}
 		}
-
-		// check if we need to render the character
-		if(!pFontchr)
+		else
 		{
-			int Index = RenderGlyph(pFont, pSizeData, Chr);
-			if(Index >= 0)
-				pFontchr = &pSizeData->m_aCharacters[Index];
+			// render the character
+			SlotID = RenderGlyph(pFont, pSizeData, Chr);
+			if(SlotID < 0)
+				return NULL;
 		}
 
-		// touch the character
-		// TODO: don't call time_get here
-		if(pFontchr)
-			pFontchr->m_TouchTime = time_get();
-
+		CFontChar *pFontchr = &pSizeData->m_aCharacters[SlotID];
+		pFontchr->m_TouchTime = m_RenderTime;
 		return pFontchr;
 	}
 
@@ -433,6 +531,273 @@ class CTextRender : public IEngineTextRender
 	}
 
 
+	// places the glyphs of a run relative to the cursor, words are measured with TextEx for the line wrapping
+	void LayoutText(CTextCursor *pCursor, CFont *pFont, CFontSizeData *pSizeData, const char *pText, int Length,
+		float CursorX, float CursorY, float Size, float FakeToScreenX, float FakeToScreenY, CGlyphPos *pGlyphs, CTextLayout *pLayout)
+	{
+		float Scale = 1/pSizeData->m_FontSize;
+		const char *pCurrent = (char *)pText;
+		const char *pEnd = pCurrent+Length;
+		float DrawX = CursorX;
+		float DrawY = CursorY;
+		int LineCount = pCursor->m_LineCount;
+		int NumGlyphs = 0;
+		bool GotNewLine = false;
+
+		while(pCurrent < pEnd && (pCursor->m_MaxLines < 1 || LineCount <= pCursor->m_MaxLines))
+		{
+			int NewLine = 0;
+			const char *pBatchEnd = pEnd;
+			if(pCursor->m_LineWidth > 0 && !(pCursor->m_Flags&TEXTFLAG_STOP_AT_END))
+			{
+				int Wlen = min(WordLength((char *)pCurrent), (int)(pEnd-pCurrent));
+				CTextCursor Compare = *pCursor;
+				Compare.m_X = DrawX;
+				Compare.m_Y = DrawY;
+				Compare.m_Flags &= ~TEXTFLAG_RENDER;
+				Compare.m_LineWidth = -1;
+				TextEx(&Compare, pCurrent, Wlen);
+
+				if(Compare.m_X-DrawX > pCursor->m_LineWidth)
+				{
+					// word can't be fitted in one line, cut it
+					CTextCursor Cutter = *pCursor;
+					Cutter.m_CharCount = 0;
+					Cutter.m_X = DrawX;
+					Cutter.m_Y = DrawY;
+					Cutter.m_Flags &= ~TEXTFLAG_RENDER;
+					Cutter.m_Flags |= TEXTFLAG_STOP_AT_END;
+
+					TextEx(&Cutter, (const char *)pCurrent, Wlen);
+					Wlen = Cutter.m_CharCount;
+					NewLine = 1;
+
+					if(Wlen <= 3) // if we can't place 3 chars of the word on this line, take the next
+						Wlen = 0;
+				}
+				else if(Compare.m_X-pCursor->m_StartX > pCursor->m_LineWidth)
+				{
+					NewLine = 1;
+					Wlen = 0;
+				}
+
+				pBatchEnd = pCurrent + Wlen;
+			}
+
+			const char *pTmp = pCurrent;
+			int NextCharacter = str_utf8_decode(&pTmp);
+			while(pCurrent < pBatchEnd)
+			{
+				int Character = NextCharacter;
+				pCurrent = pTmp;
+				NextCharacter = str_utf8_decode(&pTmp);
+
+				if(Character == '\n')
+				{
+					DrawX = pCursor->m_StartX;
+					DrawY += Size;
+					DrawX = (int)(DrawX * FakeToScreenX) / FakeToScreenX; // realign
+					DrawY = (int)(DrawY * FakeToScreenY) / FakeToScreenY;
+					++LineCount;
+					if(pCursor->m_MaxLines > 0 && LineCount > pCursor->m_MaxLines)
+						break;
+					continue;
+				}
+
+				CFontChar *pChr = GetChar(pFont, pSizeData, Character);
+				if(pChr)
+				{
+					float Advance = pChr->m_AdvanceX + Kerning(pFont, Character, NextCharacter)*Scale;
+					if(pCursor->m_Flags&TEXTFLAG_STOP_AT_END && DrawX+Advance*Size-pCursor->m_StartX > pCursor->m_LineWidth)
+					{
+						// we hit the end of the line, no more to render or count
+						pCurrent = pEnd;
+						break;
+					}
+
+					if(pGlyphs)
+					{
+						pGlyphs[NumGlyphs].m_Chr = Character;
+						pGlyphs[NumGlyphs].m_X = DrawX-CursorX;
+						pGlyphs[NumGlyphs].m_Y = DrawY-CursorY;
+					}
+
+					DrawX += Advance*Size;
+					NumGlyphs++;
+				}
+			}
+
+			if(NewLine)
+			{
+				DrawX = pCursor->m_StartX;
+				DrawY += Size;
+				GotNewLine = true;
+				DrawX = (int)(DrawX * FakeToScreenX) / FakeToScreenX; // realign
+				DrawY = (int)(DrawY * FakeToScreenY) / FakeToScreenY;
+				++LineCount;
+			}
+		}
+
+		pLayout->m_pGlyphs = pGlyphs;
+		pLayout->m_NumGlyphs = NumGlyphs;
+		pLayout->m_EndX = DrawX-CursorX;
+		pLayout->m_EndY = DrawY-CursorY;
+		pLayout->m_LineCount = LineCount;
+		pLayout->m_GotNewLine = GotNewLine;
+	}
+
+	void RenderLayout(CFont *pFont, CFontSizeData *pSizeData, const CTextLayout *pLayout, float CursorX, float CursorY, float Size)
+	{
+		// outline first, then the text on top
+		for(int i = 0; i < 2; i++)
+		{
+			if(i == 0)
+				Graphics()->TextureSet(pSizeData->m_aTextures[1]);
+			else
+				Graphics()->TextureSet(pSizeData->m_aTextures[0]);
+
+			Graphics()->QuadsBegin();
+			if(i == 0)
+				Graphics()->SetColor(m_TextOutlineR, m_TextOutlineG, m_TextOutlineB, m_TextOutlineA*m_TextA);
+			else
+				Graphics()->SetColor(m_TextR, m_TextG, m_TextB, m_TextA);
+
+			for(int g = 0; g < pLayout->m_NumGlyphs; g++)
+			{
+				const CGlyphPos *pGlyph = &pLayout->m_pGlyphs[g];
+				CFontChar *pChr = GetChar(pFont, pSizeData, pGlyph->m_Chr);
+				if(!pChr)
+					continue;
+
+				Graphics()->QuadsSetSubset(pChr->m_aUvs[0], pChr->m_aUvs[1], pChr->m_aUvs[2], pChr->m_aUvs[3]);
+				IGraphics::CQuadItem QuadItem(CursorX+pGlyph->m_X+pChr->m_OffsetX*Size, CursorY+pGlyph->m_Y+pChr->m_OffsetY*Size,
+					pChr->m_Width*Size, pChr->m_Height*Size);
+				Graphics()->QuadsDrawTL(&QuadItem, 1);
+			}
+
+			Graphics()->QuadsEnd();
+		}
+	}
+
+	// layout cache
+	CTextLayout m_aLayouts[TEXT_LAYOUT_CACHE_SIZE];
+	int m_aLayoutHash[TEXT_LAYOUT_HASH_SIZE];
+	int m_LayoutLruFirst;
+	int m_LayoutLruLast;
+	int m_FirstFreeLayout;
+	int m_LayoutDepth;
+	int64 m_RenderTime;
+
+	CGlyphPos *m_pGlyphBuffer;
+	int m_GlyphBufferSize;
+
+	static unsigned LayoutHash(const CTextLayout *pKey)
+	{
+		// fnv-1a over the text, the rest of the key is compared on lookup
+		unsigned Hash = 2166136261u;
+		for(int i = 0; i < pKey->m_Length; i++)
+			Hash = (Hash^(unsigned char)pKey->m_pText[i])*16777619u;
+		Hash = (Hash^pKey->m_FontSize)*16777619u;
+		Hash = (Hash^pKey->m_Flags)*16777619u;
+		return Hash;
+	}
+
+	static bool LayoutMatch(const CTextLayout *pA, const CTextLayout *pB)
+	{
+		return pA->m_Hash == pB->m_Hash && pA->m_pFont == pB->m_pFont && pA->m_FontSize == pB->m_FontSize &&
+			pA->m_Flags == pB->m_Flags && pA->m_MaxLines == pB->m_MaxLines && pA->m_StartLineCount == pB->m_StartLineCount &&
+			pA->m_FakeToScreenX == pB->m_FakeToScreenX && pA->m_FakeToScreenY == pB->m_FakeToScreenY &&
+			pA->m_LineWidth == pB->m_LineWidth && pA->m_OffsetX == pB->m_OffsetX && pA->m_Length == pB->m_Length &&
+			mem_comp(pA->m_pText, pB->m_pText, pA->m_Length) == 0;
+	}
+
+	void LayoutLruRemove(int Index)
+	{
+		CTextLayout *pLayout = &m_aLayouts[Index];
+		if(pLayout->m_LruPrev >= 0)
+			m_aLayouts[pLayout->m_LruPrev].m_LruNext = pLayout->m_LruNext;
+		else
+			m_LayoutLruFirst = pLayout->m_LruNext;
+		if(pLayout->m_LruNext >= 0)
+			m_aLayouts[pLayout->m_LruNext].m_LruPrev = pLayout->m_LruPrev;
+		else
+			m_LayoutLruLast = pLayout->m_LruPrev;
+	}
+
+	void LayoutLruPushFront(int Index)
+	{
+		CTextLayout *pLayout = &m_aLayouts[Index];
+		pLayout->m_LruPrev = -1;
+		pLayout->m_LruNext = m_LayoutLruFirst;
+		if(m_LayoutLruFirst >= 0)
+			m_aLayouts[m_LayoutLruFirst].m_LruPrev = Index;
+		else
+			m_LayoutLruLast = Index;
+		m_LayoutLruFirst = Index;
+	}
+
+	CTextLayout *FindLayout(const CTextLayout *pKey)
+	{
+		for(int i = m_aLayoutHash[pKey->m_Hash%TEXT_LAYOUT_HASH_SIZE]; i >= 0; i = m_aLayouts[i].m_HashNext)
+		{
+			if(LayoutMatch(&m_aLayouts[i], pKey))
+			{
+				if(m_LayoutLruFirst != i)
+				{
+					LayoutLruRemove(i);
+					LayoutLruPushFront(i);
+				}
+				return &m_aLayouts[i];
+			}
+		}
+		return 0;
+	}
+
+	CTextLayout *AddLayout(const CTextLayout *pLayout)
+	{
+		// kick out the least recently used run if the cache is full
+		if(m_FirstFreeLayout < 0)
+			RemoveLayout(m_LayoutLruLast);
+
+		int Index = m_FirstFreeLayout;
+		CTextLayout *pEntry = &m_aLayouts[Index];
+		m_FirstFreeLayout = pEntry->m_LruNext;
+
+		*pEntry = *pLayout;
+		pEntry->m_pText = (char *)mem_alloc(max(pLayout->m_Length, 1), 1);
+		mem_copy(pEntry->m_pText, pLayout->m_pText, pLayout->m_Length);
+		pEntry->m_pGlyphs = 0;
+		if(pLayout->m_pGlyphs && pLayout->m_NumGlyphs)
+		{
+			pEntry->m_pGlyphs = (CGlyphPos *)mem_alloc(pLayout->m_NumGlyphs*sizeof(CGlyphPos), sizeof(void*));
+			mem_copy(pEntry->m_pGlyphs, pLayout->m_pGlyphs, pLayout->m_NumGlyphs*sizeof(CGlyphPos));
+		}
+
+		int Hash = pEntry->m_Hash%TEXT_LAYOUT_HASH_SIZE;
+		pEntry->m_HashNext = m_aLayoutHash[Hash];
+		m_aLayoutHash[Hash] = Index;
+		LayoutLruPushFront(Index);
+		return pEntry;
+	}
+
+	void RemoveLayout(int Index)
+	{
+		CTextLayout *pLayout = &m_aLayouts[Index];
+		int *pLink = &m_aLayoutHash[pLayout->m_Hash%TEXT_LAYOUT_HASH_SIZE];
+		while(*pLink != Index)
+			pLink = &m_aLayouts[*pLink].m_HashNext;
+		*pLink = pLayout->m_HashNext;
+		LayoutLruRemove(Index);
+
+		mem_free(pLayout->m_pText);
+		mem_free(pLayout->m_pGlyphs);
+		pLayout->m_pText = 0;
+		pLayout->m_pGlyphs = 0;
+
+		pLayout->m_LruNext = m_FirstFreeLayout;
+		m_FirstFreeLayout = Index;
+	}
+
 public:
 	CTextRender()
 	{
@@ -449,6 +814,24 @@ public:
 
 		m_pDefaultFont = 0;
 
+		for(int i = 0; i < TEXT_LAYOUT_HASH_SIZE; i++)
+			m_aLayoutHash[i] = -1;
+		for(int i = 0; i < TEXT_LAYOUT_CACHE_SIZE; i++)
+		{
+			m_aLayouts[i].m_pText = 0;
+			m_aLayouts[i].m_pGlyphs = 0;
+			m_aLayouts[i].m_LruNext = i+1;
+		}
+		m_aLayouts[TEXT_LAYOUT_CACHE_SIZE-1].m_LruNext = -1;
+		m_FirstFreeLayout = 0;
+		m_LayoutLruFirst = -1;
+		m_LayoutLruLast = -1;
+		m_LayoutDepth = 0;
+		m_RenderTime = 0;
+
+		m_pGlyphBuffer = 0;
+		m_GlyphBufferSize = 0;
+
 		// GL_LUMINANCE can be good for debugging
 		//m_FontTextureFormat = GL_ALPHA;
 	}
@@ -482,6 +865,15 @@ public:
 
 	virtual void DestroyFont(CFont *pFont)
 	{
+		// drop the runs that were laid out with this font
+		for(int i = m_LayoutLruFirst; i >= 0;)
+		{
+			int Next = m_aLayouts[i].m_LruNext;
+			if(m_aLayouts[i].m_pFont == pFont)
+				RemoveLayout(i);
+			i = Next;
+		}
+
 		mem_free(pFont);
 	}
 
@@ -560,10 +952,6 @@ public:
 		int ActualX, ActualY;
 
 		int ActualSize;
-		int i;
-		int GotNewLine = 0;
-		float DrawX = 0.0f, DrawY = 0.0f;
-		int LineCount = 0;
 		float CursorX, CursorY;
 
 		float Size = pCursor->m_FontSize;
@@ -591,145 +979,63 @@ public:
 			return;
 
 		pSizeData = GetSize(pFont, ActualSize);
-		RenderSetup(pFont, ActualSize);
-
-		float Scale = 1/pSizeData->m_FontSize;
 
 		// set length
 		if(Length < 0)
 			Length = str_length(pText);
 
-		// if we don't want to render, we can just skip the first outline pass
-		i = 1;
-		if(pCursor->m_Flags&TEXTFLAG_RENDER)
-			i = 0;
-
-		for(;i < 2; i++)
+		// glyphs are touched with the time of the outermost call
+		if(m_LayoutDepth == 0)
+			m_RenderTime = time_get();
+
+		CTextLayout Layout;
+		Layout.m_pFont = pFont;
+		Layout.m_FontSize = ActualSize;
+		Layout.m_Flags = pCursor->m_Flags;
+		Layout.m_MaxLines = pCursor->m_MaxLines;
+		Layout.m_StartLineCount = pCursor->m_LineCount;
+		Layout.m_FakeToScreenX = FakeToScreenX;
+		Layout.m_FakeToScreenY = FakeToScreenY;
+		Layout.m_LineWidth = pCursor->m_LineWidth;
+		Layout.m_OffsetX = CursorX-pCursor->m_StartX;
+		Layout.m_Length = Length;
+		Layout.m_pText = (char *)pText;
+		Layout.m_Hash = LayoutHash(&Layout);
+
+		// only whole runs from the start of a line are cached, the word measuring while wrapping is not
+		bool Cache = m_LayoutDepth == 0 && pCursor->m_X == pCursor->m_StartX;
+		CTextLayout *pLayout = Cache ? FindLayout(&Layout) : 0;
+		if(!pLayout)
 		{
-			const char *pCurrent = (char *)pText;
-			const char *pEnd = pCurrent+Length;
-			DrawX = CursorX;
-			DrawY = CursorY;
-			LineCount = pCursor->m_LineCount;
-
+			CGlyphPos *pGlyphs = 0;
 			if(pCursor->m_Flags&TEXTFLAG_RENDER)
 			{
-				// TODO: Make this better
-				if (i == 0)
-					Graphics()->TextureSet(pSizeData->m_aTextures[1]);
-				else
-					Graphics()->TextureSet(pSizeData->m_aTextures[0]);
-
-				Graphics()->QuadsBegin();
-				if (i == 0)
-					Graphics()->SetColor(m_TextOutlineR, m_TextOutlineG, m_TextOutlineB, m_TextOutlineA*m_TextA);
-				else
-					Graphics()->SetColor(m_TextR, m_TextG, m_TextB, m_TextA);
-			}
-
-			while(pCurrent < pEnd && (pCursor->m_MaxLines < 1 || LineCount <= pCursor->m_MaxLines))
-			{
-				int NewLine = 0;
-				const char *pBatchEnd = pEnd;
-				if(pCursor->m_LineWidth > 0 && !(pCursor->m_Flags&TEXTFLAG_STOP_AT_END))
+				if(m_GlyphBufferSize < Length)
 				{
-					int Wlen = min(WordLength((char *)pCurrent), (int)(pEnd-pCurrent));
-					CTextCursor Compare = *pCursor;
-					Compare.m_X = DrawX;
-					Compare.m_Y = DrawY;
-					Compare.m_Flags &= ~TEXTFLAG_RENDER;
-					Compare.m_LineWidth = -1;
-					TextEx(&Compare, pCurrent, Wlen);
-
-					if(Compare.m_X-DrawX > pCursor->m_LineWidth)
-					{
-						// word can't be fitted in one line, cut it
-						CTextCursor Cutter = *pCursor;
-						Cutter.m_CharCount = 0;
-						Cutter.m_X = DrawX;
-						Cutter.m_Y = DrawY;
-						Cutter.m_Flags &= ~TEXTFLAG_RENDER;
-						Cutter.m_Flags |= TEXTFLAG_STOP_AT_END;
-
-						TextEx(&Cutter, (const char *)pCurrent, Wlen);
-						Wlen = Cutter.m_CharCount;
-						NewLine = 1;
-
-						if(Wlen <= 3) // if we can't place 3 chars of the word on this line, take the next
-							Wlen = 0;
-					}
-					else if(Compare.m_X-pCursor->m_StartX > pCursor->m_LineWidth)
-					{
-						NewLine = 1;
-						Wlen = 0;
-					}
-
-					pBatchEnd = pCurrent + Wlen;
-				}
-
-				const char *pTmp = pCurrent;
-				int NextCharacter = str_utf8_decode(&pTmp);
-				while(pCurrent < pBatchEnd)
-				{
-					int Character = NextCharacter;
-					pCurrent = pTmp;
-					NextCharacter = str_utf8_decode(&pTmp);
-
-					if(Character == '\n')
-					{
-						DrawX = pCursor->m_StartX;
-						DrawY += Size;
-						DrawX = (int)(DrawX * FakeToScreenX) / FakeToScreenX; // realign
-						DrawY = (int)(DrawY * FakeToScreenY) / FakeToScreenY;
-						++LineCount;
-						if(pCursor->m_MaxLines > 0 && LineCount > pCursor->m_MaxLines)
-							break;
-						continue;
-					}
-
-					CFontChar *pChr = GetChar(pFont, pSizeData, Character);
-					if(pChr)
-					{
-						float Advance = pChr->m_AdvanceX + Kerning(pFont, Character, NextCharacter)*Scale;
-						if(pCursor->m_Flags&TEXTFLAG_STOP_AT_END && DrawX+Advance*Size-pCursor->m_StartX > pCursor->m_LineWidth)
-						{
-							// we hit the end of the line, no more to render or count
-							pCurrent = pEnd;
-							break;
-						}
-
-						if(pCursor->m_Flags&TEXTFLAG_RENDER)
-						{
-							Graphics()->QuadsSetSubset(pChr->m_aUvs[0], pChr->m_aUvs[1], pChr->m_aUvs[2], pChr->m_aUvs[3]);
-							IGraphics::CQuadItem QuadItem(DrawX+pChr->m_OffsetX*Size, DrawY+pChr->m_OffsetY*Size, pChr->m_Width*Size, pChr->m_Height*Size);
-							Graphics()->QuadsDrawTL(&QuadItem, 1);
-						}
-
-						DrawX += Advance*Size;
-						pCursor->m_CharCount++;
-					}
-				}
-
-				if(NewLine)
-				{
-					DrawX = pCursor->m_StartX;
-					DrawY += Size;
-					GotNewLine = 1;
-					DrawX = (int)(DrawX * FakeToScreenX) / FakeToScreenX; // realign
-					DrawY = (int)(DrawY * FakeToScreenY) / FakeToScreenY;
-					++LineCount;
+					mem_free(m_pGlyphBuffer);
+					m_GlyphBufferSize = max(Length, 256);
+					m_pGlyphBuffer = (CGlyphPos *)mem_alloc(m_GlyphBufferSize*sizeof(CGlyphPos), sizeof(void*));
 				}
+				pGlyphs = m_pGlyphBuffer;
 			}
 
-			if(pCursor->m_Flags&TEXTFLAG_RENDER)
-				Graphics()->QuadsEnd();
+			RenderSetup(pFont, ActualSize);
+			m_LayoutDepth++;
+			LayoutText(pCursor, pFont, pSizeData, pText, Length, CursorX, CursorY, Size, FakeToScreenX, FakeToScreenY, pGlyphs, &Layout);
+			m_LayoutDepth--;
+
+			pLayout = Cache ? AddLayout(&Layout) : &Layout;
 		}
 
-		pCursor->m_X = DrawX;
-		pCursor->m_LineCount = LineCount;
+		if(pCursor->m_Flags&TEXTFLAG_RENDER)
+			RenderLayout(pFont, pSizeData, pLayout, CursorX, CursorY, Size);
+
+		pCursor->m_X = CursorX+pLayout->m_EndX;
+		pCursor->m_LineCount = pLayout->m_LineCount;
+		pCursor->m_CharCount += pLayout->m_NumGlyphs;
 
-		if(GotNewLine)
-			pCursor->m_Y = DrawY;
+		if(pLayout->m_GotNewLine)
+			pCursor->m_Y = CursorY+pLayout->m_EndY;
 	}
 
 };
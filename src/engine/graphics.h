@@ -132,6 +132,19 @@ public:
 	virtual void SetColorVertex(const CColorVertex *pArray, int Num) = 0;
 	virtual void SetColor(float r, float g, float b, float a) = 0;
 
+	// retained geometry, 4 vertices per quad. buffers are drawn between QuadsBegin and QuadsEnd with the
+	// current texture, blend mode, wrap mode, screen mapping, clipping and the color from SetColor
+	struct CVertexItem
+	{
+		float m_X, m_Y, m_U, m_V;
+		CVertexItem() {}
+		CVertexItem(float x, float y, float u, float v) : m_X(x), m_Y(y), m_U(u), m_V(v) {}
+	};
+	virtual int CreateVertexBuffer(const CVertexItem *pArray, int NumQuads) = 0;
+	virtual void UpdateVertexBuffer(int BufferID, const CVertexItem *pArray, int NumQuads) = 0;
+	virtual void DeleteVertexBuffer(int BufferID) = 0;
+	virtual void DrawVertexBuffer(int BufferID, int FirstQuad, int NumQuads) = 0;
+
 	virtual void TakeScreenshot(const char *pFilename) = 0;
 	virtual int GetVideoModes(CVideoMode *pModes, int MaxModes) = 0;
 
@@ -52,6 +52,7 @@ public:
 	virtual int SnapNewID() = 0;
 	virtual void SnapFreeID(int ID) = 0;
 	virtual void *SnapNewItem(int Type, int ID, int Size) = 0;
+	virtual void SnapSetView(int View) = 0;
 
 	virtual void SnapSetStaticsize(int ItemType, int Size) = 0;
 
@@ -80,6 +81,9 @@ public:
 	virtual void OnTick() = 0;
 	virtual void OnPreSnap() = 0;
 	virtual void OnSnap(int ClientID) = 0;
+	virtual void OnSnapWorld() = 0;
+	virtual void OnSnapClient(int ClientID) = 0;
+	virtual bool IsSnapItemVisible(int ClientID, int Type, int ID, int View) = 0;
 	virtual void OnPostSnap() = 0;
 
 	virtual void OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID) = 0;
@@ -3,6 +3,7 @@
 
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 
 #include <engine/config.h>
 #include <engine/console.h>
@@ -22,6 +23,7 @@
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/packer.h>
+#include <engine/shared/profiler.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/snapshot.h>
 
@@ -285,6 +287,21 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 	m_RconClientID = IServer::RCON_CID_SERV;
 	m_RconAuthLevel = AUTHED_ADMIN;
 
+	m_NumSnapJobs = 0;
+	m_NextSnapJob = 0;
+	m_NumSnapWorkers = 0;
+	m_SnapWorkersShutdown = false;
+	m_SnapWorldBuilding = false;
+	m_SnapWorldOverflow = false;
+	m_SnapView = -1;
+	m_pEventLoop = 0;
+
+	static const char *s_apPerfPhases[NUM_PERF_PHASES] = {
+		"input", "tick", "snap", "snap_build", "snap_delta",
+		"snap_compress", "snap_send", "network", "register", "total"
+	};
+	m_Profiler.Init(s_apPerfPhases, NUM_PERF_PHASES);
+
 	Init();
 }
 
@@ -555,6 +572,9 @@ int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
 
 void CServer::DoSnapshot()
 {
+	CProfileScope ProfileScope(&m_Profiler, PERF_SNAP);
+	int64 BuildStart = time_get();
+
 	GameServer()->OnPreSnap();
 
 	// create snapshot for demo recording
@@ -572,6 +592,12 @@ void CServer::DoSnapshot()
 		m_DemoRecorder.RecordSnapshot(Tick(), aData, SnapshotSize);
 	}
 
+	static CSnapshot EmptySnap;
+	EmptySnap.Clear();
+	m_NumSnapJobs = 0;
+	CSnapshot *pWorld = 0;
+	bool SharedSnap = g_Config.m_SvSharedSnap;
+
 	// create snapshots for all clients
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
@@ -590,38 +616,53 @@ void CServer::DoSnapshot()
 		{
 			char aData[CSnapshot::MAX_SIZE];
 			CSnapshot *pData = (CSnapshot*)aData;	// Fix compiler warning for strict-aliasing
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			char aCompData[CSnapshot::MAX_SIZE];
 			int SnapshotSize;
-			int Crc;
-			static CSnapshot EmptySnap;
-			CSnapshot *pDeltashot = &EmptySnap;
-			int DeltashotSize;
-			int DeltaTick = -1;
-			int DeltaSize;
+			CSnapJob *pJob = &m_aSnapJobs[m_NumSnapJobs++];
 
-			m_SnapshotBuilder.Init();
+			// the world is only snapped once per tick, by the first client that needs it
+			if(SharedSnap && !pWorld)
+			{
+				pWorld = SnapWorld();
+				SharedSnap = pWorld != 0;
+			}
 
-			GameServer()->OnSnap(i);
+			if(SharedSnap)
+				SnapClient(i, pWorld);
+			else
+			{
+				m_SnapshotBuilder.Init();
+				GameServer()->OnSnap(i);
+			}
 
 			// finish snapshot
 			SnapshotSize = m_SnapshotBuilder.Finish(pData);
-			Crc = pData->Crc();
+
+			pJob->m_ClientID = i;
+			pJob->m_Crc = pData->Crc();
+			pJob->m_SnapSize = SnapshotSize;
+			pJob->m_pDeltashot = &EmptySnap;
+			pJob->m_DeltashotSize = sizeof(CSnapshot);
+			pJob->m_DeltaTick = -1;
+			pJob->m_SourceJob = -1;
+			pJob->m_DeltaTime = 0;
+			pJob->m_CompressTime = 0;
 
 			// remove old snapshos
 			// keep 3 seconds worth of snapshots
 			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick-SERVER_TICK_SPEED*3);
 
-			// save it the snapshot
-			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0);
+			// save it the snapshot, the stored copy is what the delta is created from
+			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0, 0);
+			pJob->m_pSnap = m_aClients[i].m_Snapshots.m_pLast->m_pSnap;
 
 			// find snapshot that we can preform delta against
-			EmptySnap.Clear();
-
 			{
-				DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
+				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pJob->m_pDeltashot, 0);
 				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
+				{
+					pJob->m_DeltaTick = m_aClients[i].m_LastAckedSnapshot;
+					pJob->m_DeltashotSize = DeltashotSize;
+				}
 				else
 				{
 					// no acked package found, force client to recover rate
@@ -629,60 +670,238 @@ void CServer::DoSnapshot()
 						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
 				}
 			}
+		}
+	}
 
-			// create delta
-			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+	// clients with identical snapshots and delta bases can share one delta
+	FindSharedSnapJobs();
+	m_Profiler.Add(PERF_SNAP_BUILD, time_get()-BuildStart);
 
-			if(DeltaSize)
-			{
-				// compress it
-				int SnapshotSize;
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-				int NumPackets;
+	// create and compress the deltas, spread over the worker threads if there are any
+	{
+		char aDeltaData[CSnapshot::MAX_SIZE];
+		int NumWorkers = min(m_NumSnapWorkers, m_NumSnapJobs-1);
 
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData);
-				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
+		m_NextSnapJob = 0;
+#if !defined(CONF_PLATFORM_MACOSX)
+		for(int i = 0; i < NumWorkers; i++)
+			m_SnapActivity.signal();
+#endif
 
-				for(int n = 0, Left = SnapshotSize; Left; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+		ProcessSnapJobs(aDeltaData);
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick-DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick-DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
-					}
-				}
+#if !defined(CONF_PLATFORM_MACOSX)
+		for(int i = 0; i < NumWorkers; i++)
+			m_SnapDone.wait();
+#endif
+
+		// cpu time, summed over all threads
+		for(int i = 0; i < m_NumSnapJobs; i++)
+		{
+			m_Profiler.Add(PERF_SNAP_DELTA, m_aSnapJobs[i].m_DeltaTime);
+			m_Profiler.Add(PERF_SNAP_COMPRESS, m_aSnapJobs[i].m_CompressTime);
+		}
+	}
+
+	// send them in client order
+	{
+		CProfileScope SendScope(&m_Profiler, PERF_SNAP_SEND);
+		for(int i = 0; i < m_NumSnapJobs; i++)
+			SendSnapJob(&m_aSnapJobs[i]);
+	}
+
+	GameServer()->OnPostSnap();
+}
+
+CSnapshot *CServer::SnapWorld()
+{
+	CSnapshot *pWorld = (CSnapshot *)m_aSnapWorldData;
+
+	m_SnapshotBuilder.Init();
+	bool Overflow = m_SnapWorldOverflow;
+	m_SnapWorldOverflow = false;
+	m_SnapWorldBuilding = true;
+	m_SnapView = -1;
+	GameServer()->OnSnapWorld();
+	m_SnapWorldBuilding = false;
+
+	// the items of all views together can exceed the limits of one snapshot even if every single
+	// view fits. snap each client on its own this tick instead of dropping items
+	if(m_SnapWorldOverflow)
+	{
+		if(!Overflow)
+			dbg_msg("server", "world snapshot is full, snapping clients separately");
+		return 0;
+	}
+
+	m_SnapshotBuilder.Finish(pWorld);
+	return pWorld;
+}
+
+void CServer::SnapClient(int ClientID, CSnapshot *pWorld)
+{
+	m_SnapshotBuilder.Init();
+
+	// copy the world items the client can see
+	for(int i = 0; i < pWorld->NumItems(); i++)
+	{
+		CSnapshotItem *pItem = pWorld->GetItem(i);
+		if(!GameServer()->IsSnapItemVisible(ClientID, pItem->Type(), pItem->ID(), m_aSnapWorldViews[i]))
+			continue;
+
+		int Size = pWorld->GetItemSize(i);
+		void *pData = m_SnapshotBuilder.NewItem(pItem->Type(), pItem->ID(), Size);
+		if(pData)
+			mem_copy(pData, pItem->Data(), Size);
+	}
+
+	// add the items that only this client gets
+	GameServer()->OnSnapClient(ClientID);
+}
+
+void CServer::FindSharedSnapJobs()
+{
+	for(int i = 1; i < m_NumSnapJobs; i++)
+	{
+		CSnapJob *pJob = &m_aSnapJobs[i];
+		for(int j = 0; j < i; j++)
+		{
+			// the crc and sizes are cheap to compare, only check the data if they match
+			const CSnapJob *pOther = &m_aSnapJobs[j];
+			if(pOther->m_SourceJob != -1 || pOther->m_Crc != pJob->m_Crc || pOther->m_SnapSize != pJob->m_SnapSize ||
+				pOther->m_DeltashotSize != pJob->m_DeltashotSize)
+				continue;
+			if(mem_comp(pOther->m_pSnap, pJob->m_pSnap, pJob->m_SnapSize) != 0 ||
+				mem_comp(pOther->m_pDeltashot, pJob->m_pDeltashot, pJob->m_DeltashotSize) != 0)
+				continue;
+
+			pJob->m_SourceJob = j;
+			break;
+		}
+	}
+}
+
+void CServer::ProcessSnapJobs(char *pDeltaData)
+{
+	while(1)
+	{
+		unsigned Index = atomic_inc(&m_NextSnapJob)-1;
+		if(Index >= (unsigned)m_NumSnapJobs)
+			break;
+
+		// create delta and compress it
+		CSnapJob *pJob = &m_aSnapJobs[Index];
+		if(pJob->m_SourceJob != -1)
+			continue;
+		int64 Start = time_get();
+		int DeltaSize = m_SnapshotDelta.CreateDelta(pJob->m_pDeltashot, pJob->m_pSnap, pDeltaData);
+		int64 DeltaEnd = time_get();
+		if(DeltaSize)
+			pJob->m_CompSize = CVariableInt::Compress(pDeltaData, DeltaSize, pJob->m_aCompData);
+		else
+			pJob->m_CompSize = 0;
+		pJob->m_DeltaTime = DeltaEnd-Start;
+		pJob->m_CompressTime = time_get()-DeltaEnd;
+	}
+}
+
+void CServer::SendSnapJob(const CSnapJob *pJob)
+{
+	int ClientID = pJob->m_ClientID;
+	int DeltaTick = pJob->m_DeltaTick;
+
+	// the compressed delta of a shared job lives in its source
+	if(pJob->m_SourceJob != -1)
+		pJob = &m_aSnapJobs[pJob->m_SourceJob];
+
+	if(pJob->m_CompSize)
+	{
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+		int NumPackets = (pJob->m_CompSize+MaxSize-1)/MaxSize;
+
+		for(int n = 0, Left = pJob->m_CompSize; Left; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker Msg(NETMSG_SNAPSINGLE);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick-DeltaTick);
+				Msg.AddInt(pJob->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pJob->m_aCompData[n*MaxSize], Chunk);
+				SendMsgEx(&Msg, MSGFLAG_FLUSH, ClientID, true);
 			}
 			else
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY);
+				CMsgPacker Msg(NETMSG_SNAP);
 				Msg.AddInt(m_CurrentGameTick);
 				Msg.AddInt(m_CurrentGameTick-DeltaTick);
-				SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(pJob->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pJob->m_aCompData[n*MaxSize], Chunk);
+				SendMsgEx(&Msg, MSGFLAG_FLUSH, ClientID, true);
 			}
 		}
 	}
+	else
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick-DeltaTick);
+		SendMsgEx(&Msg, MSGFLAG_FLUSH, ClientID, true);
+	}
+}
 
-	GameServer()->OnPostSnap();
+void CServer::SnapWorkerThread(void *pUser)
+{
+#if !defined(CONF_PLATFORM_MACOSX)
+	CSnapWorker *pWorker = (CSnapWorker *)pUser;
+	CServer *pThis = pWorker->m_pServer;
+
+	while(1)
+	{
+		pThis->m_SnapActivity.wait();
+		if(pThis->m_SnapWorkersShutdown)
+			break;
+
+		pThis->ProcessSnapJobs(pWorker->m_aDeltaData);
+		pThis->m_SnapDone.signal();
+	}
+#endif
+}
+
+void CServer::SetSnapThreads(int NumThreads)
+{
+#if defined(CONF_PLATFORM_MACOSX)
+	// no semaphores here, snapshots are always compressed on the main thread
+	NumThreads = 0;
+#endif
+	NumThreads = clamp(NumThreads, 0, (int)MAX_SNAP_THREADS);
+	if(NumThreads == m_NumSnapWorkers)
+		return;
+
+#if !defined(CONF_PLATFORM_MACOSX)
+	// stop the running workers
+	m_SnapWorkersShutdown = true;
+	for(int i = 0; i < m_NumSnapWorkers; i++)
+		m_SnapActivity.signal();
+	for(int i = 0; i < m_NumSnapWorkers; i++)
+		thread_wait(m_aSnapWorkers[i].m_pThread);
+	m_SnapWorkersShutdown = false;
+
+	// start the new ones
+	for(int i = 0; i < NumThreads; i++)
+	{
+		m_aSnapWorkers[i].m_pServer = this;
+		m_aSnapWorkers[i].m_pThread = thread_init(SnapWorkerThread, &m_aSnapWorkers[i]);
+	}
+	m_NumSnapWorkers = NumThreads;
+#endif
 }
 
 
@@ -732,6 +951,61 @@ void CServer::SendMap(int ClientID)
 	Msg.AddInt(m_CurrentMapCrc);
 	Msg.AddInt(m_CurrentMapSize);
 	SendMsgEx(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID, true);
+
+	m_aClients[ClientID].m_MapChunk = 0;
+	m_aClients[ClientID].m_MapChunkEnd = 0;
+	m_aClients[ClientID].m_MapChunkBudget = g_Config.m_SvMapDownloadSpeed;
+}
+
+void CServer::SendMapChunk(int ClientID, int Chunk)
+{
+	unsigned int ChunkSize = MAP_CHUNK_SIZE;
+	unsigned int Offset = Chunk * ChunkSize;
+	int Last = 0;
+
+	if(Offset+ChunkSize >= m_CurrentMapSize)
+	{
+		ChunkSize = m_CurrentMapSize-Offset;
+		Last = 1;
+	}
+
+	CMsgPacker Msg(NETMSG_MAP_DATA);
+	Msg.AddInt(Last);
+	Msg.AddInt(m_CurrentMapCrc);
+	Msg.AddInt(Chunk);
+	Msg.AddInt(ChunkSize);
+	Msg.AddRaw(&m_pCurrentMapData[Offset], ChunkSize);
+	SendMsgEx(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID, true);
+
+	if(g_Config.m_Debug)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "sending chunk %d with size %d", Chunk, ChunkSize);
+		Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
+	}
+}
+
+void CServer::SendMapWindow(int ClientID)
+{
+	// the rest of the window goes out in the next ticks when the budget is used up
+	CClient *pClient = &m_aClients[ClientID];
+	while(pClient->m_MapChunk < pClient->m_MapChunkEnd && pClient->m_MapChunkBudget > 0)
+	{
+		SendMapChunk(ClientID, pClient->m_MapChunk++);
+		pClient->m_MapChunkBudget--;
+	}
+}
+
+void CServer::UpdateClientMapDownloads()
+{
+	for(int i = 0; i < MAX_CLIENTS; ++i)
+	{
+		if(m_aClients[i].m_State != CClient::STATE_CONNECTING)
+			continue;
+
+		m_aClients[i].m_MapChunkBudget = g_Config.m_SvMapDownloadSpeed;
+		SendMapWindow(i);
+	}
 }
 
 void CServer::SendConnectionReady(int ClientID)
@@ -845,36 +1119,26 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				return;
 
 			int Chunk = Unpacker.GetInt();
-			unsigned int ChunkSize = 1024-128;
-			unsigned int Offset = Chunk * ChunkSize;
-			int Last = 0;
+			int LastChunk = m_CurrentMapSize ? (m_CurrentMapSize-1)/MAP_CHUNK_SIZE : 0;
 
 			// drop faulty map data requests
-			if(Chunk < 0 || Offset > m_CurrentMapSize)
+			if(Chunk < 0 || Chunk > LastChunk)
 				return;
 
-			if(Offset+ChunkSize >= m_CurrentMapSize)
+			// newer clients tell how many chunks they take ahead, older ones request every chunk on its own
+			int Window = Unpacker.GetInt();
+			if(Unpacker.Error() || Window <= 0 || g_Config.m_SvMapWindow == 0)
 			{
-				ChunkSize = m_CurrentMapSize-Offset;
-				if(ChunkSize < 0)
-					ChunkSize = 0;
-				Last = 1;
+				SendMapChunk(ClientID, Chunk);
+				return;
 			}
 
-			CMsgPacker Msg(NETMSG_MAP_DATA);
-			Msg.AddInt(Last);
-			Msg.AddInt(m_CurrentMapCrc);
-			Msg.AddInt(Chunk);
-			Msg.AddInt(ChunkSize);
-			Msg.AddRaw(&m_pCurrentMapData[Offset], ChunkSize);
-			SendMsgEx(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID, true);
-
-			if(g_Config.m_Debug)
-			{
-				char aBuf[256];
-				str_format(aBuf, sizeof(aBuf), "sending chunk %d with size %d", Chunk, ChunkSize);
-				Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
-			}
+			// every request acknowledges a chunk and moves the window, chunks that were sent already aren't sent again
+			CClient *pClient = &m_aClients[ClientID];
+			if(Chunk == 0 || Chunk > pClient->m_MapChunk)
+				pClient->m_MapChunk = Chunk;
+			pClient->m_MapChunkEnd = min(Chunk+min(Window, g_Config.m_SvMapWindow), LastChunk+1);
+			SendMapWindow(ClientID);
 		}
 		else if(Msg == NETMSG_READY)
 		{
@@ -1277,7 +1541,14 @@ int CServer::Run()
 
 	m_NetServer.SetCallbacks(NewClientCallback, DelClientCallback, this);
 
-	m_Econ.Init(Console(), &m_ServerBan);
+	// the main loop sleeps until a packet arrives or the next tick is due
+	m_pEventLoop = eventloop_create();
+	if(m_pEventLoop)
+		eventloop_add_socket(m_pEventLoop, m_NetServer.Socket());
+
+	m_Econ.Init(Console(), &m_ServerBan, m_pEventLoop);
+
+	SetSnapThreads(g_Config.m_SvSnapThreads);
 
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "server name is '%s'", g_Config.m_SvName);
@@ -1344,28 +1615,38 @@ int CServer::Run()
 				}
 			}
 
+			int64 WorkStart = time_get();
+
+			// everything sent until the network is pumped goes out in batches
+			CNetBase::BeginBatch();
 			while(t > TickStartTime(m_CurrentGameTick+1))
 			{
 				m_CurrentGameTick++;
 				NewTicks++;
 
 				// apply new input
-				for(int c = 0; c < MAX_CLIENTS; c++)
 				{
-					if(m_aClients[c].m_State == CClient::STATE_EMPTY)
-						continue;
-					for(int i = 0; i < 200; i++)
+					CProfileScope ProfileScope(&m_Profiler, PERF_INPUT);
+					for(int c = 0; c < MAX_CLIENTS; c++)
 					{
-						if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
+						if(m_aClients[c].m_State == CClient::STATE_EMPTY)
+							continue;
+						for(int i = 0; i < 200; i++)
 						{
-							if(m_aClients[c].m_State == CClient::STATE_INGAME)
-								GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);
-							break;
+							if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
+							{
+								if(m_aClients[c].m_State == CClient::STATE_INGAME)
+									GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);
+								break;
+							}
 						}
 					}
 				}
 
-				GameServer()->OnTick();
+				{
+					CProfileScope ProfileScope(&m_Profiler, PERF_TICK);
+					GameServer()->OnTick();
+				}
 			}
 
 			// snap game
@@ -1375,40 +1656,44 @@ int CServer::Run()
 					DoSnapshot();
 
 				UpdateClientRconCommands();
+				UpdateClientMapDownloads();
 			}
 
 			// master server stuff
-			m_Register.RegisterUpdate(m_NetServer.NetType());
+			{
+				CProfileScope ProfileScope(&m_Profiler, PERF_REGISTER);
+				m_Register.RegisterUpdate(m_NetServer.NetType());
+			}
+
+			{
+				CProfileScope ProfileScope(&m_Profiler, PERF_NETWORK);
+				PumpNetwork();
+			}
+			CNetBase::EndBatch();
 
-			PumpNetwork();
+			// the network work between two ticks counts for the next one
+			m_Profiler.Add(PERF_TOTAL, time_get()-WorkStart);
+			if(NewTicks)
+				m_Profiler.NextTick();
 
 			if(ReportTime < time_get())
 			{
 				if(g_Config.m_Debug)
 				{
-					/*
-					static NETSTATS prev_stats;
-					NETSTATS stats;
-					netserver_stats(net, &stats);
-
-					perf_next();
-
-					if(config.dbg_pref)
-						perf_dump(&rootscope);
-
-					dbg_msg("server", "send=%8d recv=%8d",
-						(stats.send_bytes - prev_stats.send_bytes)/reportinterval,
-						(stats.recv_bytes - prev_stats.recv_bytes)/reportinterval);
-
-					prev_stats = stats;
-					*/
+					CTickProfiler::CStats Stats;
+					m_Profiler.GetStats(PERF_TOTAL, &Stats);
+					str_format(aBuf, sizeof(aBuf), "tick time avg=%dus p99=%dus max=%dus", Stats.m_Avg, Stats.m_P99, Stats.m_Max);
+					Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
 				}
 
 				ReportTime += time_freq()*ReportInterval;
 			}
 
-			// wait for incomming data
-			net_socket_read_wait(m_NetServer.Socket(), 5);
+			// wait for incomming data or the next tick
+			if(m_pEventLoop)
+				eventloop_wait(m_pEventLoop, TickStartTime(m_CurrentGameTick+1));
+			else
+				net_socket_read_wait(m_NetServer.Socket(), 5);
 		}
 	}
 	// disconnect all clients on shutdown
@@ -1420,6 +1705,14 @@ int CServer::Run()
 		m_Econ.Shutdown();
 	}
 
+	SetSnapThreads(0);
+
+	if(m_pEventLoop)
+	{
+		eventloop_destroy(m_pEventLoop);
+		m_pEventLoop = 0;
+	}
+
 	GameServer()->OnShutdown();
 	m_pMap->Unload();
 
@@ -1470,6 +1763,29 @@ void CServer::ConShutdown(IConsole::IResult *pResult, void *pUser)
 	((CServer *)pUser)->m_RunServer = 0;
 }
 
+void CServer::ConPerfStatus(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	CTickProfiler *pProfiler = &pThis->m_Profiler;
+	char aBuf[256];
+
+	CTickProfiler::CStats Stats;
+	pProfiler->GetStats(0, &Stats);
+	str_format(aBuf, sizeof(aBuf), "last %d ticks, times in microseconds, snap_delta and snap_compress are summed over all snapshot threads", Stats.m_NumTicks);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "perf", aBuf);
+
+	for(int i = 0; i < pProfiler->NumPhases(); i++)
+	{
+		pProfiler->GetStats(i, &Stats);
+		str_format(aBuf, sizeof(aBuf), "%-13s avg=%-6d p50=%-6d p90=%-6d p99=%-6d max=%d",
+			pProfiler->PhaseName(i), Stats.m_Avg, Stats.m_P50, Stats.m_P90, Stats.m_P99, Stats.m_Max);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "perf", aBuf);
+	}
+
+	str_format(aBuf, sizeof(aBuf), "log lines dropped: %d", dbg_dropped_lines());
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "perf", aBuf);
+}
+
 void CServer::DemoRecorder_HandleAutoStart()
 {
 	if(g_Config.m_SvAutoDemoRecord)
@@ -1585,6 +1901,13 @@ void CServer::ConchainModCommandUpdate(IConsole::IResult *pResult, void *pUserDa
 		pfnCallback(pResult, pCallbackUserData);
 }
 
+void CServer::ConchainSnapThreadsUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments())
+		((CServer *)pUserData)->SetSnapThreads(pResult->GetInteger(0));
+}
+
 void CServer::ConchainConsoleOutputLevelUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
 {
 	pfnCallback(pResult, pCallbackUserData);
@@ -1606,6 +1929,7 @@ void CServer::RegisterCommands()
 	Console()->Register("kick", "i?r", CFGFLAG_SERVER, ConKick, this, "Kick player with specified id for any reason");
 	Console()->Register("status", "", CFGFLAG_SERVER, ConStatus, this, "List players");
 	Console()->Register("shutdown", "", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
+	Console()->Register("perf_status", "", CFGFLAG_SERVER, ConPerfStatus, this, "Show where the tick time goes");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
 
 	Console()->Register("record", "?s", CFGFLAG_SERVER|CFGFLAG_STORE, ConRecord, this, "Record to a file");
@@ -1619,6 +1943,7 @@ void CServer::RegisterCommands()
 	Console()->Chain("sv_max_clients_per_ip", ConchainMaxclientsperipUpdate, this);
 	Console()->Chain("mod_command", ConchainModCommandUpdate, this);
 	Console()->Chain("console_output_level", ConchainConsoleOutputLevelUpdate, this);
+	Console()->Chain("sv_snap_threads", ConchainSnapThreadsUpdate, this);
 
 	// register console commands in sub parts
 	m_ServerBan.InitServerBan(Console(), Storage(), this);
@@ -1641,7 +1966,23 @@ void *CServer::SnapNewItem(int Type, int ID, int Size)
 {
 	dbg_assert(Type >= 0 && Type <=0xffff, "incorrect type");
 	dbg_assert(ID >= 0 && ID <=0xffff, "incorrect id");
-	return ID < 0 ? 0 : m_SnapshotBuilder.NewItem(Type, ID, Size);
+	if(ID < 0)
+		return 0;
+
+	void *pData = m_SnapshotBuilder.NewItem(Type, ID, Size);
+	if(m_SnapWorldBuilding)
+	{
+		if(pData)
+			m_aSnapWorldViews[m_SnapshotBuilder.NumItems()-1] = m_SnapView;
+		else
+			m_SnapWorldOverflow = true;
+	}
+	return pData;
+}
+
+void CServer::SnapSetView(int View)
+{
+	m_SnapView = View;
 }
 
 void CServer::SnapSetStaticsize(int ItemType, int Size)
@@ -124,16 +124,91 @@ public:
 
 		const IConsole::CCommandInfo *m_pRconCmdToSend;
 
+		// windowed map download
+		int m_MapChunk; // next chunk to send
+		int m_MapChunkEnd; // the chunks before this one may be sent
+		int m_MapChunkBudget; // chunks that may still be sent this tick
+
 		void Reset();
 	};
 
 	CClient m_aClients[MAX_CLIENTS];
 
+	enum
+	{
+		MAX_SNAP_THREADS=8,
+	};
+
+	// delta + compression work for one client, filled on the main thread
+	class CSnapJob
+	{
+	public:
+		int m_ClientID;
+		int m_Crc;
+		int m_DeltaTick;
+		CSnapshot *m_pSnap;
+		int m_SnapSize;
+		CSnapshot *m_pDeltashot;
+		int m_DeltashotSize;
+		int m_SourceJob; // earlier job with the same delta, -1 if this one has to create it
+		int m_CompSize;
+		int64 m_DeltaTime;
+		int64 m_CompressTime;
+		char m_aCompData[CSnapshot::MAX_SIZE];
+	};
+
+	class CSnapWorker
+	{
+	public:
+		CServer *m_pServer;
+		void *m_pThread;
+		char m_aDeltaData[CSnapshot::MAX_SIZE];
+	};
+
+	CSnapJob m_aSnapJobs[MAX_CLIENTS];
+	int m_NumSnapJobs;
+	volatile unsigned m_NextSnapJob;
+
+	CSnapWorker m_aSnapWorkers[MAX_SNAP_THREADS];
+	int m_NumSnapWorkers;
+	volatile bool m_SnapWorkersShutdown;
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore m_SnapActivity;
+	semaphore m_SnapDone;
+#endif
+
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+
+	// world snapshot shared by all clients, m_aSnapWorldViews holds the game view of each item
+	int m_aSnapWorldViews[CSnapshotBuilder::MAX_ITEMS];
+	char m_aSnapWorldData[CSnapshot::MAX_SIZE];
+	bool m_SnapWorldBuilding;
+	bool m_SnapWorldOverflow; // the world did not fit into one snapshot, clients are snapped one by one
+	int m_SnapView;
+
+	// where the time of a tick goes, see perf_status
+	enum
+	{
+		PERF_INPUT=0,
+		PERF_TICK,
+		PERF_SNAP,
+		PERF_SNAP_BUILD,
+		PERF_SNAP_DELTA,
+		PERF_SNAP_COMPRESS,
+		PERF_SNAP_SEND,
+		PERF_NETWORK,
+		PERF_REGISTER,
+		PERF_TOTAL,
+		NUM_PERF_PHASES
+	};
+
+	CTickProfiler m_Profiler;
+
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
+	EVENTLOOP *m_pEventLoop;
 	CServerBan m_ServerBan;
 
 	IEngineMap *m_pMap;
@@ -192,11 +267,21 @@ public:
 	int SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System);
 
 	void DoSnapshot();
+	CSnapshot *SnapWorld();
+	void SnapClient(int ClientID, CSnapshot *pWorld);
+	void FindSharedSnapJobs();
+	void ProcessSnapJobs(char *pDeltaData);
+	void SendSnapJob(const CSnapJob *pJob);
+	void SetSnapThreads(int NumThreads);
+	static void SnapWorkerThread(void *pUser);
 
 	static int NewClientCallback(int ClientID, void *pUser);
 	static int DelClientCallback(int ClientID, const char *pReason, void *pUser);
 
 	void SendMap(int ClientID);
+	void SendMapChunk(int ClientID, int Chunk);
+	void SendMapWindow(int ClientID);
+	void UpdateClientMapDownloads();
 	void SendConnectionReady(int ClientID);
 	void SendRconLine(int ClientID, const char *pLine);
 	static void SendRconLineAuthed(const char *pLine, void *pUser);
@@ -221,6 +306,7 @@ public:
 	static void ConKick(IConsole::IResult *pResult, void *pUser);
 	static void ConStatus(IConsole::IResult *pResult, void *pUser);
 	static void ConShutdown(IConsole::IResult *pResult, void *pUser);
+	static void ConPerfStatus(IConsole::IResult *pResult, void *pUser);
 	static void ConRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
@@ -228,6 +314,7 @@ public:
 	static void ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainModCommandUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainSnapThreadsUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainConsoleOutputLevelUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 
 	void RegisterCommands();
@@ -236,6 +323,7 @@ public:
 	virtual int SnapNewID();
 	virtual void SnapFreeID(int ID);
 	virtual void *SnapNewItem(int Type, int ID, int Size);
+	virtual void SnapSetView(int View);
 	void SnapSetStaticsize(int ItemType, int Size);
 };
 
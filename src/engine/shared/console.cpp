@@ -194,13 +194,17 @@ void CConsole::SetPrintOutputLevel(int Index, int OutputLevel)
 
 void CConsole::Print(int Level, const char *pFrom, const char *pStr)
 {
+	// with dbg_enable_threaded the logger thread writes stdout and the log file,
+	// the callbacks only buffer the line, rcon and econ send it with the next network update
 	dbg_msg(pFrom ,"%s", pStr);
+	char aBuf[1024];
+	aBuf[0] = 0;
 	for(int i = 0; i < m_NumPrintCB; ++i)
 	{
 		if(Level <= m_aPrintCB[i].m_OutputLevel && m_aPrintCB[i].m_pfnPrintCallback)
 		{
-			char aBuf[1024];
-			str_format(aBuf, sizeof(aBuf), "[%s]: %s", pFrom, pStr);
+			if(!aBuf[0])
+				str_format(aBuf, sizeof(aBuf), "[%s]: %s", pFrom, pStr);
 			m_aPrintCB[i].m_pfnPrintCallback(aBuf, m_aPrintCB[i].m_pPrintCallbackUserdata);
 		}
 	}
@@ -18,12 +18,22 @@ static const unsigned char gs_OldVersion = 3;
 static const int gs_LengthOffset = 152;
 static const int gs_NumMarkersOffset = 176;
 
+// keyframe index at the end of the demo
+static const int gs_IndexMagic = ('K'<<24)|('I'<<16)|('D'<<8)|'X';
+static const int gs_IndexFooterMagic = ('K'<<24)|('I'<<16)|('F'<<8)|'T';
+static const int gs_IndexChunkKeyFrames = 1024;
+static const int gs_IndexFooterMaxSize = 64;
+
 
 CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta)
 {
 	m_File = 0;
 	m_LastTickMarker = -1;
 	m_pSnapshotDelta = pSnapshotDelta;
+	m_pBuffer = 0;
+	m_pWriterThread = 0;
+	m_pKeyFrameIndex = 0;
+	m_KeyFrameInterval = SERVER_TICK_SPEED*5;
 }
 
 // Record
@@ -38,13 +48,13 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 
 	// open mapfile
 	char aMapFilename[128];
-	// try the normal maps folder
-	str_format(aMapFilename, sizeof(aMapFilename), "maps/%s.map", pMap);
+	// try the downloaded maps first, they are known to match the crc
+	str_format(aMapFilename, sizeof(aMapFilename), "downloadedmaps/%s_%08x.map", pMap, Crc);
 	IOHANDLE MapFile = pStorage->OpenFile(aMapFilename, IOFLAG_READ, IStorage::TYPE_ALL);
 	if(!MapFile)
 	{
-		// try the downloaded maps
-		str_format(aMapFilename, sizeof(aMapFilename), "downloadedmaps/%s_%08x.map", pMap, Crc);
+		// try the normal maps folder
+		str_format(aMapFilename, sizeof(aMapFilename), "maps/%s.map", pMap);
 		MapFile = pStorage->OpenFile(aMapFilename, IOFLAG_READ, IStorage::TYPE_ALL);
 	}
 	if(!MapFile)
@@ -95,26 +105,27 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	io_write(DemoFile, &Header, sizeof(Header));
 	io_write(DemoFile, &TimelineMarkers, sizeof(TimelineMarkers)); // fill this on stop
 
-	// write map data
-	while(1)
-	{
-		unsigned char aChunk[1024*64];
-		int Bytes = io_read(MapFile, &aChunk, sizeof(aChunk));
-		if(Bytes <= 0)
-			break;
-		io_write(DemoFile, &aChunk, Bytes);
-	}
-	io_close(MapFile);
+	// the map data is copied by the writer thread
+	m_MapFile = MapFile;
 
 	m_LastKeyFrame = -1;
+	m_LastWrittenTickMarker = -1;
+	m_NumKeyFrames = 0;
+	m_KeyFrameIndexSize = 0;
 	m_LastTickMarker = -1;
 	m_FirstTick = -1;
 	m_NumTimelineMarkers = 0;
 
+	m_pBuffer = (unsigned char *)mem_alloc(BUFFER_SIZE, sizeof(int));
+	m_ReadPos = 0;
+	m_WritePos = 0;
+	m_StopWriter = false;
+	m_File = DemoFile;
+	m_pWriterThread = thread_init(WriterThread, this);
+
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "Recording to '%s'", pFilename);
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
-	m_File = DemoFile;
 
 	return 0;
 }
@@ -140,6 +151,7 @@ enum
 	CHUNKMASK_TYPE = 0x60,
 	CHUNKMASK_SIZE = 0x1f,
 
+	CHUNKTYPE_INDEX = 0, // keyframe index, older players skip it
 	CHUNKTYPE_SNAPSHOT = 1,
 	CHUNKTYPE_MESSAGE = 2,
 	CHUNKTYPE_DELTA = 3,
@@ -147,9 +159,184 @@ enum
 	CHUNKFLAG_BIGSIZE = 0x10
 };
 
+void CDemoRecorder::WriterThread(void *pUser)
+{
+	CDemoRecorder *pSelf = (CDemoRecorder *)pUser;
+
+	// write map data
+	while(1)
+	{
+		unsigned char aChunk[1024*64];
+		int Bytes = io_read(pSelf->m_MapFile, &aChunk, sizeof(aChunk));
+		if(Bytes <= 0)
+			break;
+		io_write(pSelf->m_File, &aChunk, Bytes);
+	}
+	io_close(pSelf->m_MapFile);
+	pSelf->m_MapFile = 0;
+
+	while(1)
+	{
+		int ReadPos = pSelf->m_ReadPos;
+		if(ReadPos == pSelf->m_WritePos)
+		{
+			// everything is written, Stop waits for this
+			if(pSelf->m_StopWriter)
+				break;
+#if !defined(CONF_PLATFORM_MACOSX)
+			pSelf->m_DataAvailable.wait();
+#else
+			thread_sleep(1);
+#endif
+			continue;
+		}
+
+		sync_barrier();
+		const CRecord *pRecord = (const CRecord *)(pSelf->m_pBuffer+ReadPos);
+		if(pRecord->m_Type == RECORD_WRAP)
+		{
+			pSelf->m_ReadPos = 0;
+			continue;
+		}
+
+		pSelf->WriteRecord(pRecord);
+		sync_barrier();
+		pSelf->m_ReadPos = ReadPos+sizeof(CRecord)+((pRecord->m_Size+3)&~3);
+	}
+}
+
+void CDemoRecorder::AddRecord(int Type, int Tick, const void *pData, int Size)
+{
+	// records are never split, so the writer can use the data in place
+	int RecordSize = sizeof(CRecord)+((Size+3)&~3);
+	int WritePos = m_WritePos;
+	bool Wrap = WritePos+RecordSize+(int)sizeof(CRecord) > BUFFER_SIZE;
+
+	// wait until the writer made room, a full buffer means the disk can't keep up
+	while(1)
+	{
+		int ReadPos = m_ReadPos;
+		if(ReadPos <= WritePos ? (!Wrap || RecordSize < ReadPos) : WritePos+RecordSize < ReadPos)
+			break;
+		thread_sleep(1);
+	}
+
+	if(Wrap)
+	{
+		((CRecord *)(m_pBuffer+WritePos))->m_Type = RECORD_WRAP;
+		WritePos = 0;
+	}
+
+	CRecord *pRecord = (CRecord *)(m_pBuffer+WritePos);
+	pRecord->m_Type = Type;
+	pRecord->m_Tick = Tick;
+	pRecord->m_Size = Size;
+	mem_copy(pRecord+1, pData, Size);
+
+	sync_barrier();
+	m_WritePos = WritePos+RecordSize;
+#if !defined(CONF_PLATFORM_MACOSX)
+	m_DataAvailable.signal();
+#endif
+}
+
+void CDemoRecorder::WriteRecord(const CRecord *pRecord)
+{
+	const void *pData = pRecord+1;
+	int Tick = pRecord->m_Tick;
+	int Size = pRecord->m_Size;
+
+	if(pRecord->m_Type == RECORD_MESSAGE)
+		Write(CHUNKTYPE_MESSAGE, pData, Size);
+	else if(m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > m_KeyFrameInterval)
+	{
+		// write full tickmarker
+		AddKeyFrame(Tick, io_tell(m_File));
+		WriteTickMarker(Tick, 1);
+
+		// write snapshot
+		Write(CHUNKTYPE_SNAPSHOT, pData, Size);
+
+		m_LastKeyFrame = Tick;
+		mem_copy(m_aLastSnapshotData, pData, Size);
+	}
+	else
+	{
+		// create delta, prepend tick
+		char aDeltaData[CSnapshot::MAX_SIZE+sizeof(int)];
+		int DeltaSize;
+
+		// write tickmarker
+		WriteTickMarker(Tick, 0);
+
+		DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)pData, &aDeltaData);
+		if(DeltaSize)
+		{
+			// record delta
+			Write(CHUNKTYPE_DELTA, aDeltaData, DeltaSize);
+			mem_copy(m_aLastSnapshotData, pData, Size);
+		}
+	}
+}
+
+void CDemoRecorder::AddKeyFrame(int Tick, int Filepos)
+{
+	if(m_NumKeyFrames == m_KeyFrameIndexSize)
+	{
+		m_KeyFrameIndexSize = max(m_KeyFrameIndexSize*2, 256);
+		int *pNewIndex = (int *)mem_alloc(m_KeyFrameIndexSize*2*sizeof(int), sizeof(int));
+		if(m_pKeyFrameIndex)
+		{
+			mem_copy(pNewIndex, m_pKeyFrameIndex, m_NumKeyFrames*2*sizeof(int));
+			mem_free(m_pKeyFrameIndex);
+		}
+		m_pKeyFrameIndex = pNewIndex;
+	}
+
+	m_pKeyFrameIndex[m_NumKeyFrames*2] = Tick;
+	m_pKeyFrameIndex[m_NumKeyFrames*2+1] = Filepos;
+	m_NumKeyFrames++;
+}
+
+/*
+	Keyframe index
+		A number of CHUNKTYPE_INDEX chunks with up to gs_IndexChunkKeyFrames
+		keyframes each: magic, number of keyframes and then tick and file
+		position of every keyframe, both relative to the previous one.
+		The last chunk of the file is the footer: magic, position of the
+		first index chunk, number of keyframes, first and last tick.
+*/
+void CDemoRecorder::WriteKeyFrameIndex()
+{
+	if(!m_NumKeyFrames)
+		return;
+
+	int IndexStart = io_tell(m_File);
+	int aData[2+gs_IndexChunkKeyFrames*2];
+	int LastTick = 0;
+	int LastFilepos = 0;
+	for(int i = 0; i < m_NumKeyFrames; i += gs_IndexChunkKeyFrames)
+	{
+		int Num = min(m_NumKeyFrames-i, gs_IndexChunkKeyFrames);
+		aData[0] = gs_IndexMagic;
+		aData[1] = Num;
+		for(int k = 0; k < Num; k++)
+		{
+			aData[2+k*2] = m_pKeyFrameIndex[(i+k)*2]-LastTick;
+			aData[2+k*2+1] = m_pKeyFrameIndex[(i+k)*2+1]-LastFilepos;
+			LastTick = m_pKeyFrameIndex[(i+k)*2];
+			LastFilepos = m_pKeyFrameIndex[(i+k)*2+1];
+		}
+		Write(CHUNKTYPE_INDEX, aData, (2+Num*2)*sizeof(int));
+	}
+
+	int aFooter[5] = { gs_IndexFooterMagic, IndexStart, m_NumKeyFrames, m_FirstTick, m_LastTickMarker };
+	Write(CHUNKTYPE_INDEX, aFooter, sizeof(aFooter));
+}
+
 void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
 {
-	if(m_LastTickMarker == -1 || Tick-m_LastTickMarker > 63 || Keyframe)
+	if(m_LastWrittenTickMarker == -1 || Tick-m_LastWrittenTickMarker > 63 || Keyframe)
 	{
 		unsigned char aChunk[5];
 		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER;
@@ -166,13 +353,11 @@ void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
 	else
 	{
 		unsigned char aChunk[1];
-		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | (Tick-m_LastTickMarker);
+		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | (Tick-m_LastWrittenTickMarker);
 		io_write(m_File, aChunk, sizeof(aChunk));
 	}
 
-	m_LastTickMarker = Tick;
-	if(m_FirstTick < 0)
-		m_FirstTick = Tick;
+	m_LastWrittenTickMarker = Tick;
 }
 
 void CDemoRecorder::Write(int Type, const void *pData, int Size)
@@ -221,39 +406,22 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 
 void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 {
-	if(m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*5)
-	{
-		// write full tickmarker
-		WriteTickMarker(Tick, 1);
-
-		// write snapshot
-		Write(CHUNKTYPE_SNAPSHOT, pData, Size);
-
-		m_LastKeyFrame = Tick;
-		mem_copy(m_aLastSnapshotData, pData, Size);
-	}
-	else
-	{
-		// create delta, prepend tick
-		char aDeltaData[CSnapshot::MAX_SIZE+sizeof(int)];
-		int DeltaSize;
+	if(!m_File)
+		return;
 
-		// write tickmarker
-		WriteTickMarker(Tick, 0);
+	AddRecord(RECORD_SNAPSHOT, Tick, pData, Size);
 
-		DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)pData, &aDeltaData);
-		if(DeltaSize)
-		{
-			// record delta
-			Write(CHUNKTYPE_DELTA, aDeltaData, DeltaSize);
-			mem_copy(m_aLastSnapshotData, pData, Size);
-		}
-	}
+	m_LastTickMarker = Tick;
+	if(m_FirstTick < 0)
+		m_FirstTick = Tick;
 }
 
 void CDemoRecorder::RecordMessage(const void *pData, int Size)
 {
-	Write(CHUNKTYPE_MESSAGE, pData, Size);
+	if(!m_File)
+		return;
+
+	AddRecord(RECORD_MESSAGE, 0, pData, Size);
 }
 
 int CDemoRecorder::Stop()
@@ -261,6 +429,20 @@ int CDemoRecorder::Stop()
 	if(!m_File)
 		return -1;
 
+	// let the writer thread finish the queued records
+	m_StopWriter = true;
+#if !defined(CONF_PLATFORM_MACOSX)
+	m_DataAvailable.signal();
+#endif
+	thread_wait(m_pWriterThread);
+	m_pWriterThread = 0;
+	mem_free(m_pBuffer);
+	m_pBuffer = 0;
+
+	WriteKeyFrameIndex();
+	mem_free(m_pKeyFrameIndex);
+	m_pKeyFrameIndex = 0;
+
 	// add the demo length to the header
 	io_seek(m_File, gs_LengthOffset, IOSEEK_START);
 	int DemoLength = Length();
@@ -321,6 +503,7 @@ CDemoPlayer::CDemoPlayer(class CSnapshotDelta *pSnapshotDelta)
 {
 	m_File = 0;
 	m_pKeyFrames = 0;
+	m_DataEnd = -1;
 
 	m_pSnapshotDelta = pSnapshotDelta;
 	m_LastSnapshotDataSize = -1;
@@ -339,6 +522,10 @@ int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
 	*pSize = 0;
 	*pType = 0;
 
+	// the keyframe index is not part of the playback
+	if(m_DataEnd >= 0 && io_tell(m_File) >= m_DataEnd)
+		return -1;
+
 	if(io_read(m_File, &Chunk, sizeof(Chunk)) != sizeof(Chunk))
 		return -1;
 
@@ -445,6 +632,116 @@ void CDemoPlayer::ScanFile()
 	io_seek(m_File, StartPos, IOSEEK_START);
 }
 
+bool CDemoPlayer::ReadKeyFrameIndex()
+{
+	static char aCompresseddata[CSnapshot::MAX_SIZE];
+	static char aDecompressed[CSnapshot::MAX_SIZE];
+	static int aData[CSnapshot::MAX_SIZE/sizeof(int)];
+	long StartPos = io_tell(m_File);
+	long FileSize = io_length(m_File);
+
+	// the footer is the last chunk of the file, look for a chunk header that ends exactly there
+	unsigned char aTail[gs_IndexFooterMaxSize];
+	int TailSize = (int)min(FileSize-StartPos, (long)sizeof(aTail));
+	if(TailSize <= 0)
+		return false;
+	io_seek(m_File, FileSize-TailSize, IOSEEK_START);
+	if(io_read(m_File, aTail, TailSize) != (unsigned)TailSize)
+	{
+		io_seek(m_File, StartPos, IOSEEK_START);
+		return false;
+	}
+
+	int IndexStart = -1;
+	int NumKeyFrames = 0;
+	int FirstTick = 0;
+	int LastTick = 0;
+	for(int i = 0; i < TailSize && IndexStart < 0; i++)
+	{
+		if(aTail[i]&(CHUNKTYPEFLAG_TICKMARKER|CHUNKMASK_TYPE))
+			continue;
+		int HeaderSize = 1;
+		int Size = aTail[i]&CHUNKMASK_SIZE;
+		if(Size == 30 && i+1 < TailSize)
+		{
+			HeaderSize = 2;
+			Size = aTail[i+1];
+		}
+		else if(Size == 31 && i+2 < TailSize)
+		{
+			HeaderSize = 3;
+			Size = (aTail[i+2]<<8) | aTail[i+1];
+		}
+		if(Size == 0 || i+HeaderSize+Size != TailSize)
+			continue;
+
+		int DataSize = CNetBase::Decompress(&aTail[i+HeaderSize], Size, aDecompressed, gs_IndexFooterMaxSize);
+		if(DataSize < 0)
+			continue;
+		DataSize = CVariableInt::Decompress(aDecompressed, DataSize, aData);
+		if(DataSize != 5*sizeof(int) || aData[0] != gs_IndexFooterMagic)
+			continue;
+		// every keyframe takes at least a few bytes of the file
+		if(aData[1] < StartPos || aData[1] >= FileSize-TailSize+i || aData[2] <= 0 || aData[2] > aData[1]-StartPos)
+			continue;
+
+		IndexStart = aData[1];
+		NumKeyFrames = aData[2];
+		FirstTick = aData[3];
+		LastTick = aData[4];
+	}
+	if(IndexStart < 0)
+	{
+		io_seek(m_File, StartPos, IOSEEK_START);
+		return false;
+	}
+
+	// read the index chunks
+	m_pKeyFrames = (CKeyFrame*)mem_alloc(NumKeyFrames*sizeof(CKeyFrame), 1);
+	io_seek(m_File, IndexStart, IOSEEK_START);
+	int Num = 0;
+	int Tick = 0;
+	int Filepos = 0;
+	while(Num < NumKeyFrames)
+	{
+		int ChunkType, ChunkSize, ChunkTick = 0;
+		if(ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick) || ChunkType != CHUNKTYPE_INDEX ||
+			ChunkSize <= 0 || io_read(m_File, aCompresseddata, ChunkSize) != (unsigned)ChunkSize)
+			break;
+
+		int DataSize = CNetBase::Decompress(aCompresseddata, ChunkSize, aDecompressed, sizeof(aDecompressed)/4);
+		if(DataSize < 0)
+			break;
+		DataSize = CVariableInt::Decompress(aDecompressed, DataSize, aData);
+		if(DataSize < (int)(2*sizeof(int)) || aData[0] != gs_IndexMagic || aData[1] <= 0 || aData[1] > NumKeyFrames-Num ||
+			DataSize < (int)((2+aData[1]*2)*sizeof(int)))
+			break;
+
+		for(int k = 0; k < aData[1]; k++, Num++)
+		{
+			Tick += aData[2+k*2];
+			Filepos += aData[2+k*2+1];
+			m_pKeyFrames[Num].m_Tick = Tick;
+			m_pKeyFrames[Num].m_Filepos = Filepos;
+		}
+	}
+
+	if(Num != NumKeyFrames || m_pKeyFrames[0].m_Filepos < StartPos || m_pKeyFrames[Num-1].m_Filepos >= IndexStart)
+	{
+		mem_free(m_pKeyFrames);
+		m_pKeyFrames = 0;
+		io_seek(m_File, StartPos, IOSEEK_START);
+		return false;
+	}
+
+	m_Info.m_SeekablePoints = NumKeyFrames;
+	m_Info.m_Info.m_FirstTick = FirstTick;
+	m_Info.m_Info.m_LastTick = LastTick;
+	m_DataEnd = IndexStart;
+	io_seek(m_File, StartPos, IOSEEK_START);
+	return true;
+}
+
 void CDemoPlayer::DoTick()
 {
 	static char aCompresseddata[CSnapshot::MAX_SIZE];
@@ -680,8 +977,10 @@ int CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole, const
 		}
 	}
 
-	// scan the file for interessting points
-	ScanFile();
+	// use the keyframe index if the demo has one, else scan the file for interessting points
+	m_DataEnd = -1;
+	if(!ReadKeyFrameIndex())
+		ScanFile();
 
 	// ready for playback
 	return 0;
@@ -722,13 +1021,18 @@ int CDemoPlayer::SetPos(float Percent)
 	if(Keyframe < 0 || Keyframe >= m_Info.m_SeekablePoints)
 		return -1;
 
-	// get correct key frame
-	if(m_pKeyFrames[Keyframe].m_Tick < WantedTick)
-		while(Keyframe < m_Info.m_SeekablePoints-1 && m_pKeyFrames[Keyframe].m_Tick < WantedTick)
-			Keyframe++;
-
-	while(Keyframe && m_pKeyFrames[Keyframe].m_Tick > WantedTick)
-		Keyframe--;
+	// get the last key frame before the wanted tick
+	int Low = 0;
+	int High = m_Info.m_SeekablePoints-1;
+	while(Low < High)
+	{
+		int Mid = (Low+High+1)/2;
+		if(m_pKeyFrames[Mid].m_Tick > WantedTick)
+			High = Mid-1;
+		else
+			Low = Mid;
+	}
+	Keyframe = Low;
 
 	// seek to the correct keyframe
 	io_seek(m_File, m_pKeyFrames[Keyframe].m_Filepos, IOSEEK_START);
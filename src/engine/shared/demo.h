@@ -3,23 +3,70 @@
 #ifndef ENGINE_SHARED_DEMO_H
 #define ENGINE_SHARED_DEMO_H
 
+#include <base/tl/threading.h>
+
 #include <engine/demo.h>
 #include <engine/shared/protocol.h>
 
 #include "snapshot.h"
 
+/*
+	Class: Demo Recorder
+		Records snapshots and messages into a demo file. The calling thread
+		only copies the data into a buffer, a writer thread creates the
+		deltas, compresses them and writes the file.
+*/
 class CDemoRecorder : public IDemoRecorder
 {
+	enum
+	{
+		BUFFER_SIZE=1024*1024,
+
+		RECORD_SNAPSHOT=0,
+		RECORD_MESSAGE,
+		RECORD_WRAP, // the next record starts at the beginning of the buffer
+	};
+
+	struct CRecord
+	{
+		int m_Type;
+		int m_Tick;
+		int m_Size;
+	};
+
 	class IConsole *m_pConsole;
 	IOHANDLE m_File;
 	int m_LastTickMarker;
-	int m_LastKeyFrame;
 	int m_FirstTick;
-	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
 	class CSnapshotDelta *m_pSnapshotDelta;
 	int m_NumTimelineMarkers;
 	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
+	int m_KeyFrameInterval;
+
+	// records on their way to the writer thread
+	unsigned char *m_pBuffer;
+	volatile int m_ReadPos;
+	volatile int m_WritePos;
+	void *m_pWriterThread;
+	volatile bool m_StopWriter;
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore m_DataAvailable;
+#endif
 
+	// only used by the writer thread
+	IOHANDLE m_MapFile;
+	int m_LastKeyFrame;
+	int m_LastWrittenTickMarker;
+	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
+	int *m_pKeyFrameIndex; // tick and file position of every keyframe
+	int m_NumKeyFrames;
+	int m_KeyFrameIndexSize;
+
+	static void WriterThread(void *pUser);
+	void AddRecord(int Type, int Tick, const void *pData, int Size);
+	void WriteRecord(const CRecord *pRecord);
+	void AddKeyFrame(int Tick, int Filepos);
+	void WriteKeyFrameIndex();
 	void WriteTickMarker(int Tick, int Keyframe);
 	void Write(int Type, const void *pData, int Size);
 public:
@@ -29,6 +76,9 @@ public:
 	int Stop();
 	void AddDemoMarker();
 
+	// ticks between two keyframes, can only be changed while not recording
+	void SetKeyFrameInterval(int Ticks) { if(!m_File) m_KeyFrameInterval = Ticks; }
+
 	void RecordSnapshot(int Tick, const void *pData, int Size);
 	void RecordMessage(const void *pData, int Size);
 
@@ -86,6 +136,7 @@ private:
 
 	class IConsole *m_pConsole;
 	IOHANDLE m_File;
+	long m_DataEnd; // start of the keyframe index, -1 if the demo has none
 	char m_aFilename[256];
 	CKeyFrame *m_pKeyFrames;
 
@@ -97,6 +148,7 @@ private:
 
 	int ReadChunkHeader(int *pType, int *pSize, int *pTick);
 	void DoTick();
+	bool ReadKeyFrameIndex();
 	void ScanFile();
 	int NextFrame();
 
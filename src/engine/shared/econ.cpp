@@ -60,7 +60,7 @@ void CEcon::ConLogout(IConsole::IResult *pResult, void *pUserData)
 		pThis->m_NetConsole.Drop(pThis->m_UserClientID, "Logout");
 }
 
-void CEcon::Init(IConsole *pConsole, CNetBan *pNetBan)
+void CEcon::Init(IConsole *pConsole, CNetBan *pNetBan, EVENTLOOP *pEventLoop)
 {
 	m_pConsole = pConsole;
 
@@ -87,7 +87,7 @@ void CEcon::Init(IConsole *pConsole, CNetBan *pNetBan)
 		BindAddr.port = g_Config.m_EcPort;
 	}
 
-	if(m_NetConsole.Open(BindAddr, pNetBan, 0))
+	if(m_NetConsole.Open(BindAddr, pNetBan, 0, pEventLoop))
 	{
 		m_NetConsole.SetCallbacks(NewClientCallback, DelClientCallback, this);
 		m_Ready = true;
@@ -158,6 +158,9 @@ void CEcon::Update()
 			time_get() > m_aClients[i].m_TimeConnected + g_Config.m_EcAuthTimeout * time_freq())
 			m_NetConsole.Drop(i, "authentication timeout");
 	}
+
+	// send the answers right away
+	m_NetConsole.Flush();
 }
 
 void CEcon::Send(int ClientID, const char *pLine)
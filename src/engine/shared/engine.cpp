@@ -61,6 +61,7 @@ public:
 		srand(time_get());
 		dbg_logger_stdout();
 		dbg_logger_debugger();
+		dbg_enable_threaded();
 
 		//
 		dbg_msg("engine", "running on %s-%s-%s", CONF_FAMILY_STRING, CONF_PLATFORM_STRING, CONF_ARCH_STRING);
@@ -1,75 +1,255 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 #include "jobs.h"
 
 CJobPool::CJobPool()
 {
 	// empty the pool
-	m_Lock = lock_create();
-	m_pFirstJob = 0;
-	m_pLastJob = 0;
+	for(int i = 0; i < MAX_THREADS; i++)
+	{
+		m_aQueues[i].m_Lock = lock_create();
+		for(int p = 0; p < NUM_PRIORITIES; p++)
+		{
+			m_aQueues[i].m_apFirstJob[p] = 0;
+			m_aQueues[i].m_apLastJob[p] = 0;
+		}
+		m_aQueues[i].m_pPool = this;
+		m_aQueues[i].m_Index = i;
+		m_aQueues[i].m_pThread = 0;
+	}
+	m_NumQueues = 1;
+	m_NumThreads = 0;
+	m_NextQueue = 0;
+	m_Shutdown = false;
+
+	m_WaitLock = lock_create();
+	m_NumWaiters = 0;
+}
+
+CJobPool::~CJobPool()
+{
+	// let the workers finish their current job and stop
+	m_Shutdown = true;
+#if !defined(CONF_PLATFORM_MACOSX)
+	for(int i = 0; i < m_NumThreads; i++)
+		m_Activity.signal();
+#endif
+	for(int i = 0; i < m_NumThreads; i++)
+		thread_wait(m_aQueues[i].m_pThread);
+
+	for(int i = 0; i < MAX_THREADS; i++)
+		lock_destroy(m_aQueues[i].m_Lock);
+	lock_destroy(m_WaitLock);
 }
 
 void CJobPool::WorkerThread(void *pUser)
 {
-	CJobPool *pPool = (CJobPool *)pUser;
+	CQueue *pQueue = (CQueue *)pUser;
+	CJobPool *pPool = pQueue->m_pPool;
 
 	while(1)
 	{
-		CJob *pJob = 0;
-
-		// fetch job from queue
-		lock_wait(pPool->m_Lock);
-		if(pPool->m_pFirstJob)
-		{
-			pJob = pPool->m_pFirstJob;
-			pPool->m_pFirstJob = pPool->m_pFirstJob->m_pNext;
-			if(pPool->m_pFirstJob)
-				pPool->m_pFirstJob->m_pPrev = 0;
-			else
-				pPool->m_pLastJob = 0;
-		}
-		lock_unlock(pPool->m_Lock);
+		// sleep until a job gets added
+#if !defined(CONF_PLATFORM_MACOSX)
+		pPool->m_Activity.wait();
+#endif
+		if(pPool->m_Shutdown)
+			break;
 
-		// do the job if we have one
+		// do the job if we have one, it might have been taken by a waiting thread already
+		CJob *pJob = pPool->Fetch(pQueue->m_Index);
 		if(pJob)
-		{
-			pJob->m_Status = CJob::STATE_RUNNING;
-			pJob->m_Result = pJob->m_pfnFunc(pJob->m_pFuncData);
-			pJob->m_Status = CJob::STATE_DONE;
-		}
+			pPool->Run(pJob);
+#if defined(CONF_PLATFORM_MACOSX)
 		else
 			thread_sleep(10);
+#endif
 	}
-
 }
 
 int CJobPool::Init(int NumThreads)
 {
-	// start threads
-	for(int i = 0; i < NumThreads; i++)
-		thread_init(WorkerThread, this);
+	dbg_assert(m_NumThreads == 0, "job pool already initialized");
+
+	// start threads, every thread gets its own queue
+	m_NumThreads = clamp(NumThreads, 0, (int)MAX_THREADS);
+	m_NumQueues = max(m_NumThreads, 1);
+	for(int i = 0; i < m_NumThreads; i++)
+		m_aQueues[i].m_pThread = thread_init(WorkerThread, &m_aQueues[i]);
 	return 0;
 }
 
-int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData)
+int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData, int Priority, CJobGroup *pGroup)
 {
 	mem_zero(pJob, sizeof(CJob));
+	pJob->m_pPool = this;
 	pJob->m_pfnFunc = pfnFunc;
 	pJob->m_pFuncData = pData;
+	pJob->m_Priority = clamp(Priority, 0, NUM_PRIORITIES-1);
+	pJob->m_pGroup = pGroup;
+
+	if(pGroup)
+	{
+		lock_wait(m_WaitLock);
+		pGroup->m_NumPending++;
+		lock_unlock(m_WaitLock);
+	}
 
-	lock_wait(m_Lock);
+	// spread the jobs over the queues
+	pJob->m_Queue = (atomic_inc(&m_NextQueue)-1)%m_NumQueues;
+	CQueue *pQueue = &m_aQueues[pJob->m_Queue];
+
+	lock_wait(pQueue->m_Lock);
 
 	// add job to queue
-	pJob->m_pPrev = m_pLastJob;
-	if(m_pLastJob)
-		m_pLastJob->m_pNext = pJob;
-	m_pLastJob = pJob;
-	if(!m_pFirstJob)
-		m_pFirstJob = pJob;
-
-	lock_unlock(m_Lock);
+	pJob->m_pPrev = pQueue->m_apLastJob[pJob->m_Priority];
+	if(pQueue->m_apLastJob[pJob->m_Priority])
+		pQueue->m_apLastJob[pJob->m_Priority]->m_pNext = pJob;
+	pQueue->m_apLastJob[pJob->m_Priority] = pJob;
+	if(!pQueue->m_apFirstJob[pJob->m_Priority])
+		pQueue->m_apFirstJob[pJob->m_Priority] = pJob;
+
+	lock_unlock(pQueue->m_Lock);
+
+#if !defined(CONF_PLATFORM_MACOSX)
+	m_Activity.signal();
+#endif
 	return 0;
 }
 
+void CJobPool::Unlink(CQueue *pQueue, CJob *pJob)
+{
+	// the queue has to be locked
+	if(pJob->m_pPrev)
+		pJob->m_pPrev->m_pNext = pJob->m_pNext;
+	else
+		pQueue->m_apFirstJob[pJob->m_Priority] = pJob->m_pNext;
+	if(pJob->m_pNext)
+		pJob->m_pNext->m_pPrev = pJob->m_pPrev;
+	else
+		pQueue->m_apLastJob[pJob->m_Priority] = pJob->m_pPrev;
+
+	pJob->m_pPrev = 0;
+	pJob->m_pNext = 0;
+	pJob->m_Status = CJob::STATE_RUNNING;
+}
+
+CJob *CJobPool::Fetch(int Queue)
+{
+	// highest priority first, from the own queue before stealing from the others.
+	// the owner takes the oldest job, thieves take the newest one
+	for(int p = 0; p < NUM_PRIORITIES; p++)
+		for(int i = 0; i < m_NumQueues; i++)
+		{
+			CQueue *pQueue = &m_aQueues[(Queue+i)%m_NumQueues];
+			lock_wait(pQueue->m_Lock);
+			CJob *pJob = i == 0 ? pQueue->m_apFirstJob[p] : pQueue->m_apLastJob[p];
+			if(pJob)
+				Unlink(pQueue, pJob);
+			lock_unlock(pQueue->m_Lock);
+
+			if(pJob)
+				return pJob;
+		}
+	return 0;
+}
+
+bool CJobPool::RunPending(CJob *pJob)
+{
+	if(pJob->m_Status != CJob::STATE_PENDING)
+		return false;
+
+	// take it out of its queue unless a worker was faster
+	CQueue *pQueue = &m_aQueues[pJob->m_Queue];
+	lock_wait(pQueue->m_Lock);
+	bool Pending = pJob->m_Status == CJob::STATE_PENDING;
+	if(Pending)
+		Unlink(pQueue, pJob);
+	lock_unlock(pQueue->m_Lock);
+
+	if(Pending)
+		Run(pJob);
+	return Pending;
+}
+
+void CJobPool::Run(CJob *pJob)
+{
+	pJob->m_Result = pJob->m_pfnFunc(pJob->m_pFuncData);
+
+	// the job and its group may be gone as soon as the lock is released
+	lock_wait(m_WaitLock);
+	pJob->m_Status = CJob::STATE_DONE;
+	if(pJob->m_pGroup)
+		pJob->m_pGroup->m_NumPending--;
+	int NumWaiters = m_NumWaiters;
+	m_NumWaiters = 0;
+	lock_unlock(m_WaitLock);
+
+#if !defined(CONF_PLATFORM_MACOSX)
+	for(int i = 0; i < NumWaiters; i++)
+		m_JobDone.signal();
+#endif
+}
+
+void CJobPool::WaitDone()
+{
+	// m_WaitLock has to be locked, it is again when this returns
+	m_NumWaiters++;
+	lock_unlock(m_WaitLock);
+#if !defined(CONF_PLATFORM_MACOSX)
+	m_JobDone.wait();
+#else
+	thread_sleep(1);
+#endif
+	lock_wait(m_WaitLock);
+}
+
+void CJobPool::Wait(CJob *pJob)
+{
+	if(RunPending(pJob))
+		return;
+
+	lock_wait(m_WaitLock);
+	while(pJob->m_Status != CJob::STATE_DONE)
+		WaitDone();
+	lock_unlock(m_WaitLock);
+}
+
+void CJobPool::Wait(CJobGroup *pGroup)
+{
+	// run the jobs of the group that didn't start yet
+	for(int i = 0; i < m_NumQueues; i++)
+	{
+		CQueue *pQueue = &m_aQueues[i];
+		for(int p = 0; p < NUM_PRIORITIES; p++)
+		{
+			lock_wait(pQueue->m_Lock);
+			CJob *pJob = pQueue->m_apFirstJob[p];
+			while(pJob)
+			{
+				if(pJob->m_pGroup != pGroup)
+				{
+					pJob = pJob->m_pNext;
+					continue;
+				}
+
+				Unlink(pQueue, pJob);
+				lock_unlock(pQueue->m_Lock);
+				Run(pJob);
+
+				// the queue might have changed in the meantime
+				lock_wait(pQueue->m_Lock);
+				pJob = pQueue->m_apFirstJob[p];
+			}
+			lock_unlock(pQueue->m_Lock);
+		}
+	}
+
+	// and wait for the ones that are running
+	lock_wait(m_WaitLock);
+	while(pGroup->m_NumPending)
+		WaitDone();
+	lock_unlock(m_WaitLock);
+}
@@ -2,10 +2,25 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #ifndef ENGINE_SHARED_JOBS_H
 #define ENGINE_SHARED_JOBS_H
+
+#include <base/tl/threading.h>
+
 typedef int (*JOBFUNC)(void *pData);
 
 class CJobPool;
 
+// counts the unfinished jobs that were added with it, see CJobPool::Wait
+class CJobGroup
+{
+	friend class CJobPool;
+
+	volatile int m_NumPending;
+public:
+	CJobGroup() { m_NumPending = 0; }
+
+	int NumPending() const { return m_NumPending; }
+};
+
 class CJob
 {
 	friend class CJobPool;
@@ -19,6 +34,10 @@ class CJob
 
 	JOBFUNC m_pfnFunc;
 	void *m_pFuncData;
+
+	int m_Priority;
+	int m_Queue;
+	CJobGroup *m_pGroup;
 public:
 	CJob()
 	{
@@ -37,18 +56,87 @@ public:
 	int Result() const {return m_Result; }
 };
 
+/*
+	Class: Job Pool
+		Runs jobs on a set of worker threads. Every worker has its own
+		queue, jobs are spread over them and idle workers steal from the
+		others. Higher priority jobs are always picked first.
+*/
 class CJobPool
 {
-	LOCK m_Lock;
-	CJob *m_pFirstJob;
-	CJob *m_pLastJob;
+public:
+	enum
+	{
+		PRIORITY_HIGH=0,
+		PRIORITY_NORMAL,
+		PRIORITY_LOW,
+		NUM_PRIORITIES,
+
+		MAX_THREADS=16,
+	};
+
+private:
+	class CQueue
+	{
+	public:
+		LOCK m_Lock;
+		CJob *m_apFirstJob[NUM_PRIORITIES];
+		CJob *m_apLastJob[NUM_PRIORITIES];
+
+		CJobPool *m_pPool;
+		int m_Index;
+		void *m_pThread;
+	};
+
+	CQueue m_aQueues[MAX_THREADS];
+	int m_NumQueues;
+	int m_NumThreads;
+	volatile unsigned m_NextQueue;
+	volatile bool m_Shutdown;
+
+	// guards the job states for waiting
+	LOCK m_WaitLock;
+	int m_NumWaiters;
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore m_Activity;
+	semaphore m_JobDone;
+#endif
 
 	static void WorkerThread(void *pUser);
 
+	void Unlink(CQueue *pQueue, CJob *pJob);
+	CJob *Fetch(int Queue);
+	bool RunPending(CJob *pJob);
+	void Run(CJob *pJob);
+	void WaitDone();
+
 public:
 	CJobPool();
+	~CJobPool();
 
 	int Init(int NumThreads);
-	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData);
+	int NumThreads() const { return m_NumThreads; }
+
+	/*
+		Function: Add
+			Queues a job, pfnFunc(pData) will be run on one of the workers.
+
+		Arguments:
+			pJob - Job to fill in, has to stay valid until the job is done.
+			pfnFunc - Function to run.
+			pData - Argument for the function.
+			Priority - One of PRIORITY_HIGH, PRIORITY_NORMAL and PRIORITY_LOW.
+			pGroup - Optional group that counts the job until it's done.
+	*/
+	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData, int Priority = PRIORITY_NORMAL, CJobGroup *pGroup = 0);
+
+	/*
+		Function: Wait
+			Blocks until a job or all jobs of a group are done. Jobs that
+			didn't start yet are run on the calling thread instead of
+			waiting for a worker.
+	*/
+	void Wait(CJob *pJob);
+	void Wait(CJobGroup *pGroup);
 };
 #endif
@@ -91,19 +91,21 @@ int CNetRecvUnpacker::FetchChunk(CNetChunk *pChunk)
 void CNetBase::SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize)
 {
 	unsigned char aBuffer[NET_MAX_PACKETSIZE];
-	aBuffer[0] = 0xff;
-	aBuffer[1] = 0xff;
-	aBuffer[2] = 0xff;
-	aBuffer[3] = 0xff;
-	aBuffer[4] = 0xff;
-	aBuffer[5] = 0xff;
-	mem_copy(&aBuffer[6], pData, DataSize);
-	net_udp_send(Socket, pAddr, aBuffer, 6+DataSize);
+	unsigned char *pBuffer = SendBuffer(Socket, aBuffer);
+	pBuffer[0] = 0xff;
+	pBuffer[1] = 0xff;
+	pBuffer[2] = 0xff;
+	pBuffer[3] = 0xff;
+	pBuffer[4] = 0xff;
+	pBuffer[5] = 0xff;
+	mem_copy(&pBuffer[6], pData, DataSize);
+	SendBuffered(Socket, pAddr, pBuffer, 6+DataSize);
 }
 
 void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct *pPacket)
 {
 	unsigned char aBuffer[NET_MAX_PACKETSIZE];
+	unsigned char *pBuffer = SendBuffer(Socket, aBuffer);
 	int CompressedSize = -1;
 	int FinalSize = -1;
 
@@ -118,7 +120,7 @@ void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct
 	}
 
 	// compress
-	CompressedSize = ms_Huffman.Compress(pPacket->m_aChunkData, pPacket->m_DataSize, &aBuffer[3], NET_MAX_PACKETSIZE-4);
+	CompressedSize = ms_Huffman.Compress(pPacket->m_aChunkData, pPacket->m_DataSize, &pBuffer[3], NET_MAX_PACKETSIZE-4);
 
 	// check if the compression was enabled, successful and good enough
 	if(CompressedSize > 0 && CompressedSize < pPacket->m_DataSize)
@@ -130,7 +132,7 @@ void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct
 	{
 		// use uncompressed data
 		FinalSize = pPacket->m_DataSize;
-		mem_copy(&aBuffer[3], pPacket->m_aChunkData, pPacket->m_DataSize);
+		mem_copy(&pBuffer[3], pPacket->m_aChunkData, pPacket->m_DataSize);
 		pPacket->m_Flags &= ~NET_PACKETFLAG_COMPRESSION;
 	}
 
@@ -138,10 +140,10 @@ void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct
 	if(FinalSize >= 0)
 	{
 		FinalSize += NET_PACKETHEADERSIZE;
-		aBuffer[0] = ((pPacket->m_Flags<<4)&0xf0)|((pPacket->m_Ack>>8)&0xf);
-		aBuffer[1] = pPacket->m_Ack&0xff;
-		aBuffer[2] = pPacket->m_NumChunks;
-		net_udp_send(Socket, pAddr, aBuffer, FinalSize);
+		pBuffer[0] = ((pPacket->m_Flags<<4)&0xf0)|((pPacket->m_Ack>>8)&0xf);
+		pBuffer[1] = pPacket->m_Ack&0xff;
+		pBuffer[2] = pPacket->m_NumChunks;
+		SendBuffered(Socket, pAddr, pBuffer, FinalSize);
 
 		// log raw socket data
 		if(ms_DataLogSent)
@@ -149,12 +151,60 @@ void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct
 			int Type = 0;
 			io_write(ms_DataLogSent, &Type, sizeof(Type));
 			io_write(ms_DataLogSent, &FinalSize, sizeof(FinalSize));
-			io_write(ms_DataLogSent, aBuffer, FinalSize);
+			io_write(ms_DataLogSent, pBuffer, FinalSize);
 			io_flush(ms_DataLogSent);
 		}
 	}
 }
 
+unsigned char *CNetBase::SendBuffer(NETSOCKET Socket, unsigned char *pDefault)
+{
+	if(!ms_BatchDepth)
+		return pDefault;
+
+	// a batch only goes out over one socket
+	if(ms_NumBatchPackets && (ms_BatchSocket.ipv4sock != Socket.ipv4sock || ms_BatchSocket.ipv6sock != Socket.ipv6sock))
+		FlushBatch();
+	if(ms_NumBatchPackets == NET_BATCH_SIZE)
+		FlushBatch();
+
+	ms_BatchSocket = Socket;
+	return ms_aaBatchData[ms_NumBatchPackets];
+}
+
+void CNetBase::SendBuffered(NETSOCKET Socket, NETADDR *pAddr, unsigned char *pBuffer, int Size)
+{
+	if(!ms_BatchDepth)
+	{
+		net_udp_send(Socket, pAddr, pBuffer, Size);
+		return;
+	}
+
+	NETUDPPACKET *pPacket = &ms_aBatchPackets[ms_NumBatchPackets++];
+	pPacket->addr = *pAddr;
+	pPacket->data = pBuffer;
+	pPacket->size = Size;
+}
+
+void CNetBase::BeginBatch()
+{
+	ms_BatchDepth++;
+}
+
+void CNetBase::EndBatch()
+{
+	dbg_assert(ms_BatchDepth > 0, "net batch not started");
+	if(--ms_BatchDepth == 0)
+		FlushBatch();
+}
+
+void CNetBase::FlushBatch()
+{
+	if(ms_NumBatchPackets)
+		net_udp_send_batch(ms_BatchSocket, ms_aBatchPackets, ms_NumBatchPackets);
+	ms_NumBatchPackets = 0;
+}
+
 // TODO: rename this function
 int CNetBase::UnpackPacket(unsigned char *pBuffer, int Size, CNetPacketConstruct *pPacket)
 {
@@ -291,6 +341,11 @@ int CNetBase::IsSeqInBackroom(int Seq, int Ack)
 IOHANDLE CNetBase::ms_DataLogSent = 0;
 IOHANDLE CNetBase::ms_DataLogRecv = 0;
 CHuffman CNetBase::ms_Huffman;
+NETSOCKET CNetBase::ms_BatchSocket;
+NETUDPPACKET CNetBase::ms_aBatchPackets[NET_BATCH_SIZE];
+unsigned char CNetBase::ms_aaBatchData[NET_BATCH_SIZE][NET_MAX_PACKETSIZE];
+int CNetBase::ms_NumBatchPackets = 0;
+int CNetBase::ms_BatchDepth = 0;
 
 
 void CNetBase::OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv)
@@ -51,6 +51,7 @@ enum
 	NET_MAX_CHUNKHEADERSIZE = 5,
 	NET_PACKETHEADERSIZE = 3,
 	NET_MAX_CLIENTS = 16,
+	NET_BATCH_SIZE = 32, // packets per send or recive system call
 	NET_MAX_CONSOLE_CLIENTS = 4,
 	NET_MAX_SEQUENCE = 1<<10,
 	NET_SEQUENCE_MASK = NET_MAX_SEQUENCE-1,
@@ -114,6 +115,7 @@ public:
 	unsigned char *m_pData;
 
 	int m_Sequence;
+	int m_NumResends;
 	int64 m_LastSendTime;
 	int64 m_FirstSendTime;
 };
@@ -151,6 +153,10 @@ private:
 	int64 m_LastRecvTime;
 	int64 m_LastSendTime;
 
+	// smoothed round trip time and its variation, measured from acks of chunks that weren't resent
+	int64 m_Rtt;
+	int64 m_RttVar;
+
 	char m_ErrorString[256];
 
 	CNetPacketConstruct m_Construct;
@@ -168,7 +174,9 @@ private:
 	int QueueChunkEx(int Flags, int DataSize, const void *pData, int Sequence);
 	void SendControl(int ControlMsg, const void *pExtra, int ExtraSize);
 	void ResendChunk(CNetChunkResend *pResend);
-	void Resend();
+	void Resend(int64 MinAge);
+	void UpdateRtt(int64 Sample);
+	int64 ResendTimeout(const CNetChunkResend *pResend) const;
 
 public:
 	void Init(NETSOCKET Socket, bool BlockCloseMsg);
@@ -207,21 +215,30 @@ private:
 	char m_aBuffer[NET_MAX_PACKETSIZE];
 	int m_BufferOffset;
 
+	// lines wait here until Update sends them, so printing never blocks on the socket
+	char m_aSendBuffer[NET_MAX_PACKETSIZE*8];
+	int m_SendBufferSize;
+	int m_NumDroppedLines;
+
 	char m_aErrorString[256];
 
 	bool m_LineEndingDetected;
 	char m_aLineEnding[3];
 
+	int QueueLine(const char *pLine);
+
 public:
 	void Init(NETSOCKET Socket, const NETADDR *pAddr);
 	void Disconnect(const char *pReason);
 
 	int State() const { return m_State; }
 	const NETADDR *PeerAddress() const { return &m_PeerAddr; }
+	const NETSOCKET *Socket() const { return &m_Socket; }
 	const char *ErrorString() const { return m_aErrorString; }
 
 	void Reset();
 	int Update();
+	int Flush();
 	int Send(const char *pLine);
 	int Recv(char *pLine, int MaxLength);
 };
@@ -265,6 +282,12 @@ class CNetServer
 
 	CNetRecvUnpacker m_RecvUnpacker;
 
+	// packets are read from the socket in batches
+	NETUDPPACKET m_aRecvPackets[NET_BATCH_SIZE];
+	unsigned char m_aaRecvData[NET_BATCH_SIZE][NET_MAX_PACKETSIZE];
+	int m_NumRecvPackets;
+	int m_CurrentRecvPacket;
+
 public:
 	int SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
 
@@ -301,6 +324,7 @@ class CNetConsole
 	NETSOCKET m_Socket;
 	class CNetBan *m_pNetBan;
 	CSlot m_aSlots[NET_MAX_CONSOLE_CLIENTS];
+	EVENTLOOP *m_pEventLoop;
 
 	NETFUNC_NEWCLIENT m_pfnNewClient;
 	NETFUNC_DELCLIENT m_pfnDelClient;
@@ -312,13 +336,14 @@ public:
 	void SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
 
 	//
-	bool Open(NETADDR BindAddr, class CNetBan *pNetBan, int Flags);
+	bool Open(NETADDR BindAddr, class CNetBan *pNetBan, int Flags, EVENTLOOP *pEventLoop = 0);
 	int Close();
 
 	//
 	int Recv(char *pLine, int MaxLength, int *pClientID = 0);
 	int Send(int ClientID, const char *pLine);
 	int Update();
+	int Flush();
 
 	//
 	int AcceptClient(NETSOCKET Socket, const NETADDR *pAddr);
@@ -372,6 +397,16 @@ class CNetBase
 	static IOHANDLE ms_DataLogSent;
 	static IOHANDLE ms_DataLogRecv;
 	static CHuffman ms_Huffman;
+
+	// packets queued between BeginBatch and EndBatch, they all go out over one socket
+	static NETSOCKET ms_BatchSocket;
+	static NETUDPPACKET ms_aBatchPackets[NET_BATCH_SIZE];
+	static unsigned char ms_aaBatchData[NET_BATCH_SIZE][NET_MAX_PACKETSIZE];
+	static int ms_NumBatchPackets;
+	static int ms_BatchDepth;
+
+	static unsigned char *SendBuffer(NETSOCKET Socket, unsigned char *pDefault);
+	static void SendBuffered(NETSOCKET Socket, NETADDR *pAddr, unsigned char *pBuffer, int Size);
 public:
 	static void OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv);
 	static void CloseLog();
@@ -382,6 +417,11 @@ public:
 	static void SendControlMsg(NETSOCKET Socket, NETADDR *pAddr, int Ack, int ControlMsg, const void *pExtra, int ExtraSize);
 	static void SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize);
 	static void SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct *pPacket);
+
+	// packets sent in between are queued and sent with as few system calls as possible, can be nested
+	static void BeginBatch();
+	static void EndBatch();
+	static void FlushBatch();
 	static int UnpackPacket(unsigned char *pBuffer, int Size, CNetPacketConstruct *pPacket);
 
 	// The backroom is ack-NET_MAX_SEQUENCE/2. Used for knowing if we acked a packet or not
@@ -1,5 +1,6 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 #include "config.h"
 #include "network.h"
@@ -20,6 +21,8 @@ void CNetConnection::Reset()
 	m_LastSendTime = 0;
 	m_LastRecvTime = 0;
 	m_LastUpdateTime = 0;
+	m_Rtt = 0;
+	m_RttVar = 0;
 	m_Token = -1;
 	mem_zero(&m_PeerAddr, sizeof(m_PeerAddr));
 
@@ -50,6 +53,7 @@ void CNetConnection::Init(NETSOCKET Socket, bool BlockCloseMsg)
 
 void CNetConnection::AckChunks(int Ack)
 {
+	int64 Now = time_get();
 	while(1)
 	{
 		CNetChunkResend *pResend = m_Buffer.First();
@@ -57,12 +61,45 @@ void CNetConnection::AckChunks(int Ack)
 			break;
 
 		if(CNetBase::IsSeqInBackroom(pResend->m_Sequence, Ack))
+		{
+			// the ack of a resent chunk could belong to any of the sends
+			if(!pResend->m_NumResends)
+				UpdateRtt(Now-pResend->m_FirstSendTime);
 			m_Buffer.PopFirst();
+		}
 		else
 			break;
 	}
 }
 
+void CNetConnection::UpdateRtt(int64 Sample)
+{
+	// like tcp (rfc 6298)
+	if(!m_Rtt)
+	{
+		m_Rtt = max(Sample, (int64)1);
+		m_RttVar = Sample/2;
+	}
+	else
+	{
+		int64 Diff = Sample > m_Rtt ? Sample-m_Rtt : m_Rtt-Sample;
+		m_RttVar += (Diff-m_RttVar)/4;
+		m_Rtt = max(m_Rtt + (Sample-m_Rtt)/8, (int64)1);
+	}
+}
+
+int64 CNetConnection::ResendTimeout(const CNetChunkResend *pResend) const
+{
+	// resend after 1 second until the round trip time is known
+	int64 Max = time_freq();
+	if(!m_Rtt)
+		return Max;
+
+	// at least 100ms, acks are only sent along with other packets. back off for every resend of the chunk
+	int64 Timeout = clamp(m_Rtt + 4*m_RttVar, time_freq()/10, Max);
+	return min(Timeout<<min(pResend->m_NumResends, 4), Max);
+}
+
 void CNetConnection::SignalResend()
 {
 	m_Construct.m_Flags |= NET_PACKETFLAG_RESEND;
@@ -119,6 +156,7 @@ int CNetConnection::QueueChunkEx(int Flags, int DataSize, const void *pData, int
 			pResend->m_Sequence = Sequence;
 			pResend->m_Flags = Flags;
 			pResend->m_DataSize = DataSize;
+			pResend->m_NumResends = 0;
 			pResend->m_pData = (unsigned char *)(pResend+1);
 			pResend->m_FirstSendTime = time_get();
 			pResend->m_LastSendTime = pResend->m_FirstSendTime;
@@ -153,12 +191,18 @@ void CNetConnection::ResendChunk(CNetChunkResend *pResend)
 {
 	QueueChunkEx(pResend->m_Flags|NET_CHUNKFLAG_RESEND, pResend->m_DataSize, pResend->m_pData, pResend->m_Sequence);
 	pResend->m_LastSendTime = time_get();
+	pResend->m_NumResends++;
 }
 
-void CNetConnection::Resend()
+void CNetConnection::Resend(int64 MinAge)
 {
+	// only resend the chunks that had the time to get acked
+	int64 Now = time_get();
 	for(CNetChunkResend *pResend = m_Buffer.First(); pResend; pResend = m_Buffer.Next(pResend))
-		ResendChunk(pResend);
+	{
+		if(Now-pResend->m_LastSendTime >= MinAge)
+			ResendChunk(pResend);
+	}
 }
 
 int CNetConnection::Connect(NETADDR *pAddr)
@@ -216,9 +260,9 @@ int CNetConnection::Feed(CNetPacketConstruct *pPacket, NETADDR *pAddr)
 
 	int64 Now = time_get();
 
-	// check if resend is requested
+	// check if resend is requested, chunks sent less than a round trip ago might still be on the way
 	if(pPacket->m_Flags&NET_PACKETFLAG_RESEND)
-		Resend();
+		Resend(m_Rtt);
 
 	//
 	if(pPacket->m_Flags&NET_PACKETFLAG_CONTROL)
@@ -336,9 +380,12 @@ int CNetConnection::Update()
 		}
 		else
 		{
-			// resend packet if we havn't got it acked in 1 second
-			if(Now-pResend->m_LastSendTime > time_freq())
-				ResendChunk(pResend);
+			// resend the chunks that weren't acked in time
+			for(; pResend; pResend = m_Buffer.Next(pResend))
+			{
+				if(Now-pResend->m_LastSendTime > ResendTimeout(pResend))
+					ResendChunk(pResend);
+			}
 		}
 	}
 
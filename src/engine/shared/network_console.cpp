@@ -8,7 +8,7 @@
 #include "network.h"
 
 
-bool CNetConsole::Open(NETADDR BindAddr, CNetBan *pNetBan, int Flags)
+bool CNetConsole::Open(NETADDR BindAddr, CNetBan *pNetBan, int Flags, EVENTLOOP *pEventLoop)
 {
 	// zero out the whole structure
 	mem_zero(this, sizeof(*this));
@@ -25,6 +25,11 @@ bool CNetConsole::Open(NETADDR BindAddr, CNetBan *pNetBan, int Flags)
 		return false;
 	net_set_non_blocking(m_Socket);
 
+	// wake the owner up on new connections and incoming lines
+	m_pEventLoop = pEventLoop;
+	if(m_pEventLoop)
+		eventloop_add_socket(m_pEventLoop, m_Socket);
+
 	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
 		m_aSlots[i].m_Connection.Reset();
 
@@ -41,8 +46,14 @@ void CNetConsole::SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT
 int CNetConsole::Close()
 {
 	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
+	{
+		if(m_pEventLoop)
+			eventloop_remove_socket(m_pEventLoop, *m_aSlots[i].m_Connection.Socket());
 		m_aSlots[i].m_Connection.Disconnect("closing console");
+	}
 
+	if(m_pEventLoop)
+		eventloop_remove_socket(m_pEventLoop, m_Socket);
 	net_tcp_close(m_Socket);
 
 	return 0;
@@ -53,6 +64,8 @@ int CNetConsole::Drop(int ClientID, const char *pReason)
 	if(m_pfnDelClient)
 		m_pfnDelClient(ClientID, pReason, m_UserPtr);
 
+	if(m_pEventLoop)
+		eventloop_remove_socket(m_pEventLoop, *m_aSlots[ClientID].m_Connection.Socket());
 	m_aSlots[ClientID].m_Connection.Disconnect(pReason);
 
 	return 0;
@@ -82,6 +95,8 @@ int CNetConsole::AcceptClient(NETSOCKET Socket, const NETADDR *pAddr)
 	if(!aError[0] && FreeSlot != -1)
 	{
 		m_aSlots[FreeSlot].m_Connection.Init(Socket, pAddr);
+		if(m_pEventLoop)
+			eventloop_add_socket(m_pEventLoop, Socket);
 		if(m_pfnNewClient)
 			m_pfnNewClient(FreeSlot, m_UserPtr);
 		return 0;
@@ -127,6 +142,19 @@ int CNetConsole::Update()
 	return 0;
 }
 
+int CNetConsole::Flush()
+{
+	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
+	{
+		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ONLINE)
+			m_aSlots[i].m_Connection.Flush();
+		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR)
+			Drop(i, m_aSlots[i].m_Connection.ErrorString());
+	}
+
+	return 0;
+}
+
 int CNetConsole::Recv(char *pLine, int MaxLength, int *pClientID)
 {
 	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
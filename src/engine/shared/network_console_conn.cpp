@@ -14,6 +14,8 @@ void CConsoleNetConnection::Reset()
 	m_Socket.ipv6sock = -1;
 	m_aBuffer[0] = 0;
 	m_BufferOffset = 0;
+	m_SendBufferSize = 0;
+	m_NumDroppedLines = 0;
 
 	m_LineEndingDetected = false;
 	#if defined(CONF_FAMILY_WINDOWS)
@@ -45,6 +47,7 @@ void CConsoleNetConnection::Disconnect(const char *pReason)
 
 	if(pReason && pReason[0])
 		Send(pReason);
+	Flush();
 
 	net_tcp_close(m_Socket);
 
@@ -53,6 +56,9 @@ void CConsoleNetConnection::Disconnect(const char *pReason)
 
 int CConsoleNetConnection::Update()
 {
+	if(State() == NET_CONNSTATE_ONLINE && Flush() != 0)
+		return -1;
+
 	if(State() == NET_CONNSTATE_ONLINE)
 	{
 		if((int)(sizeof(m_aBuffer)) <= m_BufferOffset)
@@ -151,11 +157,8 @@ int CConsoleNetConnection::Recv(char *pLine, int MaxLength)
 	return 0;
 }
 
-int CConsoleNetConnection::Send(const char *pLine)
+int CConsoleNetConnection::QueueLine(const char *pLine)
 {
-	if(State() != NET_CONNSTATE_ONLINE)
-		return -1;
-
 	char aBuf[1024];
 	str_copy(aBuf, pLine, (int)(sizeof(aBuf))-2);
 	int Length = str_length(aBuf);
@@ -163,24 +166,53 @@ int CConsoleNetConnection::Send(const char *pLine)
 	aBuf[Length+1] = m_aLineEnding[1];
 	aBuf[Length+2] = m_aLineEnding[2];
 	Length += 3;
-	const char *pData = aBuf;
 
-	while(true)
+	if(m_SendBufferSize+Length > (int)sizeof(m_aSendBuffer))
 	{
-		int Send = net_tcp_send(m_Socket, pData, Length);
+		m_NumDroppedLines++;
+		return -1;
+	}
+
+	mem_copy(m_aSendBuffer+m_SendBufferSize, aBuf, Length);
+	m_SendBufferSize += Length;
+	return 0;
+}
+
+int CConsoleNetConnection::Flush()
+{
+	while(m_SendBufferSize)
+	{
+		int Send = net_tcp_send(m_Socket, m_aSendBuffer, m_SendBufferSize);
 		if(Send < 0)
 		{
+			if(net_would_block()) // try again with the next update
+				return 0;
+
 			m_State = NET_CONNSTATE_ERROR;
 			str_copy(m_aErrorString, "failed to send packet", sizeof(m_aErrorString));
 			return -1;
 		}
 
-		if(Send >= Length)
-			break;
+		mem_move(m_aSendBuffer, m_aSendBuffer+Send, m_SendBufferSize-Send);
+		m_SendBufferSize -= Send;
 
-		pData += Send;
-		Length -= Send;
+		// tell the peer about lines that didn't fit as soon as there is room again
+		if(m_SendBufferSize == 0 && m_NumDroppedLines)
+		{
+			char aBuf[64];
+			str_format(aBuf, sizeof(aBuf), "[econ]: dropped %d lines", m_NumDroppedLines);
+			m_NumDroppedLines = 0;
+			QueueLine(aBuf);
+		}
 	}
 
 	return 0;
 }
+
+int CConsoleNetConnection::Send(const char *pLine)
+{
+	if(State() != NET_CONNSTATE_ONLINE)
+		return -1;
+
+	return QueueLine(pLine);
+}
@@ -32,6 +32,11 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 	for(int i = 0; i < NET_MAX_CLIENTS; i++)
 		m_aSlots[i].m_Connection.Init(m_Socket, true);
 
+	for(int i = 0; i < NET_BATCH_SIZE; i++)
+		m_aRecvPackets[i].data = m_aaRecvData[i];
+	m_NumRecvPackets = 0;
+	m_CurrentRecvPacket = 0;
+
 	return true;
 }
 
@@ -101,14 +106,24 @@ int CNetServer::Recv(CNetChunk *pChunk)
 		if(m_RecvUnpacker.FetchChunk(pChunk))
 			return 1;
 
-		// TODO: empty the recvinfo
-		int Bytes = net_udp_recv(m_Socket, &Addr, m_RecvUnpacker.m_aBuffer, NET_MAX_PACKETSIZE);
+		// read the next batch once all packets of the last one are handled
+		if(m_CurrentRecvPacket == m_NumRecvPackets)
+		{
+			m_CurrentRecvPacket = 0;
+			m_NumRecvPackets = net_udp_recv_batch(m_Socket, m_aRecvPackets, NET_BATCH_SIZE, NET_MAX_PACKETSIZE);
+
+			// no more packets for now
+			if(m_NumRecvPackets <= 0)
+			{
+				m_NumRecvPackets = 0;
+				break;
+			}
+		}
 
-		// no more packets for now
-		if(Bytes <= 0)
-			break;
+		NETUDPPACKET *pPacket = &m_aRecvPackets[m_CurrentRecvPacket++];
+		Addr = pPacket->addr;
 
-		if(CNetBase::UnpackPacket(m_RecvUnpacker.m_aBuffer, Bytes, &m_RecvUnpacker.m_Data) == 0)
+		if(CNetBase::UnpackPacket((unsigned char *)pPacket->data, pPacket->size, &m_RecvUnpacker.m_Data) == 0)
 		{
 			// check if we just should drop the packet
 			char aBuf[128];
@@ -0,0 +1,106 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include "profiler.h"
+
+CTickProfiler::CTickProfiler()
+{
+	m_NumPhases = 0;
+	Reset();
+}
+
+void CTickProfiler::Init(const char * const *ppNames, int NumPhases)
+{
+	m_NumPhases = min(NumPhases, (int)MAX_PHASES);
+	for(int i = 0; i < m_NumPhases; i++)
+		m_aPhases[i].m_pName = ppNames[i];
+	Reset();
+}
+
+void CTickProfiler::Reset()
+{
+	for(int i = 0; i < MAX_PHASES; i++)
+	{
+		m_aPhases[i].m_Current = 0;
+		mem_zero(m_aPhases[i].m_aHistory, sizeof(m_aPhases[i].m_aHistory));
+		mem_zero(m_aPhases[i].m_aBuckets, sizeof(m_aPhases[i].m_aBuckets));
+		m_aPhases[i].m_Sum = 0;
+	}
+	m_NumTicks = 0;
+	m_HistoryPos = 0;
+}
+
+int CTickProfiler::Bucket(int Time)
+{
+	if(Time < NUM_LINEAR_BUCKETS)
+		return max(Time, 0);
+
+	int Exp = 4;
+	while((Time>>(Exp+1)) != 0)
+		Exp++;
+	return min(NUM_LINEAR_BUCKETS + (Exp-4)*4 + ((Time>>(Exp-2))&3), (int)NUM_BUCKETS-1);
+}
+
+int CTickProfiler::BucketLimit(int Bucket)
+{
+	// largest duration that falls into the bucket
+	if(Bucket < NUM_LINEAR_BUCKETS)
+		return Bucket;
+
+	int Exp = 4 + (Bucket-NUM_LINEAR_BUCKETS)/4;
+	int Sub = (Bucket-NUM_LINEAR_BUCKETS)%4;
+	return ((5+Sub)<<(Exp-2))-1;
+}
+
+void CTickProfiler::NextTick()
+{
+	int64 Freq = time_freq();
+	for(int i = 0; i < m_NumPhases; i++)
+	{
+		CPhase *pPhase = &m_aPhases[i];
+		int Time = (int)min(pPhase->m_Current*1000000/Freq, (int64)0x7fffffff);
+		pPhase->m_Current = 0;
+
+		// replace the oldest tick of the window
+		if(m_NumTicks == HISTORY_SIZE)
+		{
+			int Old = pPhase->m_aHistory[m_HistoryPos];
+			pPhase->m_aBuckets[Bucket(Old)]--;
+			pPhase->m_Sum -= Old;
+		}
+		pPhase->m_aHistory[m_HistoryPos] = Time;
+		pPhase->m_aBuckets[Bucket(Time)]++;
+		pPhase->m_Sum += Time;
+	}
+
+	m_HistoryPos = (m_HistoryPos+1)%HISTORY_SIZE;
+	if(m_NumTicks < HISTORY_SIZE)
+		m_NumTicks++;
+}
+
+void CTickProfiler::GetStats(int Phase, CStats *pStats) const
+{
+	const CPhase *pPhase = &m_aPhases[Phase];
+	mem_zero(pStats, sizeof(*pStats));
+	pStats->m_NumTicks = m_NumTicks;
+	if(!m_NumTicks)
+		return;
+
+	pStats->m_Avg = (int)(pPhase->m_Sum/m_NumTicks);
+	for(int i = 0; i < m_NumTicks; i++)
+		pStats->m_Max = max(pStats->m_Max, pPhase->m_aHistory[i]);
+
+	// walk the histogram for the percentiles, the bucket limits are upper bounds
+	int *apPercentiles[] = { &pStats->m_P50, &pStats->m_P90, &pStats->m_P99 };
+	int aWanted[] = { (m_NumTicks*50+99)/100, (m_NumTicks*90+99)/100, (m_NumTicks*99+99)/100 };
+	int Count = 0;
+	int Next = 0;
+	for(int b = 0; b < NUM_BUCKETS && Next < 3; b++)
+	{
+		Count += pPhase->m_aBuckets[b];
+		while(Next < 3 && Count >= aWanted[Next])
+			*apPercentiles[Next++] = min(BucketLimit(b), pStats->m_Max);
+	}
+}
@@ -0,0 +1,96 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_PROFILER_H
+#define ENGINE_SHARED_PROFILER_H
+
+#include <base/system.h>
+
+/*
+	Class: Tick Profiler
+		Sums up the time spent in a set of phases during one tick and keeps
+		the per tick durations of the last HISTORY_SIZE ticks. Every phase
+		has a histogram over that window, so percentiles can be read
+		without sorting.
+*/
+class CTickProfiler
+{
+public:
+	enum
+	{
+		MAX_PHASES=16,
+		HISTORY_SIZE=50*30, // 30 seconds worth of server ticks
+
+		// durations are in microseconds, exact up to 16 and with 4 buckets per power of two above
+		NUM_LINEAR_BUCKETS=16,
+		NUM_BUCKETS=NUM_LINEAR_BUCKETS+24*4,
+	};
+
+	class CStats
+	{
+	public:
+		int m_NumTicks;
+		int m_Avg;
+		int m_P50;
+		int m_P90;
+		int m_P99;
+		int m_Max;
+	};
+
+private:
+	class CPhase
+	{
+	public:
+		const char *m_pName;
+		int64 m_Current;
+		int m_aHistory[HISTORY_SIZE];
+		int m_aBuckets[NUM_BUCKETS];
+		int64 m_Sum;
+	};
+
+	CPhase m_aPhases[MAX_PHASES];
+	int m_NumPhases;
+	int m_NumTicks;
+	int m_HistoryPos;
+
+	static int Bucket(int Time);
+	static int BucketLimit(int Bucket);
+
+public:
+	CTickProfiler();
+
+	void Init(const char * const *ppNames, int NumPhases);
+	void Reset();
+
+	// adds time_get() units to the current tick of a phase
+	void Add(int Phase, int64 Time) { m_aPhases[Phase].m_Current += Time; }
+
+	// closes the current tick and starts the next one
+	void NextTick();
+
+	int NumPhases() const { return m_NumPhases; }
+	const char *PhaseName(int Phase) const { return m_aPhases[Phase].m_pName; }
+	void GetStats(int Phase, CStats *pStats) const;
+};
+
+// adds the time until it goes out of scope to a phase
+class CProfileScope
+{
+	CTickProfiler *m_pProfiler;
+	int m_Phase;
+	int64 m_Start;
+
+public:
+	CProfileScope(CTickProfiler *pProfiler, int Phase)
+	{
+		m_pProfiler = pProfiler;
+		m_Phase = Phase;
+		m_Start = time_get();
+	}
+
+	~CProfileScope()
+	{
+		m_pProfiler->Add(m_Phase, time_get()-m_Start);
+	}
+};
+
+#endif
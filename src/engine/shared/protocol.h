@@ -57,7 +57,7 @@ enum
 	NETMSG_INPUT,			// contains the inputdata from the client
 	NETMSG_RCON_CMD,		//
 	NETMSG_RCON_AUTH,		//
-	NETMSG_REQUEST_MAP_DATA,//
+	NETMSG_REQUEST_MAP_DATA,// chunk to send next, optionally followed by how many chunks may be sent ahead
 
 	NETMSG_AUTH_START,		//
 	NETMSG_AUTH_RESPONSE,	//
@@ -86,6 +86,10 @@ enum
 	MAX_NAME_LENGTH=16,
 	MAX_CLAN_LENGTH=12,
 
+	// map download
+	MAP_CHUNK_SIZE=1024-128,
+	MAP_DOWNLOAD_WINDOW=16,
+
 	// message packing
 	MSGFLAG_VITAL=1,
 	MSGFLAG_FLUSH=2,
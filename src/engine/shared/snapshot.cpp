@@ -3,6 +3,10 @@
 #include "snapshot.h"
 #include "compression.h"
 
+#if defined(CONF_ARCH_SSE2)
+#include <emmintrin.h>
+#endif
+
 // CSnapshot
 
 CSnapshotItem *CSnapshot::GetItem(int Index)
@@ -19,7 +23,7 @@ int CSnapshot::GetItemSize(int Index)
 
 int CSnapshot::GetItemIndex(int Key)
 {
-	// TODO: OPT: this should not be a linear search. very bad
+	// linear search, stored snapshots can carry a CSnapshotIndex for faster lookups
 	for(int i = 0; i < m_NumItems; i++)
 	{
 		if(GetItem(i)->Key() == Key)
@@ -57,53 +61,112 @@ void CSnapshot::DebugDump()
 }
 
 
-// CSnapshotDelta
+// CSnapshotIndex
 
-struct CItemList
+static inline unsigned SlotHash(int Key)
 {
-	int m_Num;
-	int m_aKeys[64];
-	int m_aIndex[64];
-};
+	return (unsigned)Key*2654435761u;
+}
 
-enum
+int CSnapshotIndex::TotalSize(int NumItems)
 {
-	HASHLIST_SIZE = 256,
-};
+	int NumSlots = 1;
+	while(NumSlots < NumItems*2)
+		NumSlots <<= 1;
+	return sizeof(CSnapshotIndex)+NumSlots*sizeof(CSlot);
+}
 
-static void GenerateHash(CItemList *pHashlist, CSnapshot *pSnapshot)
+void CSnapshotIndex::Build(CSnapshot *pSnapshot)
 {
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
+	// open addressing with linear probing, kept at most half full
+	m_NumSlots = (TotalSize(pSnapshot->NumItems())-sizeof(CSnapshotIndex))/sizeof(CSlot);
+	CSlot *pSlots = Slots();
+	for(int i = 0; i < m_NumSlots; i++)
+		pSlots[i].m_Index = -1;
 
 	for(int i = 0; i < pSnapshot->NumItems(); i++)
 	{
 		int Key = pSnapshot->GetItem(i)->Key();
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		if(pHashlist[HashID].m_Num != 64)
+		unsigned Slot = SlotHash(Key)&(m_NumSlots-1);
+		while(pSlots[Slot].m_Index != -1)
+		{
+			if(pSlots[Slot].m_Key == Key)
+				break;
+			Slot = (Slot+1)&(m_NumSlots-1);
+		}
+
+		// keep the first item on duplicate keys, like the linear search does
+		if(pSlots[Slot].m_Index == -1)
 		{
-			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
-			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
-			pHashlist[HashID].m_Num++;
+			pSlots[Slot].m_Key = Key;
+			pSlots[Slot].m_Index = i;
 		}
 	}
 }
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
+int CSnapshotIndex::GetItemIndex(int Key) const
 {
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		for(int i = 0; i < pHashlist[HashID].m_Num; i++)
-		{
-			if(pHashlist[HashID].m_aKeys[i] == Key)
-				return pHashlist[HashID].m_aIndex[i];
+	const CSlot *pSlots = Slots();
+	unsigned Slot = SlotHash(Key)&(m_NumSlots-1);
+	while(pSlots[Slot].m_Index != -1)
+	{
+		if(pSlots[Slot].m_Key == Key)
+			return pSlots[Slot].m_Index;
+		Slot = (Slot+1)&(m_NumSlots-1);
 	}
-
 	return -1;
 }
 
-static int DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
+// CSnapshotDelta
+
+#if defined(CONF_ARCH_SSE2)
+static inline int HorizontalOr(__m128i Value)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi32(Value, _mm_setzero_si128())) != 0xffff;
+}
+
+static inline int HorizontalAdd(__m128i Value)
+{
+	Value = _mm_add_epi32(Value, _mm_shuffle_epi32(Value, _MM_SHUFFLE(1, 0, 3, 2)));
+	Value = _mm_add_epi32(Value, _mm_shuffle_epi32(Value, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(Value);
+}
+#endif
+
+// number of bits CVariableInt::Pack needs for the value, 1 for zero as the data rate counts it
+static inline int PackedBits(int Value)
+{
+	if(Value == 0)
+		return 1;
+
+	int Bytes = 1;
+	Value = (Value^(Value>>31))>>6;
+	while(Value)
+	{
+		Bytes++;
+		Value >>= 7;
+	}
+	return Bytes*8;
+}
+
+static int DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
 {
 	int Needed = 0;
+
+#if defined(CONF_ARCH_SSE2)
+	__m128i NeededVec = _mm_setzero_si128();
+	for(; Size >= 4; Size -= 4)
+	{
+		__m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)pCurrent), _mm_loadu_si128((const __m128i *)pPast));
+		_mm_storeu_si128((__m128i *)pOut, Diff);
+		NeededVec = _mm_or_si128(NeededVec, Diff);
+		pOut += 4;
+		pPast += 4;
+		pCurrent += 4;
+	}
+	Needed = HorizontalOr(NeededVec);
+#endif
+
 	while(Size)
 	{
 		*pOut = *pCurrent-*pPast;
@@ -119,24 +182,46 @@ static int DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
 
 void CSnapshotDelta::UndiffItem(int *pPast, int *pDiff, int *pOut, int Size)
 {
+	int Rate = 0;
+
+#if defined(CONF_ARCH_SSE2)
+	// the data rate is the packed size of every diff, see PackedBits
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128i One = _mm_set1_epi32(1);
+	__m128i RateVec = Zero;
+	for(; Size >= 4; Size -= 4)
+	{
+		__m128i Diff = _mm_loadu_si128((const __m128i *)pDiff);
+		_mm_storeu_si128((__m128i *)pOut, _mm_add_epi32(_mm_loadu_si128((const __m128i *)pPast), Diff));
+
+		__m128i Value = _mm_xor_si128(Diff, _mm_srai_epi32(Diff, 31));
+		__m128i Bytes = _mm_sub_epi32(One, _mm_cmpgt_epi32(Value, _mm_set1_epi32(0x3f)));
+		Bytes = _mm_sub_epi32(Bytes, _mm_cmpgt_epi32(Value, _mm_set1_epi32(0x1fff)));
+		Bytes = _mm_sub_epi32(Bytes, _mm_cmpgt_epi32(Value, _mm_set1_epi32(0xfffff)));
+		Bytes = _mm_sub_epi32(Bytes, _mm_cmpgt_epi32(Value, _mm_set1_epi32(0x7ffffff)));
+		__m128i IsZero = _mm_cmpeq_epi32(Diff, Zero);
+		__m128i Bits = _mm_or_si128(_mm_andnot_si128(IsZero, _mm_slli_epi32(Bytes, 3)), _mm_and_si128(IsZero, One));
+		RateVec = _mm_add_epi32(RateVec, Bits);
+
+		pOut += 4;
+		pPast += 4;
+		pDiff += 4;
+	}
+	Rate = HorizontalAdd(RateVec);
+#endif
+
 	while(Size)
 	{
 		*pOut = *pPast+*pDiff;
-
-		if(*pDiff == 0)
-			m_aSnapshotDataRate[m_SnapshotCurrent] += 1;
-		else
-		{
-			unsigned char aBuf[16];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff);
-			m_aSnapshotDataRate[m_SnapshotCurrent] += (int)(pEnd - (unsigned char*)aBuf) * 8;
-		}
+		Rate += PackedBits(*pDiff);
 
 		pOut++;
 		pPast++;
 		pDiff++;
 		Size--;
 	}
+
+	m_aSnapshotDataRate[m_SnapshotCurrent] += Rate;
 }
 
 CSnapshotDelta::CSnapshotDelta()
@@ -158,7 +243,6 @@ CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta()
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
 int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
 {
 	CData *pDelta = (CData *)pDstData;
@@ -167,21 +251,37 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	CSnapshotItem *pFromItem;
 	CSnapshotItem *pCurItem;
 	CSnapshotItem *pPastItem;
-	int Count = 0;
-	int SizeCount = 0;
 
 	pDelta->m_NumDeletedItems = 0;
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList Hashlist[HASHLIST_SIZE];
-	GenerateHash(Hashlist, pTo);
+	// index the past snapshot, keys map to their first item like in CSnapshot::GetItemIndex
+	int aPastIndexData[CSnapshotIndex::MAX_SIZE/sizeof(int)];
+	CSnapshotIndex *pPastIndex = (CSnapshotIndex *)aPastIndexData;
+	pPastIndex->Build(pFrom);
+
+	// fetch previous indices and mark the past items that are still there
+	// we do this as a separate pass because it helps the cache
+	int aPastIndecies[1024];
+	char aPastKept[CSnapshotIndex::MAX_SLOTS/2];
+	mem_zero(aPastKept, pFrom->NumItems());
+
+	const int NumItems = pTo->NumItems();
+	for(i = 0; i < NumItems; i++)
+	{
+		pCurItem = pTo->GetItem(i);
+		aPastIndecies[i] = pPastIndex->GetItemIndex(pCurItem->Key());
+		if(aPastIndecies[i] != -1)
+			aPastKept[aPastIndecies[i]] = 1;
+	}
 
 	// pack deleted stuff
 	for(i = 0; i < pFrom->NumItems(); i++)
 	{
+		// items with the same key share the mark of the first one
 		pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), Hashlist) == -1)
+		if(!aPastKept[i] && !aPastKept[pPastIndex->GetItemIndex(pFromItem->Key())])
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
@@ -190,23 +290,11 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 		}
 	}
 
-	GenerateHash(Hashlist, pFrom);
-	int aPastIndecies[1024];
-
-	// fetch previous indices
-	// we do this as a separate pass because it helps the cache
-	const int NumItems = pTo->NumItems();
-	for(i = 0; i < NumItems; i++)
-	{
-		pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndecies[i] = GetItemIndexHashed(pCurItem->Key(), Hashlist); // O(n) .. O(n^n)
-	}
-
 	for(i = 0; i < NumItems; i++)
 	{
 		// do delta
-		ItemSize = pTo->GetItemSize(i); // O(1) .. O(n)
-		pCurItem = pTo->GetItem(i); // O(1) .. O(n)
+		ItemSize = pTo->GetItemSize(i);
+		pCurItem = pTo->GetItem(i);
 		PastIndex = aPastIndecies[i];
 
 		if(PastIndex != -1)
@@ -237,32 +325,11 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 				*pData++ = ItemSize/4;
 
 			mem_copy(pData, pCurItem->Data(), ItemSize);
-			SizeCount += ItemSize;
 			pData += ItemSize/4;
 			pDelta->m_NumUpdateItems++;
-			Count++;
 		}
 	}
 
-	if(0)
-	{
-		dbg_msg("snapshot", "%d %d %d",
-			pDelta->m_NumDeletedItems,
-			pDelta->m_NumUpdateItems,
-			pDelta->m_NumTempItems);
-	}
-
-	/*
-	// TODO: pack temp stuff
-
-	// finish
-	//mem_copy(pDelta->offsets, deleted, pDelta->num_deleted_items*sizeof(int));
-	//mem_copy(&(pDelta->offsets[pDelta->num_deleted_items]), update, pDelta->num_update_items*sizeof(int));
-	//mem_copy(&(pDelta->offsets[pDelta->num_deleted_items+pDelta->num_update_items]), temp, pDelta->num_temp_items*sizeof(int));
-	//mem_copy(pDelta->data_start(), data, data_size);
-	//pDelta->data_size = data_size;
-	* */
-
 	if(!pDelta->m_NumDeletedItems && !pDelta->m_NumUpdateItems && !pDelta->m_NumTempItems)
 		return 0;
 
@@ -284,7 +351,7 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 	int *pEnd = (int *)(((char *)pSrcData + DataSize));
 
 	CSnapshotItem *pFromItem;
-	int Keep, ItemSize;
+	int ItemSize;
 	int *pDeleted;
 	int ID, Type, Key;
 	int FromIndex;
@@ -292,31 +359,38 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 	Builder.Init();
 
+	// index the past snapshot, keys map to their first item like in CSnapshot::GetItemIndex
+	int aFromIndexData[CSnapshotIndex::MAX_SIZE/sizeof(int)];
+	CSnapshotIndex *pFromIndex = (CSnapshotIndex *)aFromIndexData;
+	pFromIndex->Build(pFrom);
+
 	// unpack deleted stuff
 	pDeleted = pData;
 	pData += pDelta->m_NumDeletedItems;
 	if(pData > pEnd)
 		return -1;
 
-	// copy all non deleted stuff
+	char aFromDeleted[CSnapshotIndex::MAX_SLOTS/2];
+	mem_zero(aFromDeleted, pFrom->NumItems());
+	for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
+	{
+		FromIndex = pFromIndex->GetItemIndex(pDeleted[d]);
+		if(FromIndex != -1)
+			aFromDeleted[FromIndex] = 1;
+	}
+
+	// copy all non deleted stuff, remember where each item went
+	int aFromBuilderIndex[CSnapshotIndex::MAX_SLOTS/2];
 	for(int i = 0; i < pFrom->NumItems(); i++)
 	{
-		// dbg_assert(0, "fail!");
+		// items with the same key share the mark of the first one
 		pFromItem = pFrom->GetItem(i);
 		ItemSize = pFrom->GetItemSize(i);
-		Keep = 1;
-		for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
-		{
-			if(pDeleted[d] == pFromItem->Key())
-			{
-				Keep = 0;
-				break;
-			}
-		}
-
-		if(Keep)
+		aFromBuilderIndex[i] = -1;
+		if(!aFromDeleted[i] && !aFromDeleted[pFromIndex->GetItemIndex(pFromItem->Key())])
 		{
 			// keep it
+			aFromBuilderIndex[i] = Builder.NumItems();
 			mem_copy(
 				Builder.NewItem(pFromItem->Type(), pFromItem->ID(), ItemSize),
 				pFromItem->Data(), ItemSize);
@@ -346,15 +420,18 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 		if(RangeCheck(pEnd, pData, ItemSize) || ItemSize < 0) return -3;
 
 		Key = (Type<<16)|ID;
+		FromIndex = pFromIndex->GetItemIndex(Key);
 
-		// create the item if needed
-		pNewData = Builder.GetItemData(Key);
+		// create the item if needed, kept items are always found at their copy
+		if(FromIndex != -1 && aFromBuilderIndex[FromIndex] != -1)
+			pNewData = Builder.GetItem(aFromBuilderIndex[FromIndex])->Data();
+		else
+			pNewData = Builder.GetItemData(Key);
 		if(!pNewData)
 			pNewData = (int *)Builder.NewItem(Key>>16, Key&0xffff, ItemSize);
 
 		//if(range_check(pEnd, pNewData, ItemSize)) return -4;
 
-		FromIndex = pFrom->GetItemIndex(Key);
 		if(FromIndex != -1)
 		{
 			// we got an update so we need to apply the diff
@@ -428,13 +505,19 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 	m_pLast = 0;
 }
 
-void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt)
+void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt, int CreateIndex)
 {
 	// allocate memory for holder + snapshot_data
 	int TotalSize = sizeof(CHolder)+DataSize;
+	int IndexSize = 0;
 
 	if(CreateAlt)
 		TotalSize += DataSize;
+	if(CreateIndex)
+	{
+		IndexSize = CSnapshotIndex::TotalSize(((CSnapshot *)pData)->NumItems());
+		TotalSize += IndexSize;
+	}
 
 	CHolder *pHolder = (CHolder *)mem_alloc(TotalSize, 1);
 
@@ -453,6 +536,13 @@ void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, i
 	else
 		pHolder->m_pAltSnap = 0;
 
+	if(CreateIndex) // the index goes last, the snapshots keep their alignment
+	{
+		pHolder->m_pIndex = (CSnapshotIndex *)(((char *)pHolder) + TotalSize - IndexSize);
+		pHolder->m_pIndex->Build(pHolder->m_pSnap);
+	}
+	else
+		pHolder->m_pIndex = 0;
 
 	// link
 	pHolder->m_pNext = 0;
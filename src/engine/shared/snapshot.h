@@ -45,6 +45,33 @@ public:
 	void DebugDump();
 };
 
+// CSnapshotIndex
+
+class CSnapshotIndex
+{
+	class CSlot
+	{
+	public:
+		int m_Key;
+		int m_Index;
+	};
+
+	int m_NumSlots;
+
+	CSlot *Slots() const { return (CSlot *)(this+1); }
+
+public:
+	enum
+	{
+		// every item takes at least 8 bytes, so this covers any snapshot
+		MAX_SLOTS = CSnapshot::MAX_SIZE/4,
+		MAX_SIZE = sizeof(int)+MAX_SLOTS*sizeof(CSlot),
+	};
+
+	static int TotalSize(int NumItems);
+	void Build(CSnapshot *pSnapshot);
+	int GetItemIndex(int Key) const;
+};
 
 // CSnapshotDelta
 
@@ -98,6 +125,9 @@ public:
 		int m_SnapSize;
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+		CSnapshotIndex *m_pIndex;
+
+		int GetItemIndex(int Key) { return m_pIndex ? m_pIndex->GetItemIndex(Key) : m_pSnap->GetItemIndex(Key); }
 	};
 
 
@@ -107,17 +137,19 @@ public:
 	void Init();
 	void PurgeAll();
 	void PurgeUntil(int Tick);
-	void Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt);
+	void Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt, int CreateIndex);
 	int Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData);
 };
 
 class CSnapshotBuilder
 {
+public:
 	enum
 	{
 		MAX_ITEMS = 1024
 	};
 
+private:
 	char m_aData[CSnapshot::MAX_SIZE];
 	int m_DataSize;
 
@@ -128,6 +160,7 @@ public:
 	void Init();
 
 	void *NewItem(int Type, int ID, int Size);
+	int NumItems() const { return m_NumItems; }
 
 	CSnapshotItem *GetItem(int Index);
 	int *GetItemData(int Key);
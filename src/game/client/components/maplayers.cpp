@@ -25,6 +25,8 @@ CMapLayers::CMapLayers(int t)
 	m_CurrentLocalTick = 0;
 	m_LastLocalTick = 0;
 	m_EnvelopeUpdate = false;
+	m_pTilemapBuffers = 0;
+	m_NumTilemapBuffers = 0;
 }
 
 void CMapLayers::OnInit()
@@ -32,6 +34,50 @@ void CMapLayers::OnInit()
 	m_pLayers = Layers();
 }
 
+void CMapLayers::OnMapLoad()
+{
+	// drop the geometry of the previous map
+	for(int i = 0; i < m_NumTilemapBuffers; i++)
+		RenderTools()->RenderTilemapBufferDestroy(&m_pTilemapBuffers[i]);
+	delete [] m_pTilemapBuffers;
+
+	m_NumTilemapBuffers = m_pLayers->NumLayers();
+	m_pTilemapBuffers = new CTilemapBuffer[m_NumTilemapBuffers];
+
+	// the tileset scale only depends on the aspect ratio, take it from the game group
+	CUIRect Screen;
+	Graphics()->GetScreen(&Screen.x, &Screen.y, &Screen.w, &Screen.h);
+	MapScreenToGroup(0, 0, m_pLayers->GameGroup());
+	float TilesetScale = RenderTools()->TilemapTilesetScale(32.0f);
+	Graphics()->MapScreen(Screen.x, Screen.y, Screen.w, Screen.h);
+
+	// upload the tile layers this pass renders
+	bool PassedGameLayer = false;
+	for(int g = 0; g < m_pLayers->NumGroups(); g++)
+	{
+		CMapItemGroup *pGroup = m_pLayers->GetGroup(g);
+		for(int l = 0; l < pGroup->m_NumLayers; l++)
+		{
+			CMapItemLayer *pLayer = m_pLayers->GetLayer(pGroup->m_StartLayer+l);
+			if(pLayer == (CMapItemLayer*)m_pLayers->GameLayer())
+			{
+				PassedGameLayer = true;
+				continue;
+			}
+
+			if((m_Type == TYPE_BACKGROUND && PassedGameLayer) || (m_Type == TYPE_FOREGROUND && !PassedGameLayer))
+				continue;
+
+			if(pLayer->m_Type == LAYERTYPE_TILES)
+			{
+				CMapItemLayerTilemap *pTMap = (CMapItemLayerTilemap *)pLayer;
+				CTile *pTiles = (CTile *)m_pLayers->Map()->GetData(pTMap->m_Data);
+				RenderTools()->RenderTilemapBufferCreate(&m_pTilemapBuffers[pGroup->m_StartLayer+l], pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, TilesetScale);
+			}
+		}
+	}
+}
+
 void CMapLayers::EnvelopeUpdate()
 {
 	if(Client()->State() == IClient::STATE_DEMOPLAYBACK)
@@ -217,11 +263,23 @@ void CMapLayers::OnRender()
 					CTile *pTiles = (CTile *)m_pLayers->Map()->GetData(pTMap->m_Data);
 					Graphics()->BlendNone();
 					vec4 Color = vec4(pTMap->m_Color.r/255.0f, pTMap->m_Color.g/255.0f, pTMap->m_Color.b/255.0f, pTMap->m_Color.a/255.0f);
-					RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
-													EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
-					Graphics()->BlendNormal();
-					RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
-													EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+					if(m_pTilemapBuffers)
+					{
+						CTilemapBuffer *pBuffer = &m_pTilemapBuffers[pGroup->m_StartLayer+l];
+						RenderTools()->RenderTilemapBuffer(pBuffer, pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
+														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+						Graphics()->BlendNormal();
+						RenderTools()->RenderTilemapBuffer(pBuffer, pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
+														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+					}
+					else
+					{
+						RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
+														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+						Graphics()->BlendNormal();
+						RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
+														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+					}
 				}
 				else if(pLayer->m_Type == LAYERTYPE_QUADS)
 				{
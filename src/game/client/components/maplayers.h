@@ -12,6 +12,10 @@ class CMapLayers : public CComponent
 	int m_LastLocalTick;
 	bool m_EnvelopeUpdate;
 
+	// uploaded geometry of the tile layers, indexed like the map layers
+	class CTilemapBuffer *m_pTilemapBuffers;
+	int m_NumTilemapBuffers;
+
 	void MapScreenToGroup(float CenterX, float CenterY, CMapItemGroup *pGroup);
 	static void EnvelopeEval(float TimeOffset, int Env, float *pChannels, void *pUser);
 public:
@@ -24,6 +28,7 @@ public:
 	CMapLayers(int Type);
 	virtual void OnInit();
 	virtual void OnRender();
+	virtual void OnMapLoad();
 
 	void EnvelopeUpdate();
 };
@@ -37,6 +37,40 @@ enum
 	LAYERRENDERFLAG_TRANSPARENT=2,
 
 	TILERENDERFLAG_EXTEND=4,
+	TILERENDERFLAG_OUTSIDE=8, // only the extended border around the map
+};
+
+// tile layer geometry that is uploaded once and drawn in chunks. tiles are stored chunk by chunk
+// so a row of visible chunks is one continuous range in the buffer
+class CTilemapBuffer
+{
+public:
+	enum
+	{
+		CHUNK_SIZE=32,
+
+		BUFFER_OPAQUE=0,
+		BUFFER_TRANSPARENT,
+		NUM_BUFFERS
+	};
+
+	CTilemapBuffer()
+	{
+		for(int i = 0; i < NUM_BUFFERS; i++)
+		{
+			m_aBuffer[i] = -1;
+			m_apChunkStart[i] = 0;
+		}
+		m_ChunksX = 0;
+		m_ChunksY = 0;
+		m_TilesetScale = 0.0f;
+	}
+
+	int m_aBuffer[NUM_BUFFERS];
+	int *m_apChunkStart[NUM_BUFFERS]; // first quad of every chunk, one extra entry at the end
+	int m_ChunksX;
+	int m_ChunksY;
+	float m_TilesetScale; // the uvs are nudged for this scale
 };
 
 typedef void (*ENVELOPE_EVAL)(float TimeOffset, int Env, float *pChannels, void *pUser);
@@ -73,6 +107,10 @@ public:
 	static void RenderEvalEnvelope(CEnvPoint *pPoints, int NumPoints, int Channels, float Time, float *pResult);
 	void RenderQuads(CQuad *pQuads, int NumQuads, int Flags, ENVELOPE_EVAL pfnEval, void *pUser);
 	void RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
+	void RenderTilemapBufferCreate(CTilemapBuffer *pBuffer, CTile *pTiles, int w, int h, float Scale, float TilesetScale);
+	void RenderTilemapBufferDestroy(CTilemapBuffer *pBuffer);
+	void RenderTilemapBuffer(CTilemapBuffer *pBuffer, CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
+	float TilemapTilesetScale(float Scale);
 
 	// helpers
 	void MapscreenToWorld(float CenterX, float CenterY, float ParallaxX, float ParallaxY,
@@ -163,6 +163,74 @@ void CRenderTools::RenderQuads(CQuad *pQuads, int NumQuads, int RenderFlags, ENV
 	Graphics()->QuadsEnd();
 }
 
+// texture coordinates of the four tile corners, shifted according to the mipmap level
+static void TileTexCoords(int Index, int Flags, float Frac, float Nudge, float *pU, float *pV)
+{
+	float TexSize = 1024.0f;
+
+	int tx = Index%16;
+	int ty = Index/16;
+	int Px0 = tx*(1024/16);
+	int Py0 = ty*(1024/16);
+	int Px1 = Px0+(1024/16)-1;
+	int Py1 = Py0+(1024/16)-1;
+
+	float x0 = Nudge + Px0/TexSize+Frac;
+	float y0 = Nudge + Py0/TexSize+Frac;
+	float x1 = Nudge + Px1/TexSize-Frac;
+	float y1 = Nudge + Py0/TexSize+Frac;
+	float x2 = Nudge + Px1/TexSize-Frac;
+	float y2 = Nudge + Py1/TexSize-Frac;
+	float x3 = Nudge + Px0/TexSize+Frac;
+	float y3 = Nudge + Py1/TexSize-Frac;
+
+	if(Flags&TILEFLAG_VFLIP)
+	{
+		x0 = x2;
+		x1 = x3;
+		x2 = x3;
+		x3 = x0;
+	}
+
+	if(Flags&TILEFLAG_HFLIP)
+	{
+		y0 = y3;
+		y2 = y1;
+		y3 = y1;
+		y1 = y0;
+	}
+
+	if(Flags&TILEFLAG_ROTATE)
+	{
+		float Tmp = x0;
+		x0 = x3;
+		x3 = x2;
+		x2 = x1;
+		x1 = Tmp;
+		Tmp = y0;
+		y0 = y3;
+		y3 = y2;
+		y2 = y1;
+		y1 = Tmp;
+	}
+
+	pU[0] = x0; pV[0] = y0;
+	pU[1] = x1; pV[1] = y1;
+	pU[2] = x2; pV[2] = y2;
+	pU[3] = x3; pV[3] = y3;
+}
+
+float CRenderTools::TilemapTilesetScale(float Scale)
+{
+	float ScreenX0, ScreenY0, ScreenX1, ScreenY1;
+	Graphics()->GetScreen(&ScreenX0, &ScreenY0, &ScreenX1, &ScreenY1);
+
+	// calculate the final pixelsize for the tiles
+	float TilePixelSize = 1024/32.0f;
+	float FinalTileSize = Scale/(ScreenX1-ScreenX0) * Graphics()->ScreenWidth();
+	return FinalTileSize/TilePixelSize;
+}
+
 void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags,
 									ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset)
 {
@@ -171,10 +239,16 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 	Graphics()->GetScreen(&ScreenX0, &ScreenY0, &ScreenX1, &ScreenY1);
 	//Graphics()->MapScreen(screen_x0-50, screen_y0-50, screen_x1+50, screen_y1+50);
 
-	// calculate the final pixelsize for the tiles
-	float TilePixelSize = 1024/32.0f;
-	float FinalTileSize = Scale/(ScreenX1-ScreenX0) * Graphics()->ScreenWidth();
-	float FinalTilesetScale = FinalTileSize/TilePixelSize;
+	int StartY = (int)(ScreenY0/Scale)-1;
+	int StartX = (int)(ScreenX0/Scale)-1;
+	int EndY = (int)(ScreenY1/Scale)+1;
+	int EndX = (int)(ScreenX1/Scale)+1;
+
+	// nothing of the border is visible
+	if(RenderFlags&TILERENDERFLAG_OUTSIDE && StartX >= 0 && StartY >= 0 && EndX <= w && EndY <= h)
+		return;
+
+	float FinalTilesetScale = TilemapTilesetScale(Scale);
 
 	float r=1, g=1, b=1, a=1;
 	if(ColorEnv >= 0)
@@ -190,11 +264,6 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 	Graphics()->QuadsBegin();
 	Graphics()->SetColor(Color.r*r, Color.g*g, Color.b*b, Color.a*a);
 
-	int StartY = (int)(ScreenY0/Scale)-1;
-	int StartX = (int)(ScreenX0/Scale)-1;
-	int EndY = (int)(ScreenY1/Scale)+1;
-	int EndX = (int)(ScreenX1/Scale)+1;
-
 	// adjust the texture shift according to mipmap level
 	float TexSize = 1024.0f;
 	float Frac = (1.25f/TexSize) * (1/FinalTilesetScale);
@@ -206,6 +275,13 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 			int mx = x;
 			int my = y;
 
+			if(RenderFlags&TILERENDERFLAG_OUTSIDE && mx >= 0 && mx < w && my >= 0 && my < h)
+			{
+				// the inside is drawn from the tilemap buffer
+				x = w-1;
+				continue;
+			}
+
 			if(RenderFlags&TILERENDERFLAG_EXTEND)
 			{
 				if(mx<0)
@@ -250,54 +326,10 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 
 				if(Render)
 				{
+					float aU[4], aV[4];
+					TileTexCoords(Index, Flags, Frac, Nudge, aU, aV);
 
-					int tx = Index%16;
-					int ty = Index/16;
-					int Px0 = tx*(1024/16);
-					int Py0 = ty*(1024/16);
-					int Px1 = Px0+(1024/16)-1;
-					int Py1 = Py0+(1024/16)-1;
-
-					float x0 = Nudge + Px0/TexSize+Frac;
-					float y0 = Nudge + Py0/TexSize+Frac;
-					float x1 = Nudge + Px1/TexSize-Frac;
-					float y1 = Nudge + Py0/TexSize+Frac;
-					float x2 = Nudge + Px1/TexSize-Frac;
-					float y2 = Nudge + Py1/TexSize-Frac;
-					float x3 = Nudge + Px0/TexSize+Frac;
-					float y3 = Nudge + Py1/TexSize-Frac;
-
-					if(Flags&TILEFLAG_VFLIP)
-					{
-						x0 = x2;
-						x1 = x3;
-						x2 = x3;
-						x3 = x0;
-					}
-
-					if(Flags&TILEFLAG_HFLIP)
-					{
-						y0 = y3;
-						y2 = y1;
-						y3 = y1;
-						y1 = y0;
-					}
-
-					if(Flags&TILEFLAG_ROTATE)
-					{
-						float Tmp = x0;
-						x0 = x3;
-						x3 = x2;
-						x2 = x1;
-						x1 = Tmp;
-						Tmp = y0;
-						y0 = y3;
-						y3 = y2;
-						y2 = y1;
-						y1 = Tmp;
- 					}
-
-					Graphics()->QuadsSetSubsetFree(x0, y0, x1, y1, x2, y2, x3, y3);
+					Graphics()->QuadsSetSubsetFree(aU[0], aV[0], aU[1], aV[1], aU[2], aV[2], aU[3], aV[3]);
 					IGraphics::CQuadItem QuadItem(x*Scale, y*Scale, Scale, Scale);
 					Graphics()->QuadsDrawTL(&QuadItem, 1);
 				}
@@ -308,3 +340,162 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 	Graphics()->QuadsEnd();
 	Graphics()->MapScreen(ScreenX0, ScreenY0, ScreenX1, ScreenY1);
 }
+
+void CRenderTools::RenderTilemapBufferCreate(CTilemapBuffer *pBuffer, CTile *pTiles, int w, int h, float Scale, float TilesetScale)
+{
+	const int ChunkSize = CTilemapBuffer::CHUNK_SIZE;
+	int ChunksX = (w+ChunkSize-1)/ChunkSize;
+	int ChunksY = (h+ChunkSize-1)/ChunkSize;
+
+	// count the tiles, opaque tiles go into their own buffer
+	int aNumQuads[CTilemapBuffer::NUM_BUFFERS] = {0};
+	for(int i = 0; i < w*h; i++)
+	{
+		if(pTiles[i].m_Index)
+			aNumQuads[pTiles[i].m_Flags&TILEFLAG_OPAQUE ? CTilemapBuffer::BUFFER_OPAQUE : CTilemapBuffer::BUFFER_TRANSPARENT]++;
+	}
+
+	if(pBuffer->m_ChunksX != ChunksX || pBuffer->m_ChunksY != ChunksY)
+	{
+		for(int b = 0; b < CTilemapBuffer::NUM_BUFFERS; b++)
+		{
+			mem_free(pBuffer->m_apChunkStart[b]);
+			pBuffer->m_apChunkStart[b] = (int *)mem_alloc((ChunksX*ChunksY+1)*sizeof(int), sizeof(void*));
+		}
+		pBuffer->m_ChunksX = ChunksX;
+		pBuffer->m_ChunksY = ChunksY;
+	}
+
+	IGraphics::CVertexItem *apVertices[CTilemapBuffer::NUM_BUFFERS];
+	int aNum[CTilemapBuffer::NUM_BUFFERS];
+	for(int b = 0; b < CTilemapBuffer::NUM_BUFFERS; b++)
+	{
+		apVertices[b] = aNumQuads[b] ? (IGraphics::CVertexItem *)mem_alloc(aNumQuads[b]*4*sizeof(IGraphics::CVertexItem), sizeof(void*)) : 0;
+		aNum[b] = 0;
+	}
+
+	// adjust the texture shift according to mipmap level
+	float TexSize = 1024.0f;
+	float Frac = (1.25f/TexSize) * (1/TilesetScale);
+	float Nudge = (0.5f/TexSize) * (1/TilesetScale);
+
+	for(int cy = 0; cy < ChunksY; cy++)
+		for(int cx = 0; cx < ChunksX; cx++)
+		{
+			for(int b = 0; b < CTilemapBuffer::NUM_BUFFERS; b++)
+				pBuffer->m_apChunkStart[b][cy*ChunksX+cx] = aNum[b];
+
+			int EndY = min((cy+1)*ChunkSize, h);
+			int EndX = min((cx+1)*ChunkSize, w);
+			for(int y = cy*ChunkSize; y < EndY; y++)
+				for(int x = cx*ChunkSize; x < EndX; x++)
+				{
+					const CTile *pTile = &pTiles[y*w+x];
+					if(!pTile->m_Index)
+						continue;
+
+					int b = pTile->m_Flags&TILEFLAG_OPAQUE ? CTilemapBuffer::BUFFER_OPAQUE : CTilemapBuffer::BUFFER_TRANSPARENT;
+					float aU[4], aV[4];
+					TileTexCoords(pTile->m_Index, pTile->m_Flags, Frac, Nudge, aU, aV);
+
+					IGraphics::CVertexItem *pQuad = &apVertices[b][aNum[b]*4];
+					pQuad[0] = IGraphics::CVertexItem(x*Scale, y*Scale, aU[0], aV[0]);
+					pQuad[1] = IGraphics::CVertexItem((x+1)*Scale, y*Scale, aU[1], aV[1]);
+					pQuad[2] = IGraphics::CVertexItem((x+1)*Scale, (y+1)*Scale, aU[2], aV[2]);
+					pQuad[3] = IGraphics::CVertexItem(x*Scale, (y+1)*Scale, aU[3], aV[3]);
+					aNum[b]++;
+				}
+		}
+
+	for(int b = 0; b < CTilemapBuffer::NUM_BUFFERS; b++)
+	{
+		pBuffer->m_apChunkStart[b][ChunksX*ChunksY] = aNum[b];
+
+		if(pBuffer->m_aBuffer[b] == -1)
+			pBuffer->m_aBuffer[b] = Graphics()->CreateVertexBuffer(apVertices[b], aNum[b]);
+		else
+			Graphics()->UpdateVertexBuffer(pBuffer->m_aBuffer[b], apVertices[b], aNum[b]);
+		mem_free(apVertices[b]);
+	}
+
+	pBuffer->m_TilesetScale = TilesetScale;
+}
+
+void CRenderTools::RenderTilemapBufferDestroy(CTilemapBuffer *pBuffer)
+{
+	for(int b = 0; b < CTilemapBuffer::NUM_BUFFERS; b++)
+	{
+		Graphics()->DeleteVertexBuffer(pBuffer->m_aBuffer[b]);
+		pBuffer->m_aBuffer[b] = -1;
+		mem_free(pBuffer->m_apChunkStart[b]);
+		pBuffer->m_apChunkStart[b] = 0;
+	}
+	pBuffer->m_ChunksX = 0;
+	pBuffer->m_ChunksY = 0;
+	pBuffer->m_TilesetScale = 0.0f;
+}
+
+void CRenderTools::RenderTilemapBuffer(CTilemapBuffer *pBuffer, CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags,
+									ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset)
+{
+	float ScreenX0, ScreenY0, ScreenX1, ScreenY1;
+	Graphics()->GetScreen(&ScreenX0, &ScreenY0, &ScreenX1, &ScreenY1);
+
+	// the uvs are nudged for the tileset scale, rebuild them when the resolution changed
+	float FinalTilesetScale = TilemapTilesetScale(Scale);
+	if(absolute(FinalTilesetScale-pBuffer->m_TilesetScale) > pBuffer->m_TilesetScale*0.01f)
+		RenderTilemapBufferCreate(pBuffer, pTiles, w, h, Scale, FinalTilesetScale);
+
+	int StartY = max((int)(ScreenY0/Scale)-1, 0);
+	int StartX = max((int)(ScreenX0/Scale)-1, 0);
+	int EndY = min((int)(ScreenY1/Scale)+1, h);
+	int EndX = min((int)(ScreenX1/Scale)+1, w);
+
+	if(StartX < EndX && StartY < EndY)
+	{
+		float r=1, g=1, b=1, a=1;
+		if(ColorEnv >= 0)
+		{
+			float aChannels[4];
+			pfnEval(ColorEnvOffset/1000.0f, ColorEnv, aChannels, pUser);
+			r = aChannels[0];
+			g = aChannels[1];
+			b = aChannels[2];
+			a = aChannels[3];
+		}
+
+		// opaque tiles only count as such when the layer is not faded out
+		bool Opaque = Color.a*a > 254.0f/255.0f;
+
+		Graphics()->QuadsBegin();
+		Graphics()->SetColor(Color.r*r, Color.g*g, Color.b*b, Color.a*a);
+
+		const int ChunkSize = CTilemapBuffer::CHUNK_SIZE;
+		int ChunkX0 = StartX/ChunkSize;
+		int ChunkX1 = (EndX-1)/ChunkSize;
+		int ChunkY0 = StartY/ChunkSize;
+		int ChunkY1 = (EndY-1)/ChunkSize;
+
+		for(int i = 0; i < CTilemapBuffer::NUM_BUFFERS; i++)
+		{
+			int Flag = i == CTilemapBuffer::BUFFER_OPAQUE && Opaque ? LAYERRENDERFLAG_OPAQUE : LAYERRENDERFLAG_TRANSPARENT;
+			if(!(RenderFlags&Flag))
+				continue;
+
+			// the visible chunks of a row are next to each other in the buffer
+			const int *pChunkStart = pBuffer->m_apChunkStart[i];
+			for(int cy = ChunkY0; cy <= ChunkY1; cy++)
+			{
+				int First = pChunkStart[cy*pBuffer->m_ChunksX+ChunkX0];
+				int Last = pChunkStart[cy*pBuffer->m_ChunksX+ChunkX1+1];
+				if(Last > First)
+					Graphics()->DrawVertexBuffer(pBuffer->m_aBuffer[i], First, Last-First);
+			}
+		}
+
+		Graphics()->QuadsEnd();
+	}
+
+	if(RenderFlags&TILERENDERFLAG_EXTEND)
+		RenderTilemap(pTiles, w, h, Scale, Color, RenderFlags|TILERENDERFLAG_OUTSIDE, pfnEval, pUser, ColorEnv, ColorEnvOffset);
+}
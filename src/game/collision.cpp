@@ -12,12 +12,27 @@
 #include <game/layers.h>
 #include <game/collision.h>
 
+// the packed flags keep the game layer tile index (TILE_AIR to TILE_NOHOOK),
+// solid tiles are the ones with the lowest bit set
+static const int s_aTileCodeFlags[4] = { 0, CCollision::COLFLAG_SOLID, CCollision::COLFLAG_DEATH, CCollision::COLFLAG_SOLID|CCollision::COLFLAG_NOHOOK };
+
 CCollision::CCollision()
 {
-	m_pTiles = 0;
 	m_Width = 0;
 	m_Height = 0;
 	m_pLayers = 0;
+	m_pTileFlags = 0;
+	m_pSolidBlocks = 0;
+	m_BlocksWidth = 0;
+	m_BlocksHeight = 0;
+}
+
+CCollision::~CCollision()
+{
+	if(m_pTileFlags)
+		mem_free(m_pTileFlags);
+	if(m_pSolidBlocks)
+		mem_free(m_pSolidBlocks);
 }
 
 void CCollision::Init(class CLayers *pLayers)
@@ -25,29 +40,51 @@ void CCollision::Init(class CLayers *pLayers)
 	m_pLayers = pLayers;
 	m_Width = m_pLayers->GameLayer()->m_Width;
 	m_Height = m_pLayers->GameLayer()->m_Height;
-	m_pTiles = static_cast<CTile *>(m_pLayers->Map()->GetData(m_pLayers->GameLayer()->m_Data));
+	CTile *pTiles = static_cast<CTile *>(m_pLayers->Map()->GetData(m_pLayers->GameLayer()->m_Data));
+
+	if(m_pTileFlags)
+		mem_free(m_pTileFlags);
+	if(m_pSolidBlocks)
+		mem_free(m_pSolidBlocks);
+
+	int FlagsSize = (m_Width*m_Height+3)/4;
+	m_pTileFlags = (unsigned char *)mem_alloc(FlagsSize, 1);
+	mem_zero(m_pTileFlags, FlagsSize);
+
+	m_BlocksWidth = ((m_Width-1)>>BLOCK_SHIFT)+1;
+	m_BlocksHeight = ((m_Height-1)>>BLOCK_SHIFT)+1;
+	m_pSolidBlocks = (unsigned char *)mem_alloc(m_BlocksWidth*m_BlocksHeight, 1);
+	mem_zero(m_pSolidBlocks, m_BlocksWidth*m_BlocksHeight);
 
 	for(int i = 0; i < m_Width*m_Height; i++)
 	{
-		int Index = m_pTiles[i].m_Index;
+		int Index = pTiles[i].m_Index;
 
 		if(Index > 128)
 			continue;
 
+		int Code = TILE_AIR;
 		switch(Index)
 		{
 		case TILE_DEATH:
-			m_pTiles[i].m_Index = COLFLAG_DEATH;
+			pTiles[i].m_Index = COLFLAG_DEATH;
+			Code = TILE_DEATH;
 			break;
 		case TILE_SOLID:
-			m_pTiles[i].m_Index = COLFLAG_SOLID;
+			pTiles[i].m_Index = COLFLAG_SOLID;
+			Code = TILE_SOLID;
 			break;
 		case TILE_NOHOOK:
-			m_pTiles[i].m_Index = COLFLAG_SOLID|COLFLAG_NOHOOK;
+			pTiles[i].m_Index = COLFLAG_SOLID|COLFLAG_NOHOOK;
+			Code = TILE_NOHOOK;
 			break;
 		default:
-			m_pTiles[i].m_Index = 0;
+			pTiles[i].m_Index = 0;
 		}
+
+		m_pTileFlags[i>>2] |= Code<<((i&3)*2);
+		if(Code&1)
+			m_pSolidBlocks[((i/m_Width)>>BLOCK_SHIFT)*m_BlocksWidth+((i%m_Width)>>BLOCK_SHIFT)] = 1;
 	}
 }
 
@@ -55,36 +92,109 @@ int CCollision::GetTile(int x, int y)
 {
 	int Nx = clamp(x/32, 0, m_Width-1);
 	int Ny = clamp(y/32, 0, m_Height-1);
+	int i = Ny*m_Width+Nx;
 
-	return m_pTiles[Ny*m_Width+Nx].m_Index > 128 ? 0 : m_pTiles[Ny*m_Width+Nx].m_Index;
+	return s_aTileCodeFlags[(m_pTileFlags[i>>2]>>((i&3)*2))&3];
 }
 
 bool CCollision::IsTileSolid(int x, int y)
 {
-	return GetTile(x, y)&COLFLAG_SOLID;
+	int Nx = clamp(x/32, 0, m_Width-1);
+	int Ny = clamp(y/32, 0, m_Height-1);
+	int i = Ny*m_Width+Nx;
+
+	return (m_pTileFlags[i>>2]>>((i&3)*2))&1;
+}
+
+bool CCollision::IsAreaFree(vec2 Min, vec2 Max)
+{
+	// covers every tile that CheckPoint can return for a point in the area
+	int x0 = clamp(round_to_int(Min.x)/32, 0, m_Width-1)>>BLOCK_SHIFT;
+	int y0 = clamp(round_to_int(Min.y)/32, 0, m_Height-1)>>BLOCK_SHIFT;
+	int x1 = clamp(round_to_int(Max.x)/32, 0, m_Width-1)>>BLOCK_SHIFT;
+	int y1 = clamp(round_to_int(Max.y)/32, 0, m_Height-1)>>BLOCK_SHIFT;
+
+	for(int y = y0; y <= y1; y++)
+		for(int x = x0; x <= x1; x++)
+			if(m_pSolidBlocks[y*m_BlocksWidth+x])
+				return false;
+	return true;
 }
 
-// TODO: rewrite this smarter!
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
+	// the line is tested at one unit steps, sample i is at mix(Pos0, Pos1, i/Distance).
+	// instead of checking every sample, walk the tiles the line crosses and only look
+	// at the samples that lie in solid ones. samples that only cut the corner of a
+	// solid tile between two steps are skipped just like before.
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance+1);
-	vec2 Last = Pos0;
 
-	for(int i = 0; i < End; i++)
+	if(Distance > 0.0f)
 	{
-		float a = i/Distance;
-		vec2 Pos = mix(Pos0, Pos1, a);
-		if(CheckPoint(Pos.x, Pos.y))
+		// CheckPoint rounds to the closest unit, so the tile borders are at n*32-0.5
+		vec2 Dir = Pos1-Pos0;
+		vec2 Start = Pos0+vec2(0.5f, 0.5f);
+		int x = (int)floorf(Start.x/32.0f);
+		int y = (int)floorf(Start.y/32.0f);
+		int StepX = Dir.x < 0 ? -1 : 1;
+		int StepY = Dir.y < 0 ? -1 : 1;
+
+		// line parameter at which the next column/row starts and the parameter length of one tile
+		const float Never = 1e30f;
+		float NextX = Dir.x != 0 ? ((x+(StepX > 0))*32.0f-Start.x)/Dir.x : Never;
+		float NextY = Dir.y != 0 ? ((y+(StepY > 0))*32.0f-Start.y)/Dir.y : Never;
+		float DeltaX = Dir.x != 0 ? 32.0f/absolute(Dir.x) : Never;
+		float DeltaY = Dir.y != 0 ? 32.0f/absolute(Dir.y) : Never;
+
+		float Enter = 0.0f;
+		float LastSample = (End-1)/Distance;
+		while(Enter <= LastSample)
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return GetCollisionAt(Pos.x, Pos.y);
+			float Exit = min(NextX, NextY);
+			if(IsTileSolid(x*32, y*32))
+			{
+				// check the samples inside this tile, with one extra on each side against rounding
+				int First = max((int)ceilf(Enter*Distance)-1, 0);
+				int Last = min((int)(Exit*Distance)+1, End-1);
+				for(int i = First; i <= Last; i++)
+				{
+					vec2 Pos = mix(Pos0, Pos1, i/Distance);
+					if(CheckPoint(Pos.x, Pos.y))
+					{
+						if(pOutCollision)
+							*pOutCollision = Pos;
+						if(pOutBeforeCollision)
+							*pOutBeforeCollision = i > 0 ? mix(Pos0, Pos1, (i-1)/Distance) : Pos0;
+						return GetCollisionAt(Pos.x, Pos.y);
+					}
+				}
+			}
+
+			// step to the next tile
+			if(NextX < NextY)
+			{
+				x += StepX;
+				Enter = NextX;
+				NextX += DeltaX;
+			}
+			else
+			{
+				y += StepY;
+				Enter = NextY;
+				NextY += DeltaY;
+			}
 		}
-		Last = Pos;
 	}
+	else if(CheckPoint(Pos0.x, Pos0.y))
+	{
+		if(pOutCollision)
+			*pOutCollision = Pos0;
+		if(pOutBeforeCollision)
+			*pOutBeforeCollision = Pos0;
+		return GetCollisionAt(Pos0.x, Pos0.y);
+	}
+
 	if(pOutCollision)
 		*pOutCollision = Pos1;
 	if(pOutBeforeCollision)
@@ -92,18 +202,22 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 	return 0;
 }
 
-// TODO: OPT: rewrite this smarter!
 void CCollision::MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, int *pBounces)
 {
 	if(pBounces)
 		*pBounces = 0;
 
+	// the same tests as CheckPoint, but every coordinate is only rounded once
 	vec2 Pos = *pInoutPos;
 	vec2 Vel = *pInoutVel;
-	if(CheckPoint(Pos + Vel))
+	int x0 = round_to_int(Pos.x);
+	int y0 = round_to_int(Pos.y);
+	int x1 = round_to_int(Pos.x+Vel.x);
+	int y1 = round_to_int(Pos.y+Vel.y);
+	if(IsTileSolid(x1, y1))
 	{
 		int Affected = 0;
-		if(CheckPoint(Pos.x + Vel.x, Pos.y))
+		if(IsTileSolid(x1, y0))
 		{
 			pInoutVel->x *= -Elasticity;
 			if(pBounces)
@@ -111,7 +225,7 @@ void CCollision::MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, i
 			Affected++;
 		}
 
-		if(CheckPoint(Pos.x, Pos.y + Vel.y))
+		if(IsTileSolid(x0, y1))
 		{
 			pInoutVel->y *= -Elasticity;
 			if(pBounces)
@@ -156,6 +270,13 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elas
 
 	if(Distance > 0.00001f)
 	{
+		// when there is nothing solid around the whole move the steps don't have to be tested,
+		// they are still taken one by one so the result stays the same
+		vec2 Margin = Size*0.5f+vec2(1.0f, 1.0f);
+		vec2 AreaMin = vec2(min(Pos.x, Pos.x+Vel.x), min(Pos.y, Pos.y+Vel.y))-Margin;
+		vec2 AreaMax = vec2(max(Pos.x, Pos.x+Vel.x), max(Pos.y, Pos.y+Vel.y))+Margin;
+		bool Test = !IsAreaFree(AreaMin, AreaMax);
+
 		//vec2 old_pos = pos;
 		float Fraction = 1.0f/(float)(Max+1);
 		for(int i = 0; i <= Max; i++)
@@ -166,7 +287,7 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elas
 
 			vec2 NewPos = Pos + Vel*Fraction; // TODO: this row is not nice
 
-			if(TestBox(vec2(NewPos.x, NewPos.y), Size))
+			if(Test && TestBox(vec2(NewPos.x, NewPos.y), Size))
 			{
 				int Hits = 0;
 
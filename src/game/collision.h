@@ -7,13 +7,27 @@
 
 class CCollision
 {
-	class CTile *m_pTiles;
+	enum
+	{
+		// blocks of 2x2 tiles are checked for solid tiles at once
+		BLOCK_SHIFT=1,
+	};
+
 	int m_Width;
 	int m_Height;
 	class CLayers *m_pLayers;
 
+	// the collision flags of the game layer with 2 bits per tile
+	unsigned char *m_pTileFlags;
+
+	// one entry per block of tiles, non-zero if the block has a solid tile
+	unsigned char *m_pSolidBlocks;
+	int m_BlocksWidth;
+	int m_BlocksHeight;
+
 	bool IsTileSolid(int x, int y);
 	int GetTile(int x, int y);
+	bool IsAreaFree(vec2 Min, vec2 Max);
 
 public:
 	enum
@@ -24,6 +38,7 @@ public:
 	};
 
 	CCollision();
+	~CCollision();
 	void Init(class CLayers *pLayers);
 	bool CheckPoint(float x, float y) { return IsTileSolid(round_to_int(x), round_to_int(y)); }
 	bool CheckPoint(vec2 Pos) { return CheckPoint(Pos.x, Pos.y); }
@@ -20,6 +20,10 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType)
 
 	m_pPrevTypeEntity = 0;
 	m_pNextTypeEntity = 0;
+
+	m_pPrevCellEntity = 0;
+	m_pNextCellEntity = 0;
+	m_GridCell = -1;
 }
 
 CEntity::~CEntity()
@@ -38,15 +42,26 @@ int CEntity::NetworkClipped(int SnappingClient, vec2 CheckPos)
 	if(SnappingClient == -1)
 		return 0;
 
-	float dx = GameServer()->m_apPlayers[SnappingClient]->m_ViewPos.x-CheckPos.x;
-	float dy = GameServer()->m_apPlayers[SnappingClient]->m_ViewPos.y-CheckPos.y;
+	if(SnappingClient == CGameContext::SNAP_WORLD)
+	{
+		GameServer()->SetSnapView(CGameContext::SNAPVIEW_ENTITY, CheckPos, CmaskAll());
+		return 0;
+	}
+
+	return ViewClipped(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, CheckPos) ? 1 : 0;
+}
+
+bool CEntity::ViewClipped(vec2 ViewPos, vec2 CheckPos)
+{
+	float dx = ViewPos.x-CheckPos.x;
+	float dy = ViewPos.y-CheckPos.y;
 
 	if(absolute(dx) > 1000.0f || absolute(dy) > 800.0f)
-		return 1;
+		return true;
 
-	if(distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, CheckPos) > 1100.0f)
-		return 1;
-	return 0;
+	if(distance(ViewPos, CheckPos) > 1100.0f)
+		return true;
+	return false;
 }
 
 bool CEntity::GameLayerClipped(vec2 CheckPos)
@@ -62,6 +62,11 @@ class CEntity
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
 
+	// grid cell handling
+	CEntity *m_pPrevCellEntity;
+	CEntity *m_pNextCellEntity;
+	int m_GridCell;
+
 	class CGameWorld *m_pGameWorld;
 protected:
 	bool m_MarkedForDestroy;
@@ -120,7 +125,10 @@ public:
 			snapping_client - ID of the client which snapshot is
 				being generated. Could be -1 to create a complete
 				snapshot of everything in the game for demo
-				recording.
+				recording, or CGameContext::SNAP_WORLD to create the
+				world snapshot that is shared by all clients. Data that
+				only some clients may see must be left out of the world
+				snapshot.
 	*/
 	virtual void Snap(int SnappingClient) {}
 
@@ -137,10 +145,15 @@ public:
 
 		Returns:
 			Non-zero if the entity doesn't have to be in the snapshot.
+			The world snapshot is never clipped, instead the position
+			is attached to the following items and checked for every
+			client when the world snapshot gets filtered.
 	*/
 	int NetworkClipped(int SnappingClient);
 	int NetworkClipped(int SnappingClient, vec2 CheckPos);
 
+	static bool ViewClipped(vec2 ViewPos, vec2 CheckPos);
+
 	bool GameLayerClipped(vec2 CheckPos);
 
 	/*
@@ -34,6 +34,7 @@ void CGameContext::Construct(int Resetting)
 	m_pVoteOptionLast = 0;
 	m_NumVoteOptions = 0;
 	m_LockTeams = 0;
+	m_NumSnapViews = 0;
 
 	if(Resetting==NO_RESET)
 		m_pVoteOptionHeap = new CHeap();
@@ -1483,6 +1484,7 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 
 	m_Layers.Init(Kernel());
 	m_Collision.Init(&m_Layers);
+	m_World.InitGrid(m_Collision.GetWidth(), m_Collision.GetHeight());
 
 	// reset everything here
 	//world = new GAMEWORLD;
@@ -1572,6 +1574,67 @@ void CGameContext::OnSnap(int ClientID)
 			m_apPlayers[i]->Snap(ClientID);
 	}
 }
+
+void CGameContext::OnSnapWorld()
+{
+	m_NumSnapViews = 0;
+
+	m_World.Snap(SNAP_WORLD);
+	Server()->SnapSetView(-1);
+	m_pController->Snap(SNAP_WORLD);
+	m_Events.Snap(SNAP_WORLD);
+}
+
+void CGameContext::OnSnapClient(int ClientID)
+{
+	// the own and the spectated character carry health, armor and ammo
+	CCharacter *pChr = GetPlayerChar(ClientID);
+	if(pChr)
+		pChr->Snap(ClientID);
+
+	int SpectatorID = m_apPlayers[ClientID]->m_SpectatorID;
+	if(!g_Config.m_SvStrictSpectateMode && SpectatorID != ClientID && (pChr = GetPlayerChar(SpectatorID)))
+		pChr->Snap(ClientID);
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(m_apPlayers[i])
+			m_apPlayers[i]->Snap(ClientID);
+	}
+}
+
+bool CGameContext::IsSnapItemVisible(int ClientID, int Type, int ID, int View)
+{
+	// these are snapped for the client in OnSnapClient
+	if(Type == NETOBJTYPE_CHARACTER && (ID == ClientID ||
+		(!g_Config.m_SvStrictSpectateMode && ID == m_apPlayers[ClientID]->m_SpectatorID)))
+		return false;
+
+	if(View < 0)
+		return true;
+
+	const CSnapView *pView = &m_aSnapViews[View];
+	if(pView->m_Type == SNAPVIEW_EVENT)
+		return CmaskIsSet(pView->m_ClientMask, ClientID) && distance(m_apPlayers[ClientID]->m_ViewPos, pView->m_Pos) < 1500.0f;
+	return !CEntity::ViewClipped(m_apPlayers[ClientID]->m_ViewPos, pView->m_Pos);
+}
+
+void CGameContext::SetSnapView(int Type, vec2 Pos, int ClientMask)
+{
+	// out of views, send the following items to everyone
+	if(m_NumSnapViews == MAX_SNAPVIEWS)
+	{
+		Server()->SnapSetView(-1);
+		return;
+	}
+
+	CSnapView *pView = &m_aSnapViews[m_NumSnapViews];
+	pView->m_Type = Type;
+	pView->m_Pos = Pos;
+	pView->m_ClientMask = ClientMask;
+	Server()->SnapSetView(m_NumSnapViews++);
+}
+
 void CGameContext::OnPreSnap() {}
 void CGameContext::OnPostSnap()
 {
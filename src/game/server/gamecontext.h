@@ -35,6 +35,16 @@
 			Events handler (EVENT_HANDLER::snap)
 			All players (CPlayer::snap)
 
+	Shared snap
+		Game Context (CGameContext::snap_world), once per tick
+			Game World, Game Controller and Events handler with
+			SNAP_WORLD, items are tagged with a view (CGameContext::set_snap_view)
+		For every client
+			Visible world items (CGameContext::is_snap_item_visible)
+			Game Context (CGameContext::snap_client)
+				Own and spectated character (ENTITY::snap)
+				All players (CPlayer::snap)
+
 */
 class CGameContext : public IGameServer
 {
@@ -89,6 +99,29 @@ public:
 	// helper functions
 	class CCharacter *GetPlayerChar(int ClientID);
 
+	// shared world snapshot
+	enum
+	{
+		SNAP_WORLD=-2,
+
+		SNAPVIEW_ENTITY=0,
+		SNAPVIEW_EVENT,
+
+		MAX_SNAPVIEWS=1024,
+	};
+
+	class CSnapView
+	{
+	public:
+		int m_Type;
+		vec2 m_Pos;
+		int m_ClientMask;
+	};
+	CSnapView m_aSnapViews[MAX_SNAPVIEWS];
+	int m_NumSnapViews;
+
+	void SetSnapView(int Type, vec2 Pos, int ClientMask);
+
 	int m_LockTeams;
 
 	// voting
@@ -158,6 +191,9 @@ public:
 	virtual void OnTick();
 	virtual void OnPreSnap();
 	virtual void OnSnap(int ClientID);
+	virtual void OnSnapWorld();
+	virtual void OnSnapClient(int ClientID);
+	virtual bool IsSnapItemVisible(int ClientID, int Type, int ID, int View);
 	virtual void OnPostSnap();
 
 	virtual void OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID);
@@ -16,7 +16,15 @@ CGameWorld::CGameWorld()
 	m_Paused = false;
 	m_ResetRequested = false;
 	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
 		m_apFirstEntityTypes[i] = 0;
+		m_aNumEntities[i] = 0;
+		m_aMaxProximityRadius[i] = 0.0f;
+	}
+
+	m_ppGrid = 0;
+	m_GridWidth = 0;
+	m_GridHeight = 0;
 }
 
 CGameWorld::~CGameWorld()
@@ -25,6 +33,9 @@ CGameWorld::~CGameWorld()
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 		while(m_apFirstEntityTypes[i])
 			delete m_apFirstEntityTypes[i];
+
+	if(m_ppGrid)
+		mem_free(m_ppGrid);
 }
 
 void CGameWorld::SetGameServer(CGameContext *pGameServer)
@@ -33,6 +44,115 @@ void CGameWorld::SetGameServer(CGameContext *pGameServer)
 	m_pServer = m_pGameServer->Server();
 }
 
+void CGameWorld::InitGrid(int Width, int Height)
+{
+	if(m_ppGrid)
+		mem_free(m_ppGrid);
+
+	m_GridWidth = max((Width*32+GRID_CELL_SIZE-1)/GRID_CELL_SIZE, 1);
+	m_GridHeight = max((Height*32+GRID_CELL_SIZE-1)/GRID_CELL_SIZE, 1);
+	int Size = NUM_ENTTYPES*m_GridWidth*m_GridHeight*sizeof(CEntity *);
+	m_ppGrid = (CEntity **)mem_alloc(Size, 1);
+	mem_zero(m_ppGrid, Size);
+
+	// sort in the entities that are already there
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			GridInsert(pEnt);
+}
+
+int CGameWorld::GridCell(vec2 Pos) const
+{
+	// entities outside of the map are kept in the border cells
+	int x = clamp((int)(Pos.x/GRID_CELL_SIZE), 0, m_GridWidth-1);
+	int y = clamp((int)(Pos.y/GRID_CELL_SIZE), 0, m_GridHeight-1);
+	return y*m_GridWidth+x;
+}
+
+void CGameWorld::GridInsert(CEntity *pEnt)
+{
+	if(!m_ppGrid)
+		return;
+
+	pEnt->m_GridCell = GridCell(pEnt->m_Pos);
+	CEntity **ppFirst = &m_ppGrid[pEnt->m_ObjType*m_GridWidth*m_GridHeight+pEnt->m_GridCell];
+	if(*ppFirst)
+		(*ppFirst)->m_pPrevCellEntity = pEnt;
+	pEnt->m_pNextCellEntity = *ppFirst;
+	pEnt->m_pPrevCellEntity = 0;
+	*ppFirst = pEnt;
+}
+
+void CGameWorld::GridRemove(CEntity *pEnt)
+{
+	if(pEnt->m_GridCell == -1)
+		return;
+
+	if(pEnt->m_pPrevCellEntity)
+		pEnt->m_pPrevCellEntity->m_pNextCellEntity = pEnt->m_pNextCellEntity;
+	else
+		m_ppGrid[pEnt->m_ObjType*m_GridWidth*m_GridHeight+pEnt->m_GridCell] = pEnt->m_pNextCellEntity;
+	if(pEnt->m_pNextCellEntity)
+		pEnt->m_pNextCellEntity->m_pPrevCellEntity = pEnt->m_pPrevCellEntity;
+
+	pEnt->m_pNextCellEntity = 0;
+	pEnt->m_pPrevCellEntity = 0;
+	pEnt->m_GridCell = -1;
+}
+
+void CGameWorld::UpdateGrid()
+{
+	if(!m_ppGrid)
+		return;
+
+	// move the entities that left their cell
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		{
+			m_aMaxProximityRadius[i] = max(m_aMaxProximityRadius[i], pEnt->m_ProximityRadius);
+			if(GridCell(pEnt->m_Pos) != pEnt->m_GridCell)
+			{
+				GridRemove(pEnt);
+				GridInsert(pEnt);
+			}
+		}
+}
+
+void CGameWorld::GetAreaLists(vec2 Min, vec2 Max, int Type, CAreaLists *pLists)
+{
+	pLists->m_Num = 0;
+
+	if(m_ppGrid)
+	{
+		int x0 = clamp((int)(Min.x/GRID_CELL_SIZE), 0, m_GridWidth-1);
+		int y0 = clamp((int)(Min.y/GRID_CELL_SIZE), 0, m_GridHeight-1);
+		int x1 = clamp((int)(Max.x/GRID_CELL_SIZE), 0, m_GridWidth-1);
+		int y1 = clamp((int)(Max.y/GRID_CELL_SIZE), 0, m_GridHeight-1);
+		int NumCells = (x1-x0+1)*(y1-y0+1);
+
+		// only use the grid if it has to look at less cells than there are entities
+		if(NumCells <= MAX_AREA_CELLS && NumCells < m_aNumEntities[Type])
+		{
+			CEntity **ppCells = &m_ppGrid[Type*m_GridWidth*m_GridHeight];
+			for(int y = y0; y <= y1; y++)
+				for(int x = x0; x <= x1; x++)
+					if(ppCells[y*m_GridWidth+x])
+						pLists->m_apFirst[pLists->m_Num++] = ppCells[y*m_GridWidth+x];
+			pLists->m_Grid = true;
+			return;
+		}
+	}
+
+	if(m_apFirstEntityTypes[Type])
+		pLists->m_apFirst[pLists->m_Num++] = m_apFirstEntityTypes[Type];
+	pLists->m_Grid = false;
+}
+
+CEntity *CGameWorld::AreaNext(const CAreaLists *pLists, CEntity *pEnt)
+{
+	return pLists->m_Grid ? pEnt->m_pNextCellEntity : pEnt->m_pNextTypeEntity;
+}
+
 CEntity *CGameWorld::FindFirst(int Type)
 {
 	return Type < 0 || Type >= NUM_ENTTYPES ? 0 : m_apFirstEntityTypes[Type];
@@ -43,18 +163,23 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
+	CAreaLists Lists;
+	vec2 Range = vec2(Radius+m_aMaxProximityRadius[Type], Radius+m_aMaxProximityRadius[Type]);
+	GetAreaLists(Pos-Range, Pos+Range, Type, &Lists);
+
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type];	pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
-		if(distance(pEnt->m_Pos, Pos) < Radius+pEnt->m_ProximityRadius)
+	for(int l = 0; l < Lists.m_Num; l++)
+		for(CEntity *pEnt = Lists.m_apFirst[l]; pEnt; pEnt = AreaNext(&Lists, pEnt))
 		{
-			if(ppEnts)
-				ppEnts[Num] = pEnt;
-			Num++;
-			if(Num == Max)
-				break;
+			if(distance(pEnt->m_Pos, Pos) < Radius+pEnt->m_ProximityRadius)
+			{
+				if(ppEnts)
+					ppEnts[Num] = pEnt;
+				Num++;
+				if(Num == Max)
+					return Num;
+			}
 		}
-	}
 
 	return Num;
 }
@@ -72,6 +197,10 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	m_aNumEntities[pEnt->m_ObjType]++;
+	m_aMaxProximityRadius[pEnt->m_ObjType] = max(m_aMaxProximityRadius[pEnt->m_ObjType], pEnt->m_ProximityRadius);
+	GridInsert(pEnt);
 }
 
 void CGameWorld::DestroyEntity(CEntity *pEnt)
@@ -99,6 +228,9 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
+
+	m_aNumEntities[pEnt->m_ObjType]--;
+	GridRemove(pEnt);
 }
 
 //
@@ -108,6 +240,8 @@ void CGameWorld::Snap(int SnappingClient)
 		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			if(SnappingClient == CGameContext::SNAP_WORLD)
+				Server()->SnapSetView(-1);
 			pEnt->Snap(SnappingClient);
 			pEnt = m_pNextTraverseEntity;
 		}
@@ -152,6 +286,9 @@ void CGameWorld::Tick()
 	if(m_ResetRequested)
 		Reset();
 
+	// pick up the entities that were moved since the last tick
+	UpdateGrid();
+
 	if(!m_Paused)
 	{
 		if(GameServer()->m_pController->IsForceBalanced())
@@ -186,6 +323,7 @@ void CGameWorld::Tick()
 	}
 
 	RemoveEntities();
+	UpdateGrid();
 }
 
 
@@ -196,25 +334,31 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
- 	{
-		if(p == pNotThis)
-			continue;
+	CAreaLists Lists;
+	float Range = Radius+m_aMaxProximityRadius[ENTTYPE_CHARACTER];
+	vec2 Min = vec2(min(Pos0.x, Pos1.x)-Range, min(Pos0.y, Pos1.y)-Range);
+	vec2 Max = vec2(max(Pos0.x, Pos1.x)+Range, max(Pos0.y, Pos1.y)+Range);
+	GetAreaLists(Min, Max, ENTTYPE_CHARACTER, &Lists);
 
-		vec2 IntersectPos = closest_point_on_line(Pos0, Pos1, p->m_Pos);
-		float Len = distance(p->m_Pos, IntersectPos);
-		if(Len < p->m_ProximityRadius+Radius)
+	for(int l = 0; l < Lists.m_Num; l++)
+		for(CCharacter *p = (CCharacter *)Lists.m_apFirst[l]; p; p = (CCharacter *)AreaNext(&Lists, p))
 		{
-			Len = distance(Pos0, IntersectPos);
-			if(Len < ClosestLen)
+			if(p == pNotThis)
+				continue;
+
+			vec2 IntersectPos = closest_point_on_line(Pos0, Pos1, p->m_Pos);
+			float Len = distance(p->m_Pos, IntersectPos);
+			if(Len < p->m_ProximityRadius+Radius)
 			{
-				NewPos = IntersectPos;
-				ClosestLen = Len;
-				pClosest = p;
+				Len = distance(Pos0, IntersectPos);
+				if(Len < ClosestLen)
+				{
+					NewPos = IntersectPos;
+					ClosestLen = Len;
+					pClosest = p;
+				}
 			}
 		}
-	}
 
 	return pClosest;
 }
@@ -226,22 +370,26 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, CEntity *pNotTh
 	float ClosestRange = Radius*2;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)GameServer()->m_World.FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
- 	{
-		if(p == pNotThis)
-			continue;
+	CAreaLists Lists;
+	vec2 Range = vec2(Radius+m_aMaxProximityRadius[ENTTYPE_CHARACTER], Radius+m_aMaxProximityRadius[ENTTYPE_CHARACTER]);
+	GetAreaLists(Pos-Range, Pos+Range, ENTTYPE_CHARACTER, &Lists);
 
-		float Len = distance(Pos, p->m_Pos);
-		if(Len < p->m_ProximityRadius+Radius)
+	for(int l = 0; l < Lists.m_Num; l++)
+		for(CCharacter *p = (CCharacter *)Lists.m_apFirst[l]; p; p = (CCharacter *)AreaNext(&Lists, p))
 		{
-			if(Len < ClosestRange)
+			if(p == pNotThis)
+				continue;
+
+			float Len = distance(Pos, p->m_Pos);
+			if(Len < p->m_ProximityRadius+Radius)
 			{
-				ClosestRange = Len;
-				pClosest = p;
+				if(Len < ClosestRange)
+				{
+					ClosestRange = Len;
+					pClosest = p;
+				}
 			}
 		}
-	}
 
 	return pClosest;
 }
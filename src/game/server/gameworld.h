@@ -27,11 +27,41 @@ public:
 	};
 
 private:
+	enum
+	{
+		GRID_CELL_SIZE=256, // 8 tiles
+		MAX_AREA_CELLS=64,
+	};
+
+	// the lists that have to be searched for entities of one type in an area,
+	// either grid cells or the whole type list if that is cheaper
+	class CAreaLists
+	{
+	public:
+		CEntity *m_apFirst[MAX_AREA_CELLS];
+		int m_Num;
+		bool m_Grid;
+	};
+
 	void Reset();
 	void RemoveEntities();
 
+	int GridCell(vec2 Pos) const;
+	void GridInsert(CEntity *pEnt);
+	void GridRemove(CEntity *pEnt);
+	void UpdateGrid();
+	void GetAreaLists(vec2 Min, vec2 Max, int Type, CAreaLists *pLists);
+	static CEntity *AreaNext(const CAreaLists *pLists, CEntity *pEnt);
+
 	CEntity *m_pNextTraverseEntity;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
+	int m_aNumEntities[NUM_ENTTYPES];
+	float m_aMaxProximityRadius[NUM_ENTTYPES];
+
+	// uniform grid over the map, one list of entities per type and cell
+	CEntity **m_ppGrid;
+	int m_GridWidth;
+	int m_GridHeight;
 
 	class CGameContext *m_pGameServer;
 	class IServer *m_pServer;
@@ -49,6 +79,22 @@ public:
 
 	void SetGameServer(CGameContext *pGameServer);
 
+	/*
+		Function: init_grid
+			Sets up the grid that speeds up the area queries.
+			Entities are sorted into it when they get inserted and
+			at the start and the end of every world tick, so an
+			entity that moves outside of its tick_defered should
+			not expect to be found at its new position before
+			the next tick. Without a grid the queries search the
+			whole entity lists.
+
+		Arguments:
+			width - Width of the map in tiles.
+			height - Height of the map in tiles.
+	*/
+	void InitGrid(int Width, int Height);
+
 	CEntity *FindFirst(int Type);
 
 	/*
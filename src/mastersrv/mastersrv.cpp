@@ -1,5 +1,6 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 
 #include <engine/config.h>
@@ -17,11 +18,164 @@
 enum {
 	MTU = 1400,
 	MAX_SERVERS_PER_PACKET=75,
-	MAX_PACKETS=16,
-	MAX_SERVERS=MAX_SERVERS_PER_PACKET*MAX_PACKETS,
+	MIN_SERVERS=MAX_SERVERS_PER_PACKET*16,
+	NUM_SERVERTYPES=2,
+	MAX_CHECKS_PER_UPDATE=32, // spreads the checks after a heartbeat storm
 	EXPIRE_TIME = 90
 };
 
+/*
+	Maps addresses to an int, used to find servers by their address
+	without walking the whole list. Grows with the number of entries.
+*/
+class CAddrIndex
+{
+	struct CNode
+	{
+		NETADDR m_Addr;
+		int m_Value;
+		int m_Next;
+	};
+
+	int *m_pBuckets;
+	int m_NumBuckets; // power of two
+	CNode *m_pNodes;
+	int m_MaxNodes;
+	int m_NumNodes;
+	int m_FirstFree;
+
+	static unsigned Hash(const NETADDR *pAddr)
+	{
+		unsigned Hash = pAddr->type^(pAddr->port*2654435761u);
+		for(int i = 0; i < (int)sizeof(pAddr->ip); i++)
+			Hash = (Hash^pAddr->ip[i])*16777619u;
+		return Hash^(Hash>>15);
+	}
+
+	void Grow()
+	{
+		// more nodes
+		int MaxNodes = m_MaxNodes ? m_MaxNodes*2 : MIN_SERVERS;
+		CNode *pNodes = (CNode *)mem_alloc(MaxNodes*sizeof(CNode), 1);
+		if(m_pNodes)
+		{
+			mem_copy(pNodes, m_pNodes, m_MaxNodes*sizeof(CNode));
+			mem_free(m_pNodes);
+		}
+		for(int i = m_MaxNodes; i < MaxNodes; i++)
+			pNodes[i].m_Next = i+1 < MaxNodes ? i+1 : m_FirstFree;
+		m_FirstFree = m_MaxNodes;
+		m_pNodes = pNodes;
+		m_MaxNodes = MaxNodes;
+
+		// and rehash them into more buckets
+		int *pBuckets = (int *)mem_alloc(MaxNodes*sizeof(int), 1);
+		for(int i = 0; i < MaxNodes; i++)
+			pBuckets[i] = -1;
+		for(int b = 0; b < m_NumBuckets; b++)
+		{
+			int Node = m_pBuckets[b];
+			while(Node != -1)
+			{
+				int Next = m_pNodes[Node].m_Next;
+				int Bucket = Hash(&m_pNodes[Node].m_Addr)&(MaxNodes-1);
+				m_pNodes[Node].m_Next = pBuckets[Bucket];
+				pBuckets[Bucket] = Node;
+				Node = Next;
+			}
+		}
+		mem_free(m_pBuckets);
+		m_pBuckets = pBuckets;
+		m_NumBuckets = MaxNodes;
+	}
+
+	int *FindLink(const NETADDR *pAddr) const
+	{
+		int *pLink = &m_pBuckets[Hash(pAddr)&(m_NumBuckets-1)];
+		while(*pLink != -1 && net_addr_comp(&m_pNodes[*pLink].m_Addr, pAddr) != 0)
+			pLink = &m_pNodes[*pLink].m_Next;
+		return pLink;
+	}
+
+public:
+	CAddrIndex()
+	{
+		m_pBuckets = 0;
+		m_NumBuckets = 0;
+		m_pNodes = 0;
+		m_MaxNodes = 0;
+		m_NumNodes = 0;
+		m_FirstFree = -1;
+	}
+
+	// returns -1 if the address is not in the index
+	int Find(const NETADDR *pAddr) const
+	{
+		if(!m_NumNodes)
+			return -1;
+		int Node = *FindLink(pAddr);
+		return Node == -1 ? -1 : m_pNodes[Node].m_Value;
+	}
+
+	// the address must not be in the index yet
+	void Insert(const NETADDR *pAddr, int Value)
+	{
+		if(m_FirstFree == -1)
+			Grow();
+		int Node = m_FirstFree;
+		m_FirstFree = m_pNodes[Node].m_Next;
+		m_NumNodes++;
+
+		int Bucket = Hash(pAddr)&(m_NumBuckets-1);
+		m_pNodes[Node].m_Addr = *pAddr;
+		m_pNodes[Node].m_Value = Value;
+		m_pNodes[Node].m_Next = m_pBuckets[Bucket];
+		m_pBuckets[Bucket] = Node;
+	}
+
+	// changes the value of an address if it currently has OldValue
+	void Replace(const NETADDR *pAddr, int OldValue, int NewValue)
+	{
+		if(!m_NumNodes)
+			return;
+		int Node = *FindLink(pAddr);
+		if(Node != -1 && m_pNodes[Node].m_Value == OldValue)
+			m_pNodes[Node].m_Value = NewValue;
+	}
+
+	// removes an address if it has the value
+	void Remove(const NETADDR *pAddr, int Value)
+	{
+		if(!m_NumNodes)
+			return;
+		int *pLink = FindLink(pAddr);
+		int Node = *pLink;
+		if(Node == -1 || m_pNodes[Node].m_Value != Value)
+			return;
+		*pLink = m_pNodes[Node].m_Next;
+		m_pNodes[Node].m_Next = m_FirstFree;
+		m_FirstFree = Node;
+		m_NumNodes--;
+	}
+};
+
+// grows an array to hold at least Num elements, keeps the old ones
+template<class T>
+static void GrowArray(T **ppArray, int *pMaxNum, int Num)
+{
+	if(Num <= *pMaxNum)
+		return;
+	int MaxNum = max(*pMaxNum*2, (int)MIN_SERVERS);
+	T *pArray = (T *)mem_alloc(MaxNum*sizeof(T), 1);
+	if(*ppArray)
+	{
+		mem_copy(pArray, *ppArray, *pMaxNum*sizeof(T));
+		mem_free(*ppArray);
+	}
+	*ppArray = pArray;
+	*pMaxNum = MaxNum;
+}
+
 struct CCheckServer
 {
 	enum ServerType m_Type;
@@ -31,44 +185,51 @@ struct CCheckServer
 	int64 m_TryTime;
 };
 
-static CCheckServer m_aCheckServers[MAX_SERVERS];
+static CCheckServer *m_pCheckServers = 0;
 static int m_NumCheckServers = 0;
+static int m_MaxCheckServers = 0;
+static CAddrIndex m_CheckServerIndex; // address and alt address to check server
 
 struct CServerEntry
 {
-	enum ServerType m_Type;
 	NETADDR m_Address;
 	int64 m_Expire;
 };
 
-static CServerEntry m_aServers[MAX_SERVERS];
-static int m_NumServers = 0;
-
 struct CPacketData
 {
 	int m_Size;
-	struct {
-		unsigned char m_aHeader[sizeof(SERVERBROWSE_LIST)];
-		CMastersrvAddr m_aServers[MAX_SERVERS_PER_PACKET];
-	} m_Data;
+	unsigned char m_aData[sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*MAX_SERVERS_PER_PACKET];
 };
 
-CPacketData m_aPackets[MAX_PACKETS];
-static int m_NumPackets = 0;
-
-// legacy code
-struct CPacketDataLegacy
+/*
+	The registered servers of one type. The list packets are kept up to
+	date as servers come and go: server i is entry i%MAX_SERVERS_PER_PACKET
+	of packet i/MAX_SERVERS_PER_PACKET, removing a server moves the last
+	one into its place.
+*/
+struct CServerList
 {
-	int m_Size;
-	struct {
-		unsigned char m_aHeader[sizeof(SERVERBROWSE_LIST_LEGACY)];
-		CMastersrvAddrLegacy m_aServers[MAX_SERVERS_PER_PACKET];
-	} m_Data;
+	const unsigned char *m_pHeader;
+	int m_AddrSize;
+
+	CServerEntry *m_pServers;
+	int m_NumServers;
+	int m_MaxServers;
+
+	CPacketData *m_pPackets;
+	int m_MaxPackets;
+
+	int NumPackets() const { return (m_NumServers+MAX_SERVERS_PER_PACKET-1)/MAX_SERVERS_PER_PACKET; }
 };
 
-CPacketDataLegacy m_aPacketsLegacy[MAX_PACKETS];
-static int m_NumPacketsLegacy = 0;
+static CServerList m_aServerLists[NUM_SERVERTYPES];
+static CAddrIndex m_ServerIndex; // address to server index*NUM_SERVERTYPES+type
 
+static int NumServers()
+{
+	return m_aServerLists[SERVERTYPE_NORMAL].m_NumServers + m_aServerLists[SERVERTYPE_LEGACY].m_NumServers;
+}
 
 struct CCountPacketData
 {
@@ -88,83 +249,59 @@ static CNetClient m_NetOp; // main
 
 IConsole *m_pConsole;
 
-void BuildPackets()
+void PackServer(CServerList *pList, int Index)
 {
-	CServerEntry *pCurrent = &m_aServers[0];
-	int ServersLeft = m_NumServers;
-	m_NumPackets = 0;
-	m_NumPacketsLegacy = 0;
-	int PacketIndex = 0;
-	int PacketIndexLegacy = 0;
-	while(ServersLeft-- && (m_NumPackets + m_NumPacketsLegacy) < MAX_PACKETS)
-	{
-		if(pCurrent->m_Type == SERVERTYPE_NORMAL)
-		{
-			if(PacketIndex % MAX_SERVERS_PER_PACKET == 0)
-			{
-				PacketIndex = 0;
-				m_NumPackets++;
-			}
-
-			// copy header
-			mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aHeader, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST));
-
-			// copy server addresses
-			if(pCurrent->m_Address.type == NETTYPE_IPV6)
-			{
-				mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp, pCurrent->m_Address.ip,
-					sizeof(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp));
-			}
-			else
-			{
-				static unsigned char IPV4Mapping[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF };
-
-				mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp, IPV4Mapping, sizeof(IPV4Mapping));
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[12] = pCurrent->m_Address.ip[0];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[13] = pCurrent->m_Address.ip[1];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[14] = pCurrent->m_Address.ip[2];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[15] = pCurrent->m_Address.ip[3];
-			}
+	CPacketData *pPacket = &pList->m_pPackets[Index/MAX_SERVERS_PER_PACKET];
+	unsigned char *pAddr = &pPacket->m_aData[sizeof(SERVERBROWSE_LIST) + pList->m_AddrSize*(Index%MAX_SERVERS_PER_PACKET)];
+	const NETADDR *pAddress = &pList->m_pServers[Index].m_Address;
 
-			m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aPort[0] = (pCurrent->m_Address.port>>8)&0xff;
-			m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aPort[1] = pCurrent->m_Address.port&0xff;
-
-			PacketIndex++;
-
-			m_aPackets[m_NumPackets-1].m_Size = sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*PacketIndex;
-
-			pCurrent++;
-		}
-		else if(pCurrent->m_Type == SERVERTYPE_LEGACY)
-		{
-			if(PacketIndexLegacy % MAX_SERVERS_PER_PACKET == 0)
-			{
-				PacketIndexLegacy = 0;
-				m_NumPacketsLegacy++;
-			}
-
-			// copy header
-			mem_copy(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aHeader, SERVERBROWSE_LIST_LEGACY, sizeof(SERVERBROWSE_LIST_LEGACY));
+	if(pList == &m_aServerLists[SERVERTYPE_LEGACY])
+	{
+		CMastersrvAddrLegacy *pLegacy = (CMastersrvAddrLegacy *)pAddr;
+		mem_copy(pLegacy->m_aIp, pAddress->ip, sizeof(pLegacy->m_aIp));
+		// 0.5 has the port in little endian on the network
+		pLegacy->m_aPort[0] = pAddress->port&0xff;
+		pLegacy->m_aPort[1] = (pAddress->port>>8)&0xff;
+		return;
+	}
 
-			// copy server addresses
-			mem_copy(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aIp, pCurrent->m_Address.ip,
-				sizeof(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aIp));
-			// 0.5 has the port in little endian on the network
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aPort[0] = pCurrent->m_Address.port&0xff;
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aPort[1] = (pCurrent->m_Address.port>>8)&0xff;
+	CMastersrvAddr *pNormal = (CMastersrvAddr *)pAddr;
+	if(pAddress->type == NETTYPE_IPV6)
+		mem_copy(pNormal->m_aIp, pAddress->ip, sizeof(pNormal->m_aIp));
+	else
+	{
+		static unsigned char IPV4Mapping[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF };
 
-			PacketIndexLegacy++;
+		mem_copy(pNormal->m_aIp, IPV4Mapping, sizeof(IPV4Mapping));
+		mem_copy(&pNormal->m_aIp[12], pAddress->ip, 4);
+	}
+	pNormal->m_aPort[0] = (pAddress->port>>8)&0xff;
+	pNormal->m_aPort[1] = pAddress->port&0xff;
+}
 
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Size = sizeof(SERVERBROWSE_LIST_LEGACY) + sizeof(CMastersrvAddrLegacy)*PacketIndexLegacy;
+void UpdatePacketSize(CServerList *pList)
+{
+	// only the last packet changes its size
+	if(!pList->m_NumServers)
+		return;
+	int Last = pList->NumPackets()-1;
+	int Num = pList->m_NumServers - Last*MAX_SERVERS_PER_PACKET;
+	pList->m_pPackets[Last].m_Size = sizeof(SERVERBROWSE_LIST) + pList->m_AddrSize*Num;
+}
 
-			pCurrent++;
-		}
-		else
-		{
-			*pCurrent = m_aServers[m_NumServers-1];
-			m_NumServers--;
-			dbg_msg("mastersrv", "error: server of invalid type, dropping it");
-		}
+void InitServerLists()
+{
+	m_aServerLists[SERVERTYPE_NORMAL].m_pHeader = SERVERBROWSE_LIST;
+	m_aServerLists[SERVERTYPE_NORMAL].m_AddrSize = sizeof(CMastersrvAddr);
+	m_aServerLists[SERVERTYPE_LEGACY].m_pHeader = SERVERBROWSE_LIST_LEGACY;
+	m_aServerLists[SERVERTYPE_LEGACY].m_AddrSize = sizeof(CMastersrvAddrLegacy);
+	for(int i = 0; i < NUM_SERVERTYPES; i++)
+	{
+		m_aServerLists[i].m_pServers = 0;
+		m_aServerLists[i].m_NumServers = 0;
+		m_aServerLists[i].m_MaxServers = 0;
+		m_aServerLists[i].m_pPackets = 0;
+		m_aServerLists[i].m_MaxPackets = 0;
 	}
 }
 
@@ -206,87 +343,130 @@ void SendCheck(NETADDR *pAddr)
 
 void AddCheckserver(NETADDR *pInfo, NETADDR *pAlt, ServerType Type)
 {
-	// add server
-	if(m_NumCheckServers == MAX_SERVERS)
-	{
-		dbg_msg("mastersrv", "error: mastersrv is full");
+	// heartbeats of servers that are checked already don't need another check
+	if(m_CheckServerIndex.Find(pInfo) != -1)
 		return;
-	}
 
 	char aAddrStr[NETADDR_MAXSTRSIZE];
 	net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
 	char aAltAddrStr[NETADDR_MAXSTRSIZE];
 	net_addr_str(pAlt, aAltAddrStr, sizeof(aAltAddrStr), true);
 	dbg_msg("mastersrv", "checking: %s (%s)", aAddrStr, aAltAddrStr);
-	m_aCheckServers[m_NumCheckServers].m_Address = *pInfo;
-	m_aCheckServers[m_NumCheckServers].m_AltAddress = *pAlt;
-	m_aCheckServers[m_NumCheckServers].m_TryCount = 0;
-	m_aCheckServers[m_NumCheckServers].m_TryTime = 0;
-	m_aCheckServers[m_NumCheckServers].m_Type = Type;
+
+	// add server
+	GrowArray(&m_pCheckServers, &m_MaxCheckServers, m_NumCheckServers+1);
+	CCheckServer *pCheck = &m_pCheckServers[m_NumCheckServers];
+	pCheck->m_Address = *pInfo;
+	pCheck->m_AltAddress = *pAlt;
+	pCheck->m_TryCount = 0;
+	pCheck->m_TryTime = 0;
+	pCheck->m_Type = Type;
+	m_CheckServerIndex.Insert(pInfo, m_NumCheckServers);
+	if(m_CheckServerIndex.Find(pAlt) == -1)
+		m_CheckServerIndex.Insert(pAlt, m_NumCheckServers);
 	m_NumCheckServers++;
 }
 
+void RemoveCheckserver(int Index)
+{
+	m_CheckServerIndex.Remove(&m_pCheckServers[Index].m_Address, Index);
+	m_CheckServerIndex.Remove(&m_pCheckServers[Index].m_AltAddress, Index);
+
+	// move the last one into the gap
+	int Last = m_NumCheckServers-1;
+	if(Index != Last)
+	{
+		m_pCheckServers[Index] = m_pCheckServers[Last];
+		m_CheckServerIndex.Replace(&m_pCheckServers[Index].m_Address, Last, Index);
+		m_CheckServerIndex.Replace(&m_pCheckServers[Index].m_AltAddress, Last, Index);
+	}
+	m_NumCheckServers--;
+}
+
 void AddServer(NETADDR *pInfo, ServerType Type)
 {
+	char aAddrStr[NETADDR_MAXSTRSIZE];
+	net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
+
 	// see if server already exists in list
-	for(int i = 0; i < m_NumServers; i++)
+	int Found = m_ServerIndex.Find(pInfo);
+	if(Found != -1)
 	{
-		if(net_addr_comp(&m_aServers[i].m_Address, pInfo) == 0)
-		{
-			char aAddrStr[NETADDR_MAXSTRSIZE];
-			net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
-			dbg_msg("mastersrv", "updated: %s", aAddrStr);
-			m_aServers[i].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
-			return;
-		}
+		dbg_msg("mastersrv", "updated: %s", aAddrStr);
+		m_aServerLists[Found%NUM_SERVERTYPES].m_pServers[Found/NUM_SERVERTYPES].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
+		return;
 	}
 
 	// add server
-	if(m_NumServers == MAX_SERVERS)
+	CServerList *pList = &m_aServerLists[Type];
+	int Index = pList->m_NumServers;
+	GrowArray(&pList->m_pServers, &pList->m_MaxServers, Index+1);
+	if(Index%MAX_SERVERS_PER_PACKET == 0)
 	{
-		dbg_msg("mastersrv", "error: mastersrv is full");
-		return;
+		int Packet = Index/MAX_SERVERS_PER_PACKET;
+		GrowArray(&pList->m_pPackets, &pList->m_MaxPackets, Packet+1);
+		mem_copy(pList->m_pPackets[Packet].m_aData, pList->m_pHeader, sizeof(SERVERBROWSE_LIST));
 	}
 
-	char aAddrStr[NETADDR_MAXSTRSIZE];
-	net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
 	dbg_msg("mastersrv", "added: %s", aAddrStr);
-	m_aServers[m_NumServers].m_Address = *pInfo;
-	m_aServers[m_NumServers].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
-	m_aServers[m_NumServers].m_Type = Type;
-	m_NumServers++;
+	pList->m_pServers[Index].m_Address = *pInfo;
+	pList->m_pServers[Index].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
+	pList->m_NumServers++;
+	m_ServerIndex.Insert(pInfo, Index*NUM_SERVERTYPES+Type);
+	PackServer(pList, Index);
+	UpdatePacketSize(pList);
+}
+
+void RemoveServer(int Type, int Index)
+{
+	CServerList *pList = &m_aServerLists[Type];
+	m_ServerIndex.Remove(&pList->m_pServers[Index].m_Address, Index*NUM_SERVERTYPES+Type);
+
+	// move the last one into the gap, in the list and in the packets
+	int Last = pList->m_NumServers-1;
+	if(Index != Last)
+	{
+		pList->m_pServers[Index] = pList->m_pServers[Last];
+		m_ServerIndex.Replace(&pList->m_pServers[Index].m_Address, Last*NUM_SERVERTYPES+Type, Index*NUM_SERVERTYPES+Type);
+		PackServer(pList, Index);
+	}
+	pList->m_NumServers--;
+	UpdatePacketSize(pList);
 }
 
 void UpdateServers()
 {
 	int64 Now = time_get();
 	int64 Freq = time_freq();
-	for(int i = 0; i < m_NumCheckServers; i++)
+	int NumChecks = 0;
+	for(int i = 0; i < m_NumCheckServers && NumChecks < MAX_CHECKS_PER_UPDATE; i++)
 	{
-		if(Now > m_aCheckServers[i].m_TryTime+Freq)
+		CCheckServer *pCheck = &m_pCheckServers[i];
+		// retry every 5 seconds, a server fails after 10 tries
+		if(Now > pCheck->m_TryTime+Freq*5)
 		{
-			if(m_aCheckServers[i].m_TryCount == 10)
+			NumChecks++;
+			if(pCheck->m_TryCount == 10)
 			{
 				char aAddrStr[NETADDR_MAXSTRSIZE];
-				net_addr_str(&m_aCheckServers[i].m_Address, aAddrStr, sizeof(aAddrStr), true);
+				net_addr_str(&pCheck->m_Address, aAddrStr, sizeof(aAddrStr), true);
 				char aAltAddrStr[NETADDR_MAXSTRSIZE];
-				net_addr_str(&m_aCheckServers[i].m_AltAddress, aAltAddrStr, sizeof(aAltAddrStr), true);
+				net_addr_str(&pCheck->m_AltAddress, aAltAddrStr, sizeof(aAltAddrStr), true);
 				dbg_msg("mastersrv", "check failed: %s (%s)", aAddrStr, aAltAddrStr);
 
 				// FAIL!!
-				SendError(&m_aCheckServers[i].m_Address);
-				m_aCheckServers[i] = m_aCheckServers[m_NumCheckServers-1];
-				m_NumCheckServers--;
+				SendError(&pCheck->m_Address);
+				RemoveCheckserver(i);
 				i--;
 			}
 			else
 			{
-				m_aCheckServers[i].m_TryCount++;
-				m_aCheckServers[i].m_TryTime = Now;
-				if(m_aCheckServers[i].m_TryCount&1)
-					SendCheck(&m_aCheckServers[i].m_Address);
+				pCheck->m_TryCount++;
+				pCheck->m_TryTime = Now;
+				if(pCheck->m_TryCount&1)
+					SendCheck(&pCheck->m_Address);
 				else
-					SendCheck(&m_aCheckServers[i].m_AltAddress);
+					SendCheck(&pCheck->m_AltAddress);
 			}
 		}
 	}
@@ -295,20 +475,23 @@ void UpdateServers()
 void PurgeServers()
 {
 	int64 Now = time_get();
-	int i = 0;
-	while(i < m_NumServers)
+	for(int t = 0; t < NUM_SERVERTYPES; t++)
 	{
-		if(m_aServers[i].m_Expire < Now)
+		CServerList *pList = &m_aServerLists[t];
+		int i = 0;
+		while(i < pList->m_NumServers)
 		{
-			// remove server
-			char aAddrStr[NETADDR_MAXSTRSIZE];
-			net_addr_str(&m_aServers[i].m_Address, aAddrStr, sizeof(aAddrStr), true);
-			dbg_msg("mastersrv", "expired: %s", aAddrStr);
-			m_aServers[i] = m_aServers[m_NumServers-1];
-			m_NumServers--;
+			if(pList->m_pServers[i].m_Expire < Now)
+			{
+				// remove server
+				char aAddrStr[NETADDR_MAXSTRSIZE];
+				net_addr_str(&pList->m_pServers[i].m_Address, aAddrStr, sizeof(aAddrStr), true);
+				dbg_msg("mastersrv", "expired: %s", aAddrStr);
+				RemoveServer(t, i);
+			}
+			else
+				i++;
 		}
-		else
-			i++;
 	}
 }
 
@@ -320,13 +503,14 @@ void ReloadBans()
 
 int main(int argc, const char **argv) // ignore_convention
 {
-	int64 LastBuild = 0, LastBanReload = 0;
+	int64 LastPurge = 0, LastBanReload = 0;
 	ServerType Type = SERVERTYPE_INVALID;
 	NETADDR BindAddr;
 
 	dbg_logger_stdout();
 	net_init();
 
+	InitServerLists();
 	mem_copy(m_CountData.m_Header, SERVERBROWSE_COUNT, sizeof(SERVERBROWSE_COUNT));
 	mem_copy(m_CountDataLegacy.m_Header, SERVERBROWSE_COUNT_LEGACY, sizeof(SERVERBROWSE_COUNT_LEGACY));
 
@@ -420,7 +604,7 @@ int main(int argc, const char **argv) // ignore_convention
 			else if(Packet.m_DataSize == sizeof(SERVERBROWSE_GETCOUNT) &&
 				mem_comp(Packet.m_pData, SERVERBROWSE_GETCOUNT, sizeof(SERVERBROWSE_GETCOUNT)) == 0)
 			{
-				dbg_msg("mastersrv", "count requested, responding with %d", m_NumServers);
+				dbg_msg("mastersrv", "count requested, responding with %d", NumServers());
 
 				CNetChunk p;
 				p.m_ClientID = -1;
@@ -428,14 +612,15 @@ int main(int argc, const char **argv) // ignore_convention
 				p.m_Flags = NETSENDFLAG_CONNLESS;
 				p.m_DataSize = sizeof(m_CountData);
 				p.m_pData = &m_CountData;
-				m_CountData.m_High = (m_NumServers>>8)&0xff;
-				m_CountData.m_Low = m_NumServers&0xff;
+				int Count = min(NumServers(), 0xffff);
+				m_CountData.m_High = (Count>>8)&0xff;
+				m_CountData.m_Low = Count&0xff;
 				m_NetOp.Send(&p);
 			}
 			else if(Packet.m_DataSize == sizeof(SERVERBROWSE_GETCOUNT_LEGACY) &&
 				mem_comp(Packet.m_pData, SERVERBROWSE_GETCOUNT_LEGACY, sizeof(SERVERBROWSE_GETCOUNT_LEGACY)) == 0)
 			{
-				dbg_msg("mastersrv", "count requested, responding with %d", m_NumServers);
+				dbg_msg("mastersrv", "count requested, responding with %d", NumServers());
 
 				CNetChunk p;
 				p.m_ClientID = -1;
@@ -443,25 +628,27 @@ int main(int argc, const char **argv) // ignore_convention
 				p.m_Flags = NETSENDFLAG_CONNLESS;
 				p.m_DataSize = sizeof(m_CountData);
 				p.m_pData = &m_CountDataLegacy;
-				m_CountDataLegacy.m_High = (m_NumServers>>8)&0xff;
-				m_CountDataLegacy.m_Low = m_NumServers&0xff;
+				int Count = min(NumServers(), 0xffff);
+				m_CountDataLegacy.m_High = (Count>>8)&0xff;
+				m_CountDataLegacy.m_Low = Count&0xff;
 				m_NetOp.Send(&p);
 			}
 			else if(Packet.m_DataSize == sizeof(SERVERBROWSE_GETLIST) &&
 				mem_comp(Packet.m_pData, SERVERBROWSE_GETLIST, sizeof(SERVERBROWSE_GETLIST)) == 0)
 			{
 				// someone requested the list
-				dbg_msg("mastersrv", "requested, responding with %d m_aServers", m_NumServers);
+				dbg_msg("mastersrv", "requested, responding with %d m_aServers", NumServers());
 
 				CNetChunk p;
 				p.m_ClientID = -1;
 				p.m_Address = Packet.m_Address;
 				p.m_Flags = NETSENDFLAG_CONNLESS;
 
-				for(int i = 0; i < m_NumPackets; i++)
+				CServerList *pList = &m_aServerLists[SERVERTYPE_NORMAL];
+				for(int i = 0; i < pList->NumPackets(); i++)
 				{
-					p.m_DataSize = m_aPackets[i].m_Size;
-					p.m_pData = &m_aPackets[i].m_Data;
+					p.m_DataSize = pList->m_pPackets[i].m_Size;
+					p.m_pData = pList->m_pPackets[i].m_aData;
 					m_NetOp.Send(&p);
 				}
 			}
@@ -469,17 +656,18 @@ int main(int argc, const char **argv) // ignore_convention
 				mem_comp(Packet.m_pData, SERVERBROWSE_GETLIST_LEGACY, sizeof(SERVERBROWSE_GETLIST_LEGACY)) == 0)
 			{
 				// someone requested the list
-				dbg_msg("mastersrv", "requested, responding with %d m_aServers", m_NumServers);
+				dbg_msg("mastersrv", "requested, responding with %d m_aServers", NumServers());
 
 				CNetChunk p;
 				p.m_ClientID = -1;
 				p.m_Address = Packet.m_Address;
 				p.m_Flags = NETSENDFLAG_CONNLESS;
 
-				for(int i = 0; i < m_NumPacketsLegacy; i++)
+				CServerList *pList = &m_aServerLists[SERVERTYPE_LEGACY];
+				for(int i = 0; i < pList->NumPackets(); i++)
 				{
-					p.m_DataSize = m_aPacketsLegacy[i].m_Size;
-					p.m_pData = &m_aPacketsLegacy[i].m_Data;
+					p.m_DataSize = pList->m_pPackets[i].m_Size;
+					p.m_pData = pList->m_pPackets[i].m_aData;
 					m_NetOp.Send(&p);
 				}
 			}
@@ -497,16 +685,11 @@ int main(int argc, const char **argv) // ignore_convention
 			{
 				Type = SERVERTYPE_INVALID;
 				// remove it from checking
-				for(int i = 0; i < m_NumCheckServers; i++)
+				int Check = m_CheckServerIndex.Find(&Packet.m_Address);
+				if(Check != -1)
 				{
-					if(net_addr_comp(&m_aCheckServers[i].m_Address, &Packet.m_Address) == 0 ||
-						net_addr_comp(&m_aCheckServers[i].m_AltAddress, &Packet.m_Address) == 0)
-					{
-						Type = m_aCheckServers[i].m_Type;
-						m_NumCheckServers--;
-						m_aCheckServers[i] = m_aCheckServers[m_NumCheckServers];
-						break;
-					}
+					Type = m_pCheckServers[Check].m_Type;
+					RemoveCheckserver(Check);
 				}
 
 				// drops servers that were not in the CheckServers list
@@ -525,15 +708,15 @@ int main(int argc, const char **argv) // ignore_convention
 			ReloadBans();
 		}
 
-		if(time_get()-LastBuild > time_freq()*5)
+		if(time_get()-LastPurge > time_freq()*5)
 		{
-			LastBuild = time_get();
+			LastPurge = time_get();
 
 			PurgeServers();
-			UpdateServers();
-			BuildPackets();
 		}
 
+		UpdateServers();
+
 		// be nice to the CPU
 		thread_sleep(1);
 	}
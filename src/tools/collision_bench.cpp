@@ -0,0 +1,347 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdlib.h>
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/storage.h>
+
+#include <game/collision.h>
+#include <game/layers.h>
+
+// compares CCollision::IntersectLine, MovePoint and MoveBox with the old versions
+// on random lines and points over real maps and times both
+
+enum
+{
+	NUM_LINES=200000,
+	NUM_POINTS=1000000,
+	NUM_BOXES=200000,
+};
+
+static const vec2 s_BoxSize = vec2(28.0f, 28.0f);
+
+namespace Reference
+{
+	int IntersectLine(CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+	{
+		float Distance = distance(Pos0, Pos1);
+		int End(Distance+1);
+		vec2 Last = Pos0;
+
+		for(int i = 0; i < End; i++)
+		{
+			float a = i/Distance;
+			vec2 Pos = mix(Pos0, Pos1, a);
+			if(pCollision->CheckPoint(Pos.x, Pos.y))
+			{
+				if(pOutCollision)
+					*pOutCollision = Pos;
+				if(pOutBeforeCollision)
+					*pOutBeforeCollision = Last;
+				return pCollision->GetCollisionAt(Pos.x, Pos.y);
+			}
+			Last = Pos;
+		}
+		if(pOutCollision)
+			*pOutCollision = Pos1;
+		if(pOutBeforeCollision)
+			*pOutBeforeCollision = Pos1;
+		return 0;
+	}
+
+	void MovePoint(CCollision *pCollision, vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, int *pBounces)
+	{
+		if(pBounces)
+			*pBounces = 0;
+
+		vec2 Pos = *pInoutPos;
+		vec2 Vel = *pInoutVel;
+		if(pCollision->CheckPoint(Pos + Vel))
+		{
+			int Affected = 0;
+			if(pCollision->CheckPoint(Pos.x + Vel.x, Pos.y))
+			{
+				pInoutVel->x *= -Elasticity;
+				if(pBounces)
+					(*pBounces)++;
+				Affected++;
+			}
+
+			if(pCollision->CheckPoint(Pos.x, Pos.y + Vel.y))
+			{
+				pInoutVel->y *= -Elasticity;
+				if(pBounces)
+					(*pBounces)++;
+				Affected++;
+			}
+
+			if(Affected == 0)
+			{
+				pInoutVel->x *= -Elasticity;
+				pInoutVel->y *= -Elasticity;
+			}
+		}
+		else
+		{
+			*pInoutPos = Pos + Vel;
+		}
+	}
+
+	bool TestBox(CCollision *pCollision, vec2 Pos, vec2 Size)
+	{
+		Size *= 0.5f;
+		if(pCollision->CheckPoint(Pos.x-Size.x, Pos.y-Size.y))
+			return true;
+		if(pCollision->CheckPoint(Pos.x+Size.x, Pos.y-Size.y))
+			return true;
+		if(pCollision->CheckPoint(Pos.x-Size.x, Pos.y+Size.y))
+			return true;
+		if(pCollision->CheckPoint(Pos.x+Size.x, Pos.y+Size.y))
+			return true;
+		return false;
+	}
+
+	void MoveBox(CCollision *pCollision, vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity)
+	{
+		vec2 Pos = *pInoutPos;
+		vec2 Vel = *pInoutVel;
+
+		float Distance = length(Vel);
+		int Max = (int)Distance;
+
+		if(Distance > 0.00001f)
+		{
+			float Fraction = 1.0f/(float)(Max+1);
+			for(int i = 0; i <= Max; i++)
+			{
+				vec2 NewPos = Pos + Vel*Fraction;
+
+				if(TestBox(pCollision, vec2(NewPos.x, NewPos.y), Size))
+				{
+					int Hits = 0;
+
+					if(TestBox(pCollision, vec2(Pos.x, NewPos.y), Size))
+					{
+						NewPos.y = Pos.y;
+						Vel.y *= -Elasticity;
+						Hits++;
+					}
+
+					if(TestBox(pCollision, vec2(NewPos.x, Pos.y), Size))
+					{
+						NewPos.x = Pos.x;
+						Vel.x *= -Elasticity;
+						Hits++;
+					}
+
+					if(Hits == 0)
+					{
+						NewPos.y = Pos.y;
+						Vel.y *= -Elasticity;
+						NewPos.x = Pos.x;
+						Vel.x *= -Elasticity;
+					}
+				}
+
+				Pos = NewPos;
+			}
+		}
+
+		*pInoutPos = Pos;
+		*pInoutVel = Vel;
+	}
+}
+
+static vec2 s_aLineStart[NUM_LINES];
+static vec2 s_aLineEnd[NUM_LINES];
+static vec2 s_aPointPos[NUM_POINTS];
+static vec2 s_aPointVel[NUM_POINTS];
+static vec2 s_aBoxPos[NUM_BOXES];
+
+static void GenerateInput(CCollision *pCollision)
+{
+	// lines and points all over the map and a bit outside, lengths up to a long laser
+	float Width = pCollision->GetWidth()*32.0f;
+	float Height = pCollision->GetHeight()*32.0f;
+	srand(1);
+	for(int i = 0; i < NUM_LINES; i++)
+	{
+		s_aLineStart[i] = vec2(frandom()*(Width+256.0f)-128.0f, frandom()*(Height+256.0f)-128.0f);
+		float Angle = frandom()*2.0f*pi;
+		float Length = (i%16) == 0 ? frandom()*2.0f : frandom()*1000.0f;
+		s_aLineEnd[i] = s_aLineStart[i] + vec2(cosf(Angle), sinf(Angle))*Length;
+	}
+	for(int i = 0; i < NUM_POINTS; i++)
+	{
+		s_aPointPos[i] = vec2(frandom()*Width, frandom()*Height);
+		s_aPointVel[i] = vec2(frandom()*20.0f-10.0f, frandom()*20.0f-10.0f);
+	}
+	for(int i = 0; i < NUM_BOXES; i++)
+	{
+		// boxes start in free space like tees do
+		do
+			s_aBoxPos[i] = vec2(frandom()*Width, frandom()*Height);
+		while(pCollision->TestBox(s_aBoxPos[i], s_BoxSize));
+	}
+}
+
+static bool CheckMap(CCollision *pCollision, const char *pMap)
+{
+	GenerateInput(pCollision);
+
+	// results have to be the same
+	int NumErrors = 0;
+	int NumHits = 0;
+	for(int i = 0; i < NUM_LINES; i++)
+	{
+		vec2 aCol[2], aBefore[2];
+		int Ref = Reference::IntersectLine(pCollision, s_aLineStart[i], s_aLineEnd[i], &aCol[0], &aBefore[0]);
+		int Cur = pCollision->IntersectLine(s_aLineStart[i], s_aLineEnd[i], &aCol[1], &aBefore[1]);
+		if(Ref)
+			NumHits++;
+		if(Ref != Cur || !(aCol[0] == aCol[1]) || !(aBefore[0] == aBefore[1]))
+		{
+			if(NumErrors++ < 10)
+				dbg_msg("collision_bench", "%s: line (%f %f)-(%f %f): %d (%f %f) (%f %f) != %d (%f %f) (%f %f)", pMap,
+					s_aLineStart[i].x, s_aLineStart[i].y, s_aLineEnd[i].x, s_aLineEnd[i].y,
+					Ref, aCol[0].x, aCol[0].y, aBefore[0].x, aBefore[0].y, Cur, aCol[1].x, aCol[1].y, aBefore[1].x, aBefore[1].y);
+		}
+	}
+	for(int i = 0; i < NUM_POINTS; i++)
+	{
+		vec2 aPos[2] = { s_aPointPos[i], s_aPointPos[i] };
+		vec2 aVel[2] = { s_aPointVel[i], s_aPointVel[i] };
+		int aBounces[2];
+		Reference::MovePoint(pCollision, &aPos[0], &aVel[0], 0.5f, &aBounces[0]);
+		pCollision->MovePoint(&aPos[1], &aVel[1], 0.5f, &aBounces[1]);
+		if(!(aPos[0] == aPos[1]) || !(aVel[0] == aVel[1]) || aBounces[0] != aBounces[1])
+		{
+			if(NumErrors++ < 10)
+				dbg_msg("collision_bench", "%s: point (%f %f) vel (%f %f) moved differently", pMap,
+					s_aPointPos[i].x, s_aPointPos[i].y, s_aPointVel[i].x, s_aPointVel[i].y);
+		}
+	}
+	for(int i = 0; i < NUM_BOXES; i++)
+	{
+		// boxes move a bit faster than a running tee
+		vec2 aPos[2] = { s_aBoxPos[i], s_aBoxPos[i] };
+		vec2 aVel[2] = { s_aPointVel[i]*2.0f, s_aPointVel[i]*2.0f };
+		Reference::MoveBox(pCollision, &aPos[0], &aVel[0], s_BoxSize, 0.0f);
+		pCollision->MoveBox(&aPos[1], &aVel[1], s_BoxSize, 0.0f);
+		if(!(aPos[0] == aPos[1]) || !(aVel[0] == aVel[1]))
+		{
+			if(NumErrors++ < 10)
+				dbg_msg("collision_bench", "%s: box (%f %f) vel (%f %f) moved differently", pMap,
+					s_aBoxPos[i].x, s_aBoxPos[i].y, s_aPointVel[i].x*2.0f, s_aPointVel[i].y*2.0f);
+		}
+	}
+
+	// timing
+	int Checksum = 0;
+	int64 Start = time_get();
+	for(int i = 0; i < NUM_LINES; i++)
+		Checksum += Reference::IntersectLine(pCollision, s_aLineStart[i], s_aLineEnd[i], 0, 0);
+	int64 RefLineTime = time_get()-Start;
+	Start = time_get();
+	for(int i = 0; i < NUM_LINES; i++)
+		Checksum += pCollision->IntersectLine(s_aLineStart[i], s_aLineEnd[i], 0, 0);
+	int64 CurLineTime = time_get()-Start;
+
+	vec2 Pos, Vel;
+	Start = time_get();
+	for(int i = 0; i < NUM_POINTS; i++)
+	{
+		Pos = s_aPointPos[i];
+		Vel = s_aPointVel[i];
+		Reference::MovePoint(pCollision, &Pos, &Vel, 0.5f, 0);
+		Checksum += (int)Pos.x;
+	}
+	int64 RefPointTime = time_get()-Start;
+	Start = time_get();
+	for(int i = 0; i < NUM_POINTS; i++)
+	{
+		Pos = s_aPointPos[i];
+		Vel = s_aPointVel[i];
+		pCollision->MovePoint(&Pos, &Vel, 0.5f, 0);
+		Checksum += (int)Pos.x;
+	}
+	int64 CurPointTime = time_get()-Start;
+
+	Start = time_get();
+	for(int i = 0; i < NUM_BOXES; i++)
+	{
+		Pos = s_aBoxPos[i];
+		Vel = s_aPointVel[i]*2.0f;
+		Reference::MoveBox(pCollision, &Pos, &Vel, s_BoxSize, 0.0f);
+		Checksum += (int)Pos.x;
+	}
+	int64 RefBoxTime = time_get()-Start;
+	Start = time_get();
+	for(int i = 0; i < NUM_BOXES; i++)
+	{
+		Pos = s_aBoxPos[i];
+		Vel = s_aPointVel[i]*2.0f;
+		pCollision->MoveBox(&Pos, &Vel, s_BoxSize, 0.0f);
+		Checksum += (int)Pos.x;
+	}
+	int64 CurBoxTime = time_get()-Start;
+
+	dbg_msg("collision_bench", "%s: %d lines (%d hits), %d points, %d boxes, %d errors, checksum %d", pMap, NUM_LINES, NumHits, NUM_POINTS, NUM_BOXES, NumErrors, Checksum);
+	dbg_msg("collision_bench", "%s: IntersectLine reference %.1fns current %.1fns, MovePoint reference %.1fns current %.1fns", pMap,
+		RefLineTime*1000000000.0/time_freq()/NUM_LINES, CurLineTime*1000000000.0/time_freq()/NUM_LINES,
+		RefPointTime*1000000000.0/time_freq()/NUM_POINTS, CurPointTime*1000000000.0/time_freq()/NUM_POINTS);
+	dbg_msg("collision_bench", "%s: MoveBox reference %.1fns current %.1fns", pMap,
+		RefBoxTime*1000000000.0/time_freq()/NUM_BOXES, CurBoxTime*1000000000.0/time_freq()/NUM_BOXES);
+	return NumErrors == 0;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	IKernel *pKernel = IKernel::Create();
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv); // ignore_convention
+	IEngineMap *pEngineMap = CreateEngineMap();
+
+	bool RegisterFail = !pKernel->RegisterInterface(pStorage);
+	RegisterFail |= !pKernel->RegisterInterface(static_cast<IEngineMap*>(pEngineMap));
+	RegisterFail |= !pKernel->RegisterInterface(static_cast<IMap*>(pEngineMap));
+	if(RegisterFail)
+		return -1;
+
+	const char *apDefaultMaps[] = { "dm1", "dm2", "ctf1", "ctf2" };
+	const char **ppMaps = apDefaultMaps;
+	int NumMaps = sizeof(apDefaultMaps)/sizeof(apDefaultMaps[0]);
+	if(argc > 1) // ignore_convention
+	{
+		ppMaps = argv+1; // ignore_convention
+		NumMaps = argc-1; // ignore_convention
+	}
+
+	bool Success = true;
+	for(int m = 0; m < NumMaps; m++)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "maps/%s.map", ppMaps[m]);
+		if(!pEngineMap->Load(aBuf))
+		{
+			dbg_msg("collision_bench", "failed to load map '%s'", aBuf);
+			Success = false;
+			continue;
+		}
+
+		CLayers Layers;
+		CCollision Collision;
+		Layers.Init(pKernel);
+		Collision.Init(&Layers);
+		Success &= CheckMap(&Collision, ppMaps[m]);
+
+		pEngineMap->Unload();
+	}
+
+	return Success ? 0 : 1;
+}
@@ -1,5 +1,6 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 
 #include <cstdlib>
@@ -35,9 +36,13 @@ static CPingConfig m_aConfigPings[] = {
 		{0,		0,		0,		0,		0,		0},
 		{40,	20,		100,		0,		0,		0},
 		{140,	40,		200,		0,		0,		0},
+		// loss profiles, to check how the resends cope
+		{40,	10,		0,		5,		0,		0},
+		{80,	20,		0,		15,		0,		0},
 };
 
 static int m_ConfigNumpingconfs = sizeof(m_aConfigPings)/sizeof(CPingConfig);
+static int m_ConfigFixed = -1; // only use this pingconfig
 static int m_ConfigInterval = 10; // seconds between different pingconfigs
 static int m_ConfigLog = 0;
 static int m_ConfigReorder = 0;
@@ -55,6 +60,8 @@ void Run(unsigned short Port, NETADDR Dest)
 	{
 		static int Lastcfg = 0;
 		int n = ((time_get()/time_freq())/m_ConfigInterval) % m_ConfigNumpingconfs;
+		if(m_ConfigFixed >= 0)
+			n = m_ConfigFixed;
 		CPingConfig Ping = m_aConfigPings[n];
 
 		if(n != Lastcfg)
@@ -210,6 +217,10 @@ int main(int argc, char **argv) // ignore_convention
 {
 	NETADDR Addr = {NETTYPE_IPV4, {127,0,0,1},8303};
 	dbg_logger_stdout();
+
+	// crapnet [pingconfig]
+	if(argc > 1) // ignore_convention
+		m_ConfigFixed = clamp(str_toint(argv[1]), 0, m_ConfigNumpingconfs-1); // ignore_convention
 	Run(8302, Addr);
 	return 0;
 }
@@ -0,0 +1,362 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/storage.h>
+#include <engine/shared/config.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/network.h>
+#include <engine/shared/snapshot.h>
+
+#include <game/generated/protocol.h>
+
+/*
+	Replays demos and checks every snapshot through the snapshot delta code
+	against the reference implementation below, which is the delta code as
+	it was before the hashed index. Deltas have to be bit-identical and both
+	have to unpack to the same snapshot.
+*/
+
+// reference implementation
+namespace Reference
+{
+	struct CItemList
+	{
+		int m_Num;
+		int m_aKeys[64];
+		int m_aIndex[64];
+	};
+
+	enum
+	{
+		HASHLIST_SIZE = 256,
+	};
+
+	static int s_aItemSizes[64];
+
+	static void GenerateHash(CItemList *pHashlist, CSnapshot *pSnapshot)
+	{
+		for(int i = 0; i < HASHLIST_SIZE; i++)
+			pHashlist[i].m_Num = 0;
+
+		for(int i = 0; i < pSnapshot->NumItems(); i++)
+		{
+			int Key = pSnapshot->GetItem(i)->Key();
+			int HashID = ((Key>>12)&0xf0) | (Key&0xf);
+			if(pHashlist[HashID].m_Num != 64)
+			{
+				pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
+				pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
+				pHashlist[HashID].m_Num++;
+			}
+		}
+	}
+
+	static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
+	{
+		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
+		for(int i = 0; i < pHashlist[HashID].m_Num; i++)
+		{
+			if(pHashlist[HashID].m_aKeys[i] == Key)
+				return pHashlist[HashID].m_aIndex[i];
+		}
+		return -1;
+	}
+
+	static int DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
+	{
+		int Needed = 0;
+		while(Size)
+		{
+			*pOut = *pCurrent-*pPast;
+			Needed |= *pOut;
+			pOut++;
+			pPast++;
+			pCurrent++;
+			Size--;
+		}
+		return Needed;
+	}
+
+	static int CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
+	{
+		CSnapshotDelta::CData *pDelta = (CSnapshotDelta::CData *)pDstData;
+		int *pData = (int *)pDelta->m_pData;
+
+		pDelta->m_NumDeletedItems = 0;
+		pDelta->m_NumUpdateItems = 0;
+		pDelta->m_NumTempItems = 0;
+
+		static CItemList s_aHashlist[HASHLIST_SIZE];
+		GenerateHash(s_aHashlist, pTo);
+
+		for(int i = 0; i < pFrom->NumItems(); i++)
+		{
+			CSnapshotItem *pFromItem = pFrom->GetItem(i);
+			if(GetItemIndexHashed(pFromItem->Key(), s_aHashlist) == -1)
+			{
+				pDelta->m_NumDeletedItems++;
+				*pData++ = pFromItem->Key();
+			}
+		}
+
+		GenerateHash(s_aHashlist, pFrom);
+		int aPastIndecies[1024];
+		for(int i = 0; i < pTo->NumItems(); i++)
+			aPastIndecies[i] = GetItemIndexHashed(pTo->GetItem(i)->Key(), s_aHashlist);
+
+		for(int i = 0; i < pTo->NumItems(); i++)
+		{
+			int ItemSize = pTo->GetItemSize(i);
+			CSnapshotItem *pCurItem = pTo->GetItem(i);
+			int PastIndex = aPastIndecies[i];
+
+			if(PastIndex != -1)
+			{
+				int *pItemDataDst = pData+3;
+				CSnapshotItem *pPastItem = pFrom->GetItem(PastIndex);
+				if(s_aItemSizes[pCurItem->Type()])
+					pItemDataDst = pData+2;
+
+				if(DiffItem((int*)pPastItem->Data(), (int*)pCurItem->Data(), pItemDataDst, ItemSize/4))
+				{
+					*pData++ = pCurItem->Type();
+					*pData++ = pCurItem->ID();
+					if(!s_aItemSizes[pCurItem->Type()])
+						*pData++ = ItemSize/4;
+					pData += ItemSize/4;
+					pDelta->m_NumUpdateItems++;
+				}
+			}
+			else
+			{
+				*pData++ = pCurItem->Type();
+				*pData++ = pCurItem->ID();
+				if(!s_aItemSizes[pCurItem->Type()])
+					*pData++ = ItemSize/4;
+				mem_copy(pData, pCurItem->Data(), ItemSize);
+				pData += ItemSize/4;
+				pDelta->m_NumUpdateItems++;
+			}
+		}
+
+		if(!pDelta->m_NumDeletedItems && !pDelta->m_NumUpdateItems && !pDelta->m_NumTempItems)
+			return 0;
+
+		return (int)((char*)pData-(char*)pDstData);
+	}
+
+	static int UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData, int DataSize)
+	{
+		static CSnapshotBuilder s_Builder;
+		CSnapshotDelta::CData *pDelta = (CSnapshotDelta::CData *)pSrcData;
+		int *pData = (int *)pDelta->m_pData;
+		int *pEnd = (int *)(((char *)pSrcData + DataSize));
+
+		s_Builder.Init();
+
+		int *pDeleted = pData;
+		pData += pDelta->m_NumDeletedItems;
+		if(pData > pEnd)
+			return -1;
+
+		for(int i = 0; i < pFrom->NumItems(); i++)
+		{
+			CSnapshotItem *pFromItem = pFrom->GetItem(i);
+			int ItemSize = pFrom->GetItemSize(i);
+			int Keep = 1;
+			for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
+			{
+				if(pDeleted[d] == pFromItem->Key())
+				{
+					Keep = 0;
+					break;
+				}
+			}
+
+			if(Keep)
+				mem_copy(s_Builder.NewItem(pFromItem->Type(), pFromItem->ID(), ItemSize), pFromItem->Data(), ItemSize);
+		}
+
+		for(int i = 0; i < pDelta->m_NumUpdateItems; i++)
+		{
+			if(pData+2 > pEnd)
+				return -1;
+
+			int Type = *pData++;
+			if(Type < 0)
+				return -1;
+			int ID = *pData++;
+			int ItemSize;
+			if(s_aItemSizes[Type])
+				ItemSize = s_aItemSizes[Type];
+			else
+			{
+				if(pData+1 > pEnd)
+					return -2;
+				ItemSize = (*pData++) * 4;
+			}
+
+			if((char *)pData + ItemSize > (char *)pEnd || ItemSize < 0)
+				return -3;
+
+			int Key = (Type<<16)|ID;
+			int *pNewData = s_Builder.GetItemData(Key);
+			if(!pNewData)
+				pNewData = (int *)s_Builder.NewItem(Key>>16, Key&0xffff, ItemSize);
+
+			int FromIndex = pFrom->GetItemIndex(Key);
+			if(FromIndex != -1)
+			{
+				int *pPast = pFrom->GetItem(FromIndex)->Data();
+				for(int d = 0; d < ItemSize/4; d++)
+					pNewData[d] = pPast[d]+pData[d];
+			}
+			else
+				mem_copy(pNewData, pData, ItemSize);
+
+			pData += ItemSize/4;
+		}
+
+		return s_Builder.Finish(pTo);
+	}
+}
+
+class CDeltaCheck : public CDemoPlayer::IListner
+{
+public:
+	CSnapshotDelta *m_pDelta;
+
+	char m_aLastSnap[CSnapshot::MAX_SIZE];
+	char m_aRefDelta[CSnapshot::MAX_SIZE];
+	char m_aDelta[CSnapshot::MAX_SIZE];
+	char m_aRefUnpacked[CSnapshot::MAX_SIZE];
+	char m_aUnpacked[CSnapshot::MAX_SIZE];
+
+	int m_NumSnapshots;
+	int m_NumChecks;
+	int m_NumErrors;
+	int64 m_RefTime;
+	int64 m_Time;
+
+	CDeltaCheck(CSnapshotDelta *pDelta)
+	{
+		m_pDelta = pDelta;
+		((CSnapshot *)m_aLastSnap)->Clear();
+		m_NumSnapshots = 0;
+		m_NumChecks = 0;
+		m_NumErrors = 0;
+		m_RefTime = 0;
+		m_Time = 0;
+	}
+
+	void Check(CSnapshot *pFrom, CSnapshot *pTo)
+	{
+		m_NumChecks++;
+
+		int64 Start = time_get();
+		int RefSize = Reference::CreateDelta(pFrom, pTo, m_aRefDelta);
+		int64 Mid = time_get();
+		int Size = m_pDelta->CreateDelta(pFrom, pTo, m_aDelta);
+		m_RefTime += Mid-Start;
+		m_Time += time_get()-Mid;
+
+		if(RefSize != Size || mem_comp(m_aRefDelta, m_aDelta, Size) != 0)
+		{
+			dbg_msg("delta_check", "snapshot %d: delta differs, size %d vs %d", m_NumSnapshots, Size, RefSize);
+			m_NumErrors++;
+			return;
+		}
+		if(!Size)
+			return;
+
+		int RefUnpackedSize = Reference::UnpackDelta(pFrom, (CSnapshot *)m_aRefUnpacked, m_aDelta, Size);
+		int UnpackedSize = m_pDelta->UnpackDelta(pFrom, (CSnapshot *)m_aUnpacked, m_aDelta, Size);
+		if(RefUnpackedSize != UnpackedSize || UnpackedSize < 0 || mem_comp(m_aRefUnpacked, m_aUnpacked, UnpackedSize) != 0)
+		{
+			dbg_msg("delta_check", "snapshot %d: unpacked snapshot differs, size %d vs %d", m_NumSnapshots, UnpackedSize, RefUnpackedSize);
+			m_NumErrors++;
+		}
+		else if(((CSnapshot *)m_aUnpacked)->Crc() != pTo->Crc())
+		{
+			dbg_msg("delta_check", "snapshot %d: unpacked snapshot has the wrong crc", m_NumSnapshots);
+			m_NumErrors++;
+		}
+	}
+
+	virtual void OnDemoPlayerSnapshot(void *pData, int Size)
+	{
+		CSnapshot *pSnap = (CSnapshot *)pData;
+		CSnapshot Empty;
+		Empty.Clear();
+
+		// against the previous snapshot like the server does, and from scratch like a keyframe
+		Check((CSnapshot *)m_aLastSnap, pSnap);
+		Check(&Empty, pSnap);
+
+		mem_copy(m_aLastSnap, pData, Size);
+		m_NumSnapshots++;
+	}
+
+	virtual void OnDemoPlayerMessage(void *pData, int Size) {}
+};
+
+static void PrintCallback(const char *pStr, void *pUser)
+{
+	dbg_msg("console", "%s", pStr);
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	CNetBase::Init();
+
+	if(argc < 2) // ignore_convention
+	{
+		dbg_msg("delta_check", "usage: %s <demo> [<demo> ...]", argv[0]); // ignore_convention
+		return -1;
+	}
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_CLIENT, argc, argv); // ignore_convention
+	IConsole *pConsole = CreateConsole(CFGFLAG_CLIENT);
+	pConsole->RegisterPrintCallback(IConsole::OUTPUT_LEVEL_STANDARD, PrintCallback, 0);
+	if(!pStorage)
+		return -1;
+
+	// static sizes as the game client sets them up
+	CSnapshotDelta Delta;
+	CNetObjHandler NetObjHandler;
+	for(int i = 0; i < NUM_NETOBJTYPES; i++)
+	{
+		Delta.SetStaticsize(i, NetObjHandler.GetObjSize(i));
+		Reference::s_aItemSizes[i] = NetObjHandler.GetObjSize(i);
+	}
+
+	int NumErrors = 0;
+	for(int i = 1; i < argc; i++) // ignore_convention
+	{
+		CDemoPlayer Player(&Delta);
+		CDeltaCheck Check(&Delta);
+		Player.SetListner(&Check);
+		if(Player.Load(pStorage, pConsole, argv[i], IStorage::TYPE_ALL)) // ignore_convention
+		{
+			NumErrors++;
+			continue;
+		}
+
+		// play it back as fast as possible
+		Player.Play();
+		Player.SetSpeed(1000000.0f);
+		while(Player.IsPlaying() && !Player.BaseInfo()->m_Paused)
+			Player.Update();
+		Player.Stop();
+
+		dbg_msg("delta_check", "%s: %d snapshots, %d checks, %d errors, reference %.2fms, current %.2fms", argv[i], // ignore_convention
+			Check.m_NumSnapshots, Check.m_NumChecks, Check.m_NumErrors,
+			Check.m_RefTime*1000.0/time_freq(), Check.m_Time*1000.0/time_freq());
+		NumErrors += Check.m_NumErrors;
+	}
+
+	return NumErrors ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/storage.h>
+#include <engine/shared/config.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/network.h>
+#include <engine/shared/snapshot.h>
+
+#include <game/generated/protocol.h>
+
+#include <cstdlib>
+
+/*
+	Rewrites demos without the client: plays the inputs back and records
+	everything in the wanted tick range into a new demo. Several inputs of
+	the same map are concatenated, the ticks of the later ones are moved
+	so they continue right after the previous one. Every snapshot goes
+	through the delta code again, so the output is re-compressed and gets
+	keyframes and a keyframe index with the wanted spacing.
+	Only the current and the last snapshot are kept in memory.
+*/
+
+class CDemoRewriter : public CDemoPlayer::IListner
+{
+public:
+	CDemoPlayer *m_pPlayer;
+	CDemoRecorder *m_pRecorder;
+	int m_BeginTick;
+	int m_EndTick;
+
+	int m_TickOffset;
+	int m_LastTick;
+	int m_NextMarker;
+	bool m_Done;
+
+	int m_NumSnapshots;
+	int m_NumMessages;
+
+	CDemoRewriter(CDemoPlayer *pPlayer, CDemoRecorder *pRecorder, int BeginTick, int EndTick)
+	{
+		m_pPlayer = pPlayer;
+		m_pRecorder = pRecorder;
+		m_BeginTick = BeginTick;
+		m_EndTick = EndTick;
+		m_TickOffset = 0;
+		m_LastTick = -1;
+		m_NextMarker = 0;
+		m_Done = false;
+		m_NumSnapshots = 0;
+		m_NumMessages = 0;
+	}
+
+	// called before every input, the player has to be loaded
+	void NextInput()
+	{
+		m_TickOffset = -1;
+		m_NextMarker = 0;
+		m_Done = false;
+	}
+
+	bool InRange(int Tick) const
+	{
+		return Tick >= m_BeginTick && (m_EndTick < 0 || Tick <= m_EndTick);
+	}
+
+	virtual void OnDemoPlayerSnapshot(void *pData, int Size)
+	{
+		int Tick = m_pPlayer->BaseInfo()->m_CurrentTick;
+		if(m_EndTick >= 0 && Tick > m_EndTick)
+		{
+			// pausing makes the player stop after this tick
+			m_Done = true;
+			m_pPlayer->Pause();
+		}
+		if(m_Done || !InRange(Tick))
+			return;
+
+		// the first snapshot of an input continues after the last one of the previous input
+		if(m_TickOffset == -1)
+			m_TickOffset = m_LastTick < 0 ? 0 : m_LastTick+1-Tick;
+
+		// the player repeats the last snapshot for ticks without one
+		if(Tick+m_TickOffset <= m_LastTick)
+			return;
+
+		m_LastTick = Tick+m_TickOffset;
+		m_pRecorder->RecordSnapshot(m_LastTick, pData, Size);
+		m_NumSnapshots++;
+
+		// keep the timeline markers that are in the range
+		const IDemoPlayer::CInfo *pInfo = m_pPlayer->BaseInfo();
+		while(m_NextMarker < pInfo->m_NumTimelineMarkers && pInfo->m_aTimelineMarkers[m_NextMarker] <= Tick)
+		{
+			if(InRange(pInfo->m_aTimelineMarkers[m_NextMarker]))
+				m_pRecorder->AddDemoMarker();
+			m_NextMarker++;
+		}
+	}
+
+	virtual void OnDemoPlayerMessage(void *pData, int Size)
+	{
+		// messages belong to the last snapshot
+		if(m_Done || m_TickOffset == -1 || !InRange(m_pPlayer->BaseInfo()->m_CurrentTick))
+			return;
+
+		m_pRecorder->RecordMessage(pData, Size);
+		m_NumMessages++;
+	}
+};
+
+static void Usage(const char *pName)
+{
+	dbg_msg("demo_tool", "usage: %s [-b <tick>] [-e <tick>] [-k <ticks>] <output> <input> [<input> ...]", pName);
+	dbg_msg("demo_tool", "  -b <tick>   first tick to keep");
+	dbg_msg("demo_tool", "  -e <tick>   last tick to keep");
+	dbg_msg("demo_tool", "  -k <ticks>  ticks between keyframes, default %d", SERVER_TICK_SPEED*5);
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	CNetBase::Init();
+
+	int BeginTick = 0;
+	int EndTick = -1;
+	int KeyFrameInterval = SERVER_TICK_SPEED*5;
+	int Arg = 1;
+	for(; Arg+1 < argc && argv[Arg][0] == '-'; Arg += 2) // ignore_convention
+	{
+		if(!str_comp(argv[Arg], "-b")) // ignore_convention
+			BeginTick = atoi(argv[Arg+1]); // ignore_convention
+		else if(!str_comp(argv[Arg], "-e")) // ignore_convention
+			EndTick = atoi(argv[Arg+1]); // ignore_convention
+		else if(!str_comp(argv[Arg], "-k")) // ignore_convention
+			KeyFrameInterval = atoi(argv[Arg+1]); // ignore_convention
+		else
+			break;
+	}
+	if(argc-Arg < 2 || KeyFrameInterval < 1 || (EndTick >= 0 && EndTick < BeginTick)) // ignore_convention
+	{
+		Usage(argv[0]); // ignore_convention
+		return -1;
+	}
+	const char *pOutput = argv[Arg]; // ignore_convention
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_CLIENT, argc, argv); // ignore_convention
+	IConsole *pConsole = CreateConsole(CFGFLAG_CLIENT);
+	if(!pStorage)
+		return -1;
+
+	// static sizes as the game client sets them up, the recorder gets its own delta
+	// as it creates the deltas on its writer thread
+	CSnapshotDelta PlayerDelta;
+	CSnapshotDelta RecorderDelta;
+	CNetObjHandler NetObjHandler;
+	for(int i = 0; i < NUM_NETOBJTYPES; i++)
+	{
+		PlayerDelta.SetStaticsize(i, NetObjHandler.GetObjSize(i));
+		RecorderDelta.SetStaticsize(i, NetObjHandler.GetObjSize(i));
+	}
+
+	CDemoPlayer Player(&PlayerDelta);
+	CDemoRecorder Recorder(&RecorderDelta);
+	Recorder.SetKeyFrameInterval(KeyFrameInterval);
+	CDemoRewriter Rewriter(&Player, &Recorder, BeginTick, EndTick);
+	Player.SetListner(&Rewriter);
+
+	CDemoHeader First;
+	for(int i = Arg+1; i < argc; i++) // ignore_convention
+	{
+		const char *pInput = argv[i]; // ignore_convention
+		if(Player.Load(pStorage, pConsole, pInput, IStorage::TYPE_ALL))
+		{
+			Recorder.Stop();
+			return -1;
+		}
+
+		const CDemoHeader *pHeader = &Player.Info()->m_Header;
+		if(!Recorder.IsRecording())
+		{
+			First = *pHeader;
+			unsigned Crc = (pHeader->m_aMapCrc[0]<<24) | (pHeader->m_aMapCrc[1]<<16) | (pHeader->m_aMapCrc[2]<<8) | pHeader->m_aMapCrc[3];
+			if(Recorder.Start(pStorage, pConsole, pOutput, pHeader->m_aNetversion, pHeader->m_aMapName, Crc, pHeader->m_aType))
+			{
+				Player.Stop();
+				return -1;
+			}
+		}
+		else if(str_comp(pHeader->m_aMapName, First.m_aMapName) || mem_comp(pHeader->m_aMapCrc, First.m_aMapCrc, sizeof(First.m_aMapCrc)) ||
+			str_comp(pHeader->m_aNetversion, First.m_aNetversion))
+		{
+			dbg_msg("demo_tool", "%s: different map or version than %s, demos can only be merged if they match", pInput, argv[Arg+1]); // ignore_convention
+			Player.Stop();
+			Recorder.Stop();
+			return -1;
+		}
+
+		// skip to the keyframe before the range, the ticks before it are ignored
+		Rewriter.NextInput();
+		int NumSnapshots = Rewriter.m_NumSnapshots;
+		const IDemoPlayer::CInfo *pInfo = Player.BaseInfo();
+		int NumTicks = pInfo->m_LastTick-pInfo->m_FirstTick;
+		if(BeginTick > pInfo->m_LastTick || (EndTick >= 0 && EndTick < pInfo->m_FirstTick))
+		{
+			dbg_msg("demo_tool", "%s: ticks %d to %d are not in the range", pInput, pInfo->m_FirstTick, pInfo->m_LastTick);
+			Player.Stop();
+			continue;
+		}
+		if(BeginTick > pInfo->m_FirstTick+SERVER_TICK_SPEED && NumTicks > 0)
+			Player.SetPos((BeginTick-pInfo->m_FirstTick-SERVER_TICK_SPEED)/(float)NumTicks);
+		else
+			Player.Play();
+
+		// play it back as fast as possible
+		Player.SetSpeed(1000000.0f);
+		while(Player.IsPlaying() && !Player.BaseInfo()->m_Paused && !Rewriter.m_Done)
+			Player.Update();
+		Player.Stop();
+
+		dbg_msg("demo_tool", "%s: %d snapshots", pInput, Rewriter.m_NumSnapshots-NumSnapshots);
+	}
+
+	if(!Recorder.IsRecording())
+		return -1;
+	Recorder.Stop();
+	dbg_msg("demo_tool", "%s: %d snapshots, %d messages", pOutput, Rewriter.m_NumSnapshots, Rewriter.m_NumMessages);
+	return Rewriter.m_NumSnapshots ? 0 : 1;
+}
@@ -108,6 +108,83 @@ static void SendFWCheckResponse(NETADDR *pAddr)
 	pNet->Send(&p);
 }
 
+/*
+	Load test for the master server: every fake server gets its own
+	socket, they all send their first heartbeat at once like after a
+	network blip and answer the firewall checks. The master is asked
+	for its server count every second.
+*/
+static int RunLoadTest(int NumServers)
+{
+	NETADDR BindAddr = {NETTYPE_IPV4, {0},0};
+	NETSOCKET *pSockets = (NETSOCKET *)mem_alloc(NumServers*sizeof(NETSOCKET), 1);
+	int64 *pNextHeartBeat = (int64 *)mem_alloc(NumServers*sizeof(int64), 1);
+	bool *pRegistered = (bool *)mem_alloc(NumServers*sizeof(bool), 1);
+	for(int i = 0; i < NumServers; i++)
+	{
+		pSockets[i] = net_udp_create(BindAddr, 0);
+		if(pSockets[i].type == NETTYPE_INVALID)
+		{
+			dbg_msg("fake_server", "could only open %d sockets", i);
+			return 0;
+		}
+		pNextHeartBeat[i] = 0;
+		pRegistered[i] = false;
+	}
+
+	unsigned char aHeartBeat[sizeof(SERVERBROWSE_HEARTBEAT) + 2];
+	mem_copy(aHeartBeat, SERVERBROWSE_HEARTBEAT, sizeof(SERVERBROWSE_HEARTBEAT));
+	aHeartBeat[sizeof(SERVERBROWSE_HEARTBEAT)] = 0;
+	aHeartBeat[sizeof(SERVERBROWSE_HEARTBEAT)+1] = 0;
+
+	int64 StartTime = time_get();
+	int64 NextCount = 0;
+	int NumRegistered = 0;
+	while(1)
+	{
+		int64 Now = time_get();
+		for(int i = 0; i < NumServers; i++)
+		{
+			NETADDR Addr;
+			unsigned char aBuf[NET_MAX_PACKETSIZE];
+			int Bytes;
+			while((Bytes = net_udp_recv(pSockets[i], &Addr, aBuf, sizeof(aBuf))) > 6)
+			{
+				// connless packets only, the data starts after 6 bytes of padding
+				const unsigned char *pData = &aBuf[6];
+				int Size = Bytes-6;
+				if(Size == sizeof(SERVERBROWSE_FWCHECK) && mem_comp(pData, SERVERBROWSE_FWCHECK, Size) == 0)
+					CNetBase::SendPacketConnless(pSockets[i], &Addr, SERVERBROWSE_FWRESPONSE, sizeof(SERVERBROWSE_FWRESPONSE));
+				else if(Size == sizeof(SERVERBROWSE_FWOK) && mem_comp(pData, SERVERBROWSE_FWOK, Size) == 0 && !pRegistered[i])
+				{
+					pRegistered[i] = true;
+					if(++NumRegistered == NumServers)
+						dbg_msg("fake_server", "all %d servers registered after %.2fs", NumServers, (time_get()-StartTime)/(float)time_freq());
+				}
+				else if(Size == sizeof(SERVERBROWSE_COUNT)+2 && mem_comp(pData, SERVERBROWSE_COUNT, sizeof(SERVERBROWSE_COUNT)) == 0)
+					dbg_msg("fake_server", "master has %d servers, %d of %d registered", (pData[sizeof(SERVERBROWSE_COUNT)]<<8) | pData[sizeof(SERVERBROWSE_COUNT)+1], NumRegistered, NumServers);
+			}
+
+			/* send heartbeats if needed */
+			if(pNextHeartBeat[i] < Now)
+			{
+				pNextHeartBeat[i] = Now+time_freq()*(15+(rand()%15));
+				for(int m = 0; m < NumMasters; m++)
+					CNetBase::SendPacketConnless(pSockets[i], &aMasterServers[m], aHeartBeat, sizeof(aHeartBeat));
+			}
+		}
+
+		if(NextCount < Now)
+		{
+			NextCount = Now+time_freq();
+			for(int m = 0; m < NumMasters; m++)
+				CNetBase::SendPacketConnless(pSockets[0], &aMasterServers[m], SERVERBROWSE_GETCOUNT, sizeof(SERVERBROWSE_GETCOUNT));
+		}
+
+		thread_sleep(5);
+	}
+}
+
 static int Run()
 {
 	int64 NextHeartBeat = 0;
@@ -151,11 +228,11 @@ static int Run()
 int main(int argc, char **argv)
 {
 	pNet = new CNetServer;
+	int NumServers = 0;
 
 	while(argc)
 	{
-		// ?
-		/*if(str_comp(*argv, "-m") == 0)
+		if(str_comp(*argv, "-m") == 0 && argc > 2 && NumMasters < 16)
 		{
 			argc--; argv++;
 			net_host_lookup(*argv, &aMasterServers[NumMasters], NETTYPE_IPV4);
@@ -163,7 +240,12 @@ int main(int argc, char **argv)
 			aMasterServers[NumMasters].port = str_toint(*argv);
 			NumMasters++;
 		}
-		else */if(str_comp(*argv, "-p") == 0)
+		else if(str_comp(*argv, "-s") == 0)
+		{
+			argc--; argv++;
+			NumServers = str_toint(*argv);
+		}
+		else if(str_comp(*argv, "-p") == 0)
 		{
 			argc--; argv++;
 			PlayerNames[NumPlayers++] = *argv;
@@ -204,8 +286,11 @@ int main(int argc, char **argv)
 		argc--; argv++;
 	}
 
+	dbg_logger_stdout();
+	net_init();
+
 	BuildInfoMsg();
-	int RunReturn = Run();
+	int RunReturn = NumServers > 0 ? RunLoadTest(NumServers) : Run();
 
 	delete pNet;
 	return RunReturn;
@@ -0,0 +1,548 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <math.h>
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/message.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/network.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/snapshot.h>
+
+#include <game/generated/protocol.h>
+#include <game/version.h>
+
+/*
+	loadbot - puts real gameplay load on a server
+
+	Every bot opens its own connection, downloads the map, enters the game and
+	sends scripted input at the server tick rate. Incoming snapshots are
+	unpacked and crc checked like the client does it. Once per second a line
+	with traffic and snapshot statistics is printed.
+
+	usage: loadbot [-b num_bots] [-t seconds] [-p server_pid] [-w map_window] [host:port]
+
+	The server has to allow the connections, e.g. sv_max_clients_per_ip.
+*/
+
+enum
+{
+	MAX_BOTS=MAX_CLIENTS,
+	SNAPSIZE_BUCKETS=CSnapshot::MAX_SIZE/64,
+};
+
+static CSnapshotDelta s_SnapshotDelta;
+static CNetObjHandler s_NetObjHandler;
+
+// statistics, reset after every report
+static int s_aSnapSizeHist[SNAPSIZE_BUCKETS];
+static int s_NumSnaps = 0;
+static int s_NumEmptySnaps = 0;
+static int s_NumCrcErrors = 0;
+static int s_LastServerTick = 0;
+
+// map chunks the server may send ahead, 0 requests them one by one like older clients
+static int s_MapWindow = MAP_DOWNLOAD_WINDOW;
+
+class CBot
+{
+public:
+	enum
+	{
+		STATE_OFFLINE=0,
+		STATE_CONNECTING,
+		STATE_LOADING,
+		STATE_READY,
+		STATE_INGAME,
+	};
+
+	CNetClient m_NetClient;
+	NETADDR m_ServerAddr;
+	int m_ID;
+	int m_State;
+
+	int m_MapCrc;
+	int m_MapSize;
+	int m_MapChunk;
+	int m_MapAmount;
+	int64 m_MapStartTime;
+
+	CSnapshotStorage m_SnapshotStorage;
+	char m_aSnapshotIncomming[CSnapshot::MAX_SIZE];
+	unsigned m_SnapshotParts;
+	int m_CurrentRecvTick;
+	int m_AckGameTick;
+	int64 m_RecvTickTime;
+	int m_LastInputTick;
+
+	void Init(int ID, const NETADDR *pServerAddr);
+	void Update();
+
+	int SendMsg(CMsgPacker *pMsg, int Flags, bool System);
+	void SendInput();
+	void ProcessPacket(CNetChunk *pPacket);
+	void ProcessSnapshot(int Msg, CUnpacker *pUnpacker);
+};
+
+void CBot::Init(int ID, const NETADDR *pServerAddr)
+{
+	NETADDR BindAddr;
+	mem_zero(&BindAddr, sizeof(BindAddr));
+	BindAddr.type = pServerAddr->type;
+
+	m_ID = ID;
+	m_ServerAddr = *pServerAddr;
+	m_State = STATE_OFFLINE;
+	m_SnapshotStorage.Init();
+	m_SnapshotParts = 0;
+	m_CurrentRecvTick = 0;
+	m_AckGameTick = -1;
+	m_RecvTickTime = 0;
+	m_LastInputTick = 0;
+
+	if(!m_NetClient.Open(BindAddr, NETCREATE_FLAG_RANDOMPORT))
+	{
+		dbg_msg("loadbot", "bot %d: couldn't open socket", m_ID);
+		return;
+	}
+
+	m_NetClient.Connect(&m_ServerAddr);
+	m_State = STATE_CONNECTING;
+}
+
+int CBot::SendMsg(CMsgPacker *pMsg, int Flags, bool System)
+{
+	CNetChunk Packet;
+	mem_zero(&Packet, sizeof(CNetChunk));
+
+	Packet.m_ClientID = 0;
+	Packet.m_pData = pMsg->Data();
+	Packet.m_DataSize = pMsg->Size();
+
+	// HACK: modify the message id in the packet and store the system flag
+	*((unsigned char*)Packet.m_pData) <<= 1;
+	if(System)
+		*((unsigned char*)Packet.m_pData) |= 1;
+
+	if(Flags&MSGFLAG_VITAL)
+		Packet.m_Flags |= NETSENDFLAG_VITAL;
+	if(Flags&MSGFLAG_FLUSH)
+		Packet.m_Flags |= NETSENDFLAG_FLUSH;
+
+	return m_NetClient.Send(&Packet);
+}
+
+void CBot::SendInput()
+{
+	// estimate the current server tick from the last snapshot
+	int PredTick = m_CurrentRecvTick + (int)(((time_get()-m_RecvTickTime)*SERVER_TICK_SPEED)/time_freq()) + 2;
+	if(PredTick <= m_LastInputTick)
+		return;
+	m_LastInputTick = PredTick;
+
+	// scripted movement: run back and forth, jump, spin the cursor and shoot
+	CNetObj_PlayerInput Input;
+	mem_zero(&Input, sizeof(Input));
+	int Phase = PredTick + m_ID*37;
+	Input.m_Direction = (Phase/100)%2 ? 1 : -1;
+	Input.m_Jump = (Phase%50) < 5;
+	Input.m_Fire = (Phase/10)%2;
+	Input.m_Hook = (Phase%120) > 90;
+	Input.m_TargetX = (int)(cosf(Phase/20.0f)*100.0f);
+	Input.m_TargetY = (int)(sinf(Phase/20.0f)*100.0f);
+	Input.m_WantedWeapon = 1+(Phase/500)%5;
+
+	CMsgPacker Msg(NETMSG_INPUT);
+	Msg.AddInt(m_AckGameTick);
+	Msg.AddInt(PredTick);
+	Msg.AddInt(sizeof(Input));
+	for(unsigned i = 0; i < sizeof(Input)/sizeof(int); i++)
+		Msg.AddInt(((int *)&Input)[i]);
+	SendMsg(&Msg, MSGFLAG_FLUSH, true);
+}
+
+void CBot::ProcessSnapshot(int Msg, CUnpacker *pUnpacker)
+{
+	int NumParts = 1;
+	int Part = 0;
+	int GameTick = pUnpacker->GetInt();
+	int DeltaTick = GameTick-pUnpacker->GetInt();
+	int PartSize = 0;
+	int Crc = 0;
+
+	if(Msg == NETMSG_SNAP)
+	{
+		NumParts = pUnpacker->GetInt();
+		Part = pUnpacker->GetInt();
+	}
+
+	if(Msg != NETMSG_SNAPEMPTY)
+	{
+		Crc = pUnpacker->GetInt();
+		PartSize = pUnpacker->GetInt();
+	}
+
+	const char *pData = (const char *)pUnpacker->GetRaw(PartSize);
+
+	if(pUnpacker->Error() || NumParts < 1 || NumParts > CSnapshot::MAX_PARTS || Part < 0 || Part >= NumParts || PartSize < 0 || PartSize > MAX_SNAPSHOT_PACKSIZE)
+		return;
+
+	if(GameTick < m_CurrentRecvTick)
+		return;
+
+	if(GameTick != m_CurrentRecvTick)
+	{
+		m_SnapshotParts = 0;
+		m_CurrentRecvTick = GameTick;
+		m_RecvTickTime = time_get();
+		s_LastServerTick = max(s_LastServerTick, GameTick);
+	}
+
+	mem_copy(m_aSnapshotIncomming + Part*MAX_SNAPSHOT_PACKSIZE, pData, PartSize);
+	m_SnapshotParts |= 1<<Part;
+
+	if(m_SnapshotParts != (unsigned)((1<<NumParts)-1))
+		return;
+	m_SnapshotParts = 0;
+
+	static CSnapshot EmptySnap;
+	CSnapshot *pDeltaShot = &EmptySnap;
+	EmptySnap.Clear();
+
+	if(DeltaTick >= 0 && m_SnapshotStorage.Get(DeltaTick, 0, &pDeltaShot, 0) < 0)
+	{
+		// lost the snapshot the server used, force a resync
+		m_AckGameTick = -1;
+		return;
+	}
+
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	char aSnap[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnap = (CSnapshot *)aSnap;
+	void *pDeltaData = s_SnapshotDelta.EmptyDelta();
+	int DeltaSize = sizeof(int)*3;
+	int CompleteSize = (NumParts-1) * MAX_SNAPSHOT_PACKSIZE + PartSize;
+
+	if(CompleteSize)
+	{
+		DeltaSize = CVariableInt::Decompress(m_aSnapshotIncomming, CompleteSize, aDeltaData);
+		if(DeltaSize < 0)
+			return;
+		pDeltaData = aDeltaData;
+	}
+
+	int SnapSize = s_SnapshotDelta.UnpackDelta(pDeltaShot, pSnap, pDeltaData, DeltaSize);
+	if(SnapSize < 0)
+	{
+		dbg_msg("loadbot", "bot %d: delta unpack failed", m_ID);
+		return;
+	}
+
+	if(Msg != NETMSG_SNAPEMPTY && pSnap->Crc() != Crc)
+	{
+		s_NumCrcErrors++;
+		m_AckGameTick = -1;
+		return;
+	}
+
+	s_NumSnaps++;
+	if(Msg == NETMSG_SNAPEMPTY)
+		s_NumEmptySnaps++;
+	s_aSnapSizeHist[min(CompleteSize/64, (int)SNAPSIZE_BUCKETS-1)]++;
+
+	m_SnapshotStorage.PurgeUntil(min(DeltaTick, GameTick));
+	m_SnapshotStorage.Add(GameTick, time_get(), SnapSize, pSnap, 0, 1);
+	m_AckGameTick = GameTick;
+	m_State = STATE_INGAME;
+}
+
+void CBot::ProcessPacket(CNetChunk *pPacket)
+{
+	CUnpacker Unpacker;
+	Unpacker.Reset(pPacket->m_pData, pPacket->m_DataSize);
+
+	int Msg = Unpacker.GetInt();
+	int Sys = Msg&1;
+	Msg >>= 1;
+
+	if(Unpacker.Error())
+		return;
+
+	if(!Sys)
+	{
+		// the only game message we care about
+		if(Msg == NETMSGTYPE_SV_READYTOENTER && m_State == STATE_READY)
+		{
+			CMsgPacker Msg(NETMSG_ENTERGAME);
+			SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+		}
+		return;
+	}
+
+	if(Msg == NETMSG_MAP_CHANGE)
+	{
+		Unpacker.GetString(CUnpacker::SANITIZE_CC);
+		m_MapCrc = Unpacker.GetInt();
+		m_MapSize = Unpacker.GetInt();
+		if(Unpacker.Error())
+			return;
+
+		// fetch the whole map, even if we don't need it, to load the server like a real client
+		m_State = STATE_LOADING;
+		m_MapChunk = 0;
+		m_MapAmount = 0;
+		m_MapStartTime = time_get();
+		m_SnapshotStorage.PurgeAll();
+		m_CurrentRecvTick = 0;
+		m_AckGameTick = -1;
+		m_LastInputTick = 0;
+
+		CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA);
+		Msg.AddInt(m_MapChunk);
+		if(s_MapWindow)
+			Msg.AddInt(s_MapWindow);
+		SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+	}
+	else if(Msg == NETMSG_MAP_DATA)
+	{
+		int Last = Unpacker.GetInt();
+		int MapCrc = Unpacker.GetInt();
+		int Chunk = Unpacker.GetInt();
+		int Size = Unpacker.GetInt();
+		Unpacker.GetRaw(Size);
+
+		if(Unpacker.Error() || Size <= 0 || MapCrc != m_MapCrc || Chunk != m_MapChunk || m_State != STATE_LOADING)
+			return;
+
+		m_MapAmount += Size;
+		if(Last)
+		{
+			dbg_msg("loadbot", "bot %d downloaded %d bytes in %dms", m_ID, m_MapAmount, (int)((time_get()-m_MapStartTime)*1000/time_freq()));
+
+			CMsgPacker Msg(NETMSG_READY);
+			SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+		}
+		else
+		{
+			CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA);
+			Msg.AddInt(++m_MapChunk);
+			if(s_MapWindow)
+				Msg.AddInt(s_MapWindow);
+			SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+		}
+	}
+	else if(Msg == NETMSG_CON_READY)
+	{
+		char aName[16];
+		str_format(aName, sizeof(aName), "loadbot %d", m_ID);
+
+		CNetMsg_Cl_StartInfo StartInfo;
+		StartInfo.m_pName = aName;
+		StartInfo.m_pClan = "";
+		StartInfo.m_Country = -1;
+		StartInfo.m_pSkin = "default";
+		StartInfo.m_UseCustomColor = 0;
+		StartInfo.m_ColorBody = 0;
+		StartInfo.m_ColorFeet = 0;
+
+		CMsgPacker Msg(StartInfo.MsgID());
+		StartInfo.Pack(&Msg);
+		SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, false);
+		m_State = STATE_READY;
+	}
+	else if(Msg == NETMSG_PING)
+	{
+		CMsgPacker Msg(NETMSG_PING_REPLY);
+		SendMsg(&Msg, 0, true);
+	}
+	else if(Msg == NETMSG_SNAP || Msg == NETMSG_SNAPSINGLE || Msg == NETMSG_SNAPEMPTY)
+	{
+		if(m_State >= STATE_READY)
+			ProcessSnapshot(Msg, &Unpacker);
+	}
+}
+
+void CBot::Update()
+{
+	if(m_State == STATE_OFFLINE)
+		return;
+
+	m_NetClient.Update();
+
+	if(m_NetClient.State() == NETSTATE_OFFLINE)
+	{
+		dbg_msg("loadbot", "bot %d: disconnected (%s)", m_ID, m_NetClient.ErrorString());
+		m_State = STATE_OFFLINE;
+		return;
+	}
+
+	if(m_State == STATE_CONNECTING && m_NetClient.State() == NETSTATE_ONLINE)
+	{
+		CMsgPacker Msg(NETMSG_INFO);
+		Msg.AddString(GAME_NETVERSION, 128);
+		Msg.AddString("", 128);
+		SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+		m_State = STATE_LOADING;
+	}
+
+	CNetChunk Packet;
+	while(m_NetClient.Recv(&Packet))
+	{
+		if(Packet.m_ClientID != -1)
+			ProcessPacket(&Packet);
+	}
+
+	if(m_State == STATE_INGAME)
+		SendInput();
+}
+
+static int SnapSizePercentile(int NumSnaps, int Percent)
+{
+	if(!NumSnaps)
+		return 0;
+
+	int Wanted = (NumSnaps*Percent+99)/100;
+	int Count = 0;
+	for(int i = 0; i < SNAPSIZE_BUCKETS; i++)
+	{
+		Count += s_aSnapSizeHist[i];
+		if(Count >= Wanted)
+			return (i+1)*64;
+	}
+	return CSnapshot::MAX_SIZE;
+}
+
+// cpu time of the server process in microseconds, -1 if not available
+static int64 ServerCpuTime(int Pid)
+{
+	if(!Pid)
+		return -1;
+
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf), "/proc/%d/stat", Pid);
+	IOHANDLE File = io_open(aBuf, IOFLAG_READ);
+	if(!File)
+		return -1;
+	int Size = io_read(File, aBuf, sizeof(aBuf)-1);
+	io_close(File);
+	aBuf[max(Size, 0)] = 0;
+
+	// utime and stime are field 14 and 15, the process name in field 2 can contain spaces
+	const char *pField = 0;
+	for(const char *p = aBuf; *p; p++)
+		if(*p == ')')
+			pField = p;
+	if(!pField)
+		return -1;
+	for(int i = 2; i < 14 && pField; i++)
+		pField = str_find(pField+1, " ");
+	if(!pField)
+		return -1;
+
+	int64 UserTime = str_toint(pField+1);
+	pField = str_find(pField+1, " ");
+	if(!pField)
+		return -1;
+	int64 SysTime = str_toint(pField+1);
+
+	// clock ticks are 100 per second on all linux platforms we care about
+	return (UserTime+SysTime)*10000;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	NETADDR ServerAddr;
+	int NumBots = 8;
+	int Seconds = 0;
+	int ServerPid = 0;
+	const char *pServer = "127.0.0.1:8303";
+
+	dbg_logger_stdout();
+	net_init();
+	CNetBase::Init();
+
+	for(int i = 1; i < argc; i++) // ignore_convention
+	{
+		if(str_comp(argv[i], "-b") == 0 && i+1 < argc) // ignore_convention
+			NumBots = clamp(str_toint(argv[++i]), 1, (int)MAX_BOTS); // ignore_convention
+		else if(str_comp(argv[i], "-t") == 0 && i+1 < argc) // ignore_convention
+			Seconds = str_toint(argv[++i]); // ignore_convention
+		else if(str_comp(argv[i], "-p") == 0 && i+1 < argc) // ignore_convention
+			ServerPid = str_toint(argv[++i]); // ignore_convention
+		else if(str_comp(argv[i], "-w") == 0 && i+1 < argc) // ignore_convention
+			s_MapWindow = max(str_toint(argv[++i]), 0); // ignore_convention
+		else
+			pServer = argv[i]; // ignore_convention
+	}
+
+	if(net_host_lookup(pServer, &ServerAddr, NETTYPE_ALL) != 0)
+	{
+		dbg_msg("loadbot", "couldn't resolve '%s'", pServer);
+		return -1;
+	}
+	if(!ServerAddr.port)
+		ServerAddr.port = 8303;
+
+	for(int i = 0; i < NUM_NETOBJTYPES; i++)
+		s_SnapshotDelta.SetStaticsize(i, s_NetObjHandler.GetObjSize(i));
+
+	CBot *pBots = new CBot[NumBots];
+	for(int i = 0; i < NumBots; i++)
+		pBots[i].Init(i, &ServerAddr);
+
+	int64 StartTime = time_get();
+	int64 ReportTime = StartTime+time_freq();
+	int64 LastCpuTime = ServerCpuTime(ServerPid);
+	int ReportTick = 0;
+	NETSTATS LastStats;
+	net_stats(&LastStats);
+
+	while(!Seconds || time_get() < StartTime+time_freq()*Seconds)
+	{
+		for(int i = 0; i < NumBots; i++)
+			pBots[i].Update();
+
+		if(time_get() > ReportTime)
+		{
+			NETSTATS Stats;
+			net_stats(&Stats);
+			int NumIngame = 0;
+			for(int i = 0; i < NumBots; i++)
+				if(pBots[i].m_State == CBot::STATE_INGAME)
+					NumIngame++;
+
+			// server cpu per tick
+			char aCpu[32] = "n/a";
+			int64 CpuTime = ServerCpuTime(ServerPid);
+			int Ticks = s_LastServerTick-ReportTick;
+			if(CpuTime >= 0 && LastCpuTime >= 0 && Ticks > 0 && ReportTick > 0)
+				str_format(aCpu, sizeof(aCpu), "%.2fms", (CpuTime-LastCpuTime)/1000.0f/Ticks);
+			LastCpuTime = CpuTime;
+			ReportTick = s_LastServerTick;
+
+			dbg_msg("loadbot", "ingame=%d/%d snaps=%d empty=%d crcerr=%d recv=%dB/s sent=%dB/s snapsize p50=%d p90=%d p99=%d max=%d cpu/tick=%s",
+				NumIngame, NumBots, s_NumSnaps, s_NumEmptySnaps, s_NumCrcErrors,
+				Stats.recv_bytes-LastStats.recv_bytes, Stats.sent_bytes-LastStats.sent_bytes,
+				SnapSizePercentile(s_NumSnaps, 50), SnapSizePercentile(s_NumSnaps, 90),
+				SnapSizePercentile(s_NumSnaps, 99), SnapSizePercentile(s_NumSnaps, 100), aCpu);
+
+			LastStats = Stats;
+			s_NumSnaps = 0;
+			s_NumEmptySnaps = 0;
+			s_NumCrcErrors = 0;
+			mem_zero(s_aSnapSizeHist, sizeof(s_aSnapSizeHist));
+			ReportTime += time_freq();
+		}
+
+		thread_sleep(1);
+	}
+
+	for(int i = 0; i < NumBots; i++)
+		pBots[i].m_NetClient.Disconnect("loadbot done");
+
+	delete [] pBots;
+	return 0;
+}
@@ -0,0 +1,97 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include <engine/shared/snapshot.h>
+
+// compares the linear CSnapshot::GetItemIndex with the CSnapshotIndex lookup
+
+enum
+{
+	NUM_ITEMS=500,
+	NUM_ROUNDS=2000,
+};
+
+static char s_aSnapData[CSnapshot::MAX_SIZE];
+static int s_aIndexData[CSnapshotIndex::MAX_SIZE/sizeof(int)];
+static CSnapshotBuilder s_Builder;
+
+static int s_aKeys[NUM_ITEMS*2];
+
+static void BuildSnapshot(CSnapshot *pSnap)
+{
+	// a mix of item types and sizes like a busy game world, every item has a different key
+	s_Builder.Init();
+	for(int i = 0; i < NUM_ITEMS; i++)
+	{
+		int Type = 1 + i%12;
+		int ID = i*7;
+		int Size = (2 + i%8)*sizeof(int);
+		int *pData = (int *)s_Builder.NewItem(Type, ID, Size);
+		for(unsigned d = 0; d < Size/sizeof(int); d++)
+			pData[d] = i+d;
+
+		// look up every item once and one key that is not in the snapshot
+		s_aKeys[i*2] = (Type<<16)|ID;
+		s_aKeys[i*2+1] = (Type<<16)|(ID+1);
+	}
+	s_Builder.Finish(pSnap);
+}
+
+static int64 RunLinear(CSnapshot *pSnap, int *pChecksum)
+{
+	int Checksum = 0;
+	int64 Start = time_get();
+	for(int r = 0; r < NUM_ROUNDS; r++)
+		for(int i = 0; i < NUM_ITEMS*2; i++)
+			Checksum += pSnap->GetItemIndex(s_aKeys[i]);
+	*pChecksum = Checksum;
+	return time_get()-Start;
+}
+
+static int64 RunIndexed(const CSnapshotIndex *pIndex, int *pChecksum)
+{
+	int Checksum = 0;
+	int64 Start = time_get();
+	for(int r = 0; r < NUM_ROUNDS; r++)
+		for(int i = 0; i < NUM_ITEMS*2; i++)
+			Checksum += pIndex->GetItemIndex(s_aKeys[i]);
+	*pChecksum = Checksum;
+	return time_get()-Start;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	CSnapshot *pSnap = (CSnapshot *)s_aSnapData;
+	BuildSnapshot(pSnap);
+
+	CSnapshotIndex *pIndex = (CSnapshotIndex *)s_aIndexData;
+	int64 BuildStart = time_get();
+	pIndex->Build(pSnap);
+	int64 BuildTime = time_get()-BuildStart;
+
+	// both have to give the same answers
+	for(int i = 0; i < NUM_ITEMS*2; i++)
+	{
+		if(pSnap->GetItemIndex(s_aKeys[i]) != pIndex->GetItemIndex(s_aKeys[i]))
+		{
+			dbg_msg("snapshot_bench", "lookup mismatch for key %08x", s_aKeys[i]);
+			return -1;
+		}
+	}
+
+	int LinearChecksum, IndexedChecksum;
+	int64 LinearTime = RunLinear(pSnap, &LinearChecksum);
+	int64 IndexedTime = RunIndexed(pIndex, &IndexedChecksum);
+
+	int NumLookups = NUM_ROUNDS*NUM_ITEMS*2;
+	dbg_msg("snapshot_bench", "%d items, %d lookups (half of them misses), index size %d bytes, built in %.3fus",
+		NUM_ITEMS, NumLookups, CSnapshotIndex::TotalSize(NUM_ITEMS), BuildTime*1000000.0/time_freq());
+	dbg_msg("snapshot_bench", "linear:  %8.2fms %7.2fns/lookup (checksum %d)",
+		LinearTime*1000.0/time_freq(), LinearTime*1000000000.0/time_freq()/NumLookups, LinearChecksum);
+	dbg_msg("snapshot_bench", "indexed: %8.2fms %7.2fns/lookup (checksum %d)",
+		IndexedTime*1000.0/time_freq(), IndexedTime*1000000000.0/time_freq()/NumLookups, IndexedChecksum);
+	return 0;
+}